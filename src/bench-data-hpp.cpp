@@ -0,0 +1,94 @@
+/*******************************************************************************
+ *
+ *	lib-util : A Utility Library
+ *
+ *	Copyright (c) 2016-2018 Ammon Dodson
+ *	You should have received a copy of the licence terms with this software. If
+ *	not, please visit the project homepage at:
+ *	https://github.com/ammon0/lib-util
+ *
+ ******************************************************************************/
+
+/*	Benchmarks for the C++ wrappers in data.hpp against the C interface
+ *	Timings are wall clock and only meaningful relative to each other.
+ */
+
+#include <util/data.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <vector>
+#include <sys/time.h>
+
+
+#define KEY_MIN    1000
+#define KEY_MAX    100000
+#define LOOKUP_CNT 2000000
+
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15;
+
+// xorshift64*
+static uint64_t rng(void){
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545F4914F6CDD1D;
+}
+
+static const void * key(const void * data){ return data; }
+
+static imax cmp_u64(const void * left, const void * right){
+	uint64_t l = *(const uint64_t*)left, r = *(const uint64_t*)right;
+	return (l > r) - (l < r);
+}
+
+static double elapsed(struct timeval * start, struct timeval * stop){
+	return (double)(stop->tv_sec - start->tv_sec)
+		+ (double)(stop->tv_usec - start->tv_usec) / 1e6;
+}
+
+
+static void find_run(size_t key_cnt){
+	std::vector<uint64_t> keys(key_cnt), stream(LOOKUP_CNT);
+	util::bst<uint64_t>   typed;
+	struct timeval        start, stop;
+	uint64_t              sum;
+	DS tree = DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64);
+	
+	for(size_t i=0; i<key_cnt; i++){
+		keys[i] = rng();
+		DS_insert(tree, &keys[i]);
+		typed.insert(keys[i]);
+	}
+	for(size_t i=0; i<LOOKUP_CNT; i++) stream[i] = keys[rng() % key_cnt];
+	
+	printf("%u lookups in a %zu node avl tree:\n", LOOKUP_CNT, key_cnt);
+	
+	sum = 0;
+	gettimeofday(&start, NULL);
+	for(size_t i=0; i<LOOKUP_CNT; i++)
+		sum += *(const uint64_t*)DS_find(tree, &stream[i]);
+	gettimeofday(&stop, NULL);
+	printf("\t%-10s %8.4fs (checksum %016" PRIx64 ")\n",
+		"DS_find", elapsed(&start, &stop), sum);
+	
+	sum = 0;
+	gettimeofday(&start, NULL);
+	for(size_t i=0; i<LOOKUP_CNT; i++) sum += *typed.find(stream[i]);
+	gettimeofday(&stop, NULL);
+	printf("\t%-10s %8.4fs (checksum %016" PRIx64 ")\n",
+		"util::bst", elapsed(&start, &stop), sum);
+	
+	DS_delete(tree);
+}
+
+
+// small trees show the cost of the calls, large ones the cost of cache misses
+int main(void){
+	for(size_t n=KEY_MIN; n<=KEY_MAX; n*=10) find_run(n);
+	return EXIT_SUCCESS;
+}
+
+
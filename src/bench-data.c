@@ -0,0 +1,942 @@
+/*******************************************************************************
+ *
+ *	lib-util : A Utility Library
+ *
+ *	Copyright (c) 2016-2018 Ammon Dodson
+ *	You should have received a copy of the licence terms with this software. If
+ *	not, please visit the project homepage at:
+ *	https://github.com/ammon0/lib-util
+ *
+ ******************************************************************************/
+
+/*	Benchmarks for the data structures in data.c
+ *	Timings are wall clock and only meaningful relative to each other.
+ */
+
+#include <util/data.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+
+#define KEY_CNT    100000
+#define LOOKUP_CNT 2000000
+#define MAP_CNT    10000000
+#define ARENA_CNT  1000000
+#define QUEUE_OPS  4000000 // entries through each queue
+#define PIPE_BATCH 64
+#define TASK_CNT   4000000
+#define BIG_CNT    200000
+#define STR_LEN    24
+#define SNAP_CNT   2000000
+#define SNAP_PATH  "bench-data.snap"
+#define HEAP_BYTES ((size_t)1<<25) // of data in each heap run
+#define GRAPH_CNT  1000000 // vertices
+#define GRAPH_DEG  8       // edges out of each vertex
+#define SYNC_OPS   8000000 // lookups and updates over all threads
+#define SYNC_WRITE 16      // one operation in this many is an update
+#define SORT_CNT   16000000 // 8-byte keys
+
+
+/******************************************************************************/
+//                                 HELPERS
+/******************************************************************************/
+
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15;
+
+// xorshift64*
+static uint64_t rng(void){
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545F4914F6CDD1D;
+}
+
+static inline const void * key(const void * data){ return data; }
+
+static imax cmp_u64(const void * left, const void * right){
+	uint64_t l = *(const uint64_t*)left, r = *(const uint64_t*)right;
+	return (l > r) - (l < r);
+}
+
+// a 64-bit mixer for integer keys
+static uint64_t hash_u64(const void * data){
+	uint64_t h = *(const uint64_t*)data;
+	
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static double elapsed(struct timeval * start, struct timeval * stop){
+	return (double)(stop->tv_sec - start->tv_sec)
+		+ (double)(stop->tv_usec - start->tv_usec) / 1e6;
+}
+
+/*	Fill stream with count draws from keys where the key of rank i is chosen
+ *	with probability proportional to 1/i^skew. A skew of 0 is uniform, 1 is the
+ *	classic Zipf distribution.
+ */
+static void zipf_stream(
+	uint64_t * stream,
+	size_t     count,
+	const uint64_t * keys,
+	size_t     key_cnt,
+	uint       skew
+){
+	double * cdf;
+	double   total = 0, weight, target;
+	size_t   lo, hi, mid;
+	
+	cdf = (double*) malloc(sizeof(double) * key_cnt);
+	if(!cdf){
+		puts("ERROR: out of memory");
+		exit(EXIT_FAILURE);
+	}
+	
+	for(size_t i=0; i<key_cnt; i++){
+		weight = 1;
+		for(uint j=0; j<skew; j++) weight /= (double)(i+1);
+		cdf[i] = total += weight;
+	}
+	
+	for(size_t i=0; i<count; i++){
+		target = (double)(rng() >> 11) / (double)(1ULL << 53) * total;
+	
+		lo = 0; hi = key_cnt-1;
+		while(lo < hi){
+			mid = lo + (hi-lo)/2;
+			if(cdf[mid] < target) lo = mid+1;
+			else hi = mid;
+		}
+		stream[i] = keys[lo];
+	}
+	
+	free(cdf);
+}
+
+
+/******************************************************************************/
+//                               BENCHMARKS
+/******************************************************************************/
+
+
+static void find_bench(
+	const char     * name,
+	DS               tree,
+	const uint64_t * keys,
+	const uint64_t * stream
+){
+	struct timeval start, stop;
+	uint64_t       sum = 0;
+	
+	for(size_t i=0; i<KEY_CNT; i++) DS_insert(tree, keys+i);
+	
+	gettimeofday(&start, NULL);
+	for(size_t i=0; i<LOOKUP_CNT; i++)
+		sum += *(const uint64_t*)DS_find(tree, stream+i);
+	gettimeofday(&stop, NULL);
+	
+	printf("\t%-6s %8.4fs (checksum %016lx)\n",
+		name, elapsed(&start, &stop), (unsigned long)sum);
+	
+	DS_delete(tree);
+}
+
+static void tree_bench(uint skew){
+	uint64_t *keys, *stream, temp;
+	size_t    j;
+	
+	keys   = (uint64_t*) malloc(sizeof(uint64_t) * KEY_CNT);
+	stream = (uint64_t*) malloc(sizeof(uint64_t) * LOOKUP_CNT);
+	if(!keys || !stream){
+		puts("ERROR: out of memory");
+		exit(EXIT_FAILURE);
+	}
+	
+	// shuffled keys so that popularity is unrelated to key order
+	for(size_t i=0; i<KEY_CNT; i++) keys[i] = i;
+	for(size_t i=KEY_CNT-1; i; i--){
+		j = rng() % (i+1);
+		temp = keys[i]; keys[i] = keys[j]; keys[j] = temp;
+	}
+	
+	zipf_stream(stream, LOOKUP_CNT, keys, KEY_CNT, skew);
+	
+	printf("DS_find() %u lookups over %u keys, zipf skew %u:\n",
+		LOOKUP_CNT, KEY_CNT, skew);
+	
+	// the bst is fed the same shuffled keys so it stays reasonably shallow
+	find_bench("bst"  , DS_new_bst  (sizeof(uint64_t), false, &key, &cmp_u64),
+		keys, stream);
+	find_bench("avl"  , DS_new_avl  (sizeof(uint64_t), false, &key, &cmp_u64),
+		keys, stream);
+	find_bench("splay", DS_new_splay(sizeof(uint64_t), false, &key, &cmp_u64),
+		keys, stream);
+	
+	free(stream);
+	free(keys);
+}
+
+// the tree holds pointers to strings and the keys are the strings
+static const void * str_key(const void * data){ return *(char * const*)data; }
+
+static imax cmp_str(const void * left, const void * right){
+	return strcmp((const char*)left, (const char*)right);
+}
+
+static void prefix_run(char ** strs, char ** stream, bool prefix){
+	struct timeval start, stop;
+	uint64_t       sum = 0;
+	DS             tree = DS_new_avl(sizeof(char*), false, &str_key, &cmp_str);
+	
+	if(prefix && DS_key_prefix(tree, &DS_prefix_string)){
+		puts("ERROR: could not set the key prefix");
+		exit(EXIT_FAILURE);
+	}
+	for(size_t i=0; i<KEY_CNT; i++) DS_insert(tree, strs+i);
+	
+	gettimeofday(&start, NULL);
+	for(size_t i=0; i<LOOKUP_CNT; i++)
+		sum += (uint64_t)**(char**)DS_find(tree, stream[i]);
+	gettimeofday(&stop, NULL);
+	
+	printf("\t%-10s %8.4fs (checksum %016lx)\n",
+		prefix? "prefix" : "plain", elapsed(&start, &stop), sum);
+	DS_delete(tree);
+}
+
+// string keys behind pointers, distinct within their first eight bytes
+static void prefix_bench(void){
+	char ** strs   = (char**) malloc(sizeof(char*) * KEY_CNT);
+	char ** stream = (char**) malloc(sizeof(char*) * LOOKUP_CNT);
+	
+	if(!strs || !stream){
+		puts("ERROR: out of memory");
+		exit(EXIT_FAILURE);
+	}
+	for(size_t i=0; i<KEY_CNT; i++){
+		strs[i] = (char*) malloc(STR_LEN);
+		if(!strs[i]){
+			puts("ERROR: out of memory");
+			exit(EXIT_FAILURE);
+		}
+		for(size_t j=0; j<STR_LEN-1; j++) strs[i][j] = (char)('a' + rng()%26);
+		strs[i][STR_LEN-1] = '\0';
+	}
+	for(size_t i=0; i<LOOKUP_CNT; i++) stream[i] = strs[rng() % KEY_CNT];
+	
+	printf("DS_find() %u lookups over %u string keys:\n", LOOKUP_CNT, KEY_CNT);
+	prefix_run(strs, stream, false);
+	prefix_run(strs, stream, true);
+	
+	for(size_t i=0; i<KEY_CNT; i++) free(strs[i]);
+	free(stream);
+	free(strs);
+}
+
+static void map_bench(const char * name, DS map, const uint64_t * keys){
+	struct timeval start, mid, stop;
+	uint64_t       sum = 0;
+	
+	gettimeofday(&start, NULL);
+	for(size_t i=0; i<MAP_CNT; i++) DS_insert(map, keys+i);
+	gettimeofday(&mid, NULL);
+	for(size_t i=0; i<MAP_CNT; i++)
+		sum += *(const uint64_t*)DS_find(map, keys + (i*7919)%MAP_CNT);
+	gettimeofday(&stop, NULL);
+	
+	printf("\t%-6s insert %8.4fs, find %8.4fs (checksum %016lx)\n",
+		name, elapsed(&start, &mid), elapsed(&mid, &stop), (unsigned long)sum);
+	
+	DS_delete(map);
+}
+
+// large ordered maps where every lookup misses the cache
+static void ordered_bench(void){
+	uint64_t *keys, temp;
+	size_t    j;
+	
+	keys = (uint64_t*) malloc(sizeof(uint64_t) * MAP_CNT);
+	if(!keys){
+		puts("ERROR: out of memory");
+		exit(EXIT_FAILURE);
+	}
+	
+	for(size_t i=0; i<MAP_CNT; i++) keys[i] = rng();
+	for(size_t i=MAP_CNT-1; i; i--){
+		j = rng() % (i+1);
+		temp = keys[i]; keys[i] = keys[j]; keys[j] = temp;
+	}
+	
+	printf("%u random keys:\n", MAP_CNT);
+	
+	map_bench("bst"  , DS_new_bst(sizeof(uint64_t), true, &key, &cmp_u64),
+		keys);
+	map_bench("btree", DS_new_btree(
+		sizeof(uint64_t), sizeof(uint64_t), true, &key, &cmp_u64
+	), keys);
+	
+	free(keys);
+}
+
+static void arena_bench(bool arena){
+	struct timeval start, mid, stop;
+	DS             tree;
+	uint64_t       num;
+	
+	gettimeofday(&start, NULL);
+	tree = DS_new_bst(sizeof(uint64_t), false, &key, &cmp_u64);
+	if(arena && DS_arena(tree, 0)) puts("ERROR: could not set the arena");
+	
+	for(size_t i=0; i<ARENA_CNT; i++){
+		num = rng();
+		DS_insert(tree, &num);
+	}
+	gettimeofday(&mid, NULL);
+	DS_delete(tree);
+	gettimeofday(&stop, NULL);
+	
+	printf("\t%-8s build %8.4fs, delete %8.4fs\n",
+		arena? "arena": "malloc", elapsed(&start, &mid), elapsed(&mid, &stop));
+}
+
+// build an AVL tree from sorted keys one insertion at a time or all at once
+static void bulk_bench(bool bulk, bool arena){
+	struct timeval start, stop;
+	DS             tree;
+	uint64_t *     keys = (uint64_t*) malloc(ARENA_CNT*sizeof(uint64_t));
+	
+	for(uint64_t i=0; i<ARENA_CNT; i++) keys[i] = i;
+	
+	gettimeofday(&start, NULL);
+	tree = DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64);
+	if(arena && DS_arena(tree, 0)) puts("ERROR: could not set the arena");
+	
+	if(!bulk) for(size_t i=0; i<ARENA_CNT; i++) DS_insert(tree, keys+i);
+	else if(DS_bulk_load(tree, keys, ARENA_CNT)) puts("ERROR: bulk load failed");
+	gettimeofday(&stop, NULL);
+	
+	printf("\t%-6s %-6s %8.4fs\n", bulk? "bulk": "insert",
+		arena? "arena": "malloc", elapsed(&start, &stop));
+	DS_delete(tree);
+	free(keys);
+}
+
+// rebuild a tree of random keys by insertion and from a snapshot
+static void snap_bench(void){
+	struct timeval start, stop;
+	DS             tree = DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64);
+	uint64_t       k;
+	
+	printf("%u node avl rebuild:\n", SNAP_CNT);
+	
+	gettimeofday(&start, NULL);
+	for(size_t i=0; i<SNAP_CNT; i++){
+		k = rng();
+		DS_insert(tree, &k);
+	}
+	gettimeofday(&stop, NULL);
+	printf("\t%-8s %8.4fs\n", "insert", elapsed(&start, &stop));
+	
+	gettimeofday(&start, NULL);
+	if(DS_save(tree, SNAP_PATH)) puts("ERROR: save failed");
+	gettimeofday(&stop, NULL);
+	printf("\t%-8s %8.4fs\n", "save", elapsed(&start, &stop));
+	DS_delete(tree);
+	
+	tree = DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64);
+	gettimeofday(&start, NULL);
+	if(DS_load(tree, SNAP_PATH)) puts("ERROR: load failed");
+	gettimeofday(&stop, NULL);
+	printf("\t%-8s %8.4fs\n", "load", elapsed(&start, &stop));
+	
+	remove(SNAP_PATH);
+	DS_delete(tree);
+}
+
+// a record too large to copy around cheaply
+typedef struct {
+	uint64_t key;
+	DS_hook  hook;
+	char     payload[256];
+} big;
+
+static imax cmp_big(const void * left, const void * right){
+	return cmp_u64(left, right); // the key comes first
+}
+
+// pass every record from a queue to a heap, and then from the heap to a tree
+static void intrusive_run(big * recs, bool intrusive){
+	struct timeval start, mid, stop;
+	DS             queue = DS_new_list(sizeof(big));
+	DS             heap  = DS_new_heap(sizeof(big), &cmp_big);
+	DS             tree  = DS_new_avl(sizeof(big), false, &key, &cmp_u64);
+	
+	if(intrusive && (DS_intrusive(queue, offsetof(big, hook))
+		|| DS_intrusive(heap, 0) || DS_intrusive(tree, offsetof(big, hook))))
+		puts("ERROR: could not make the structures intrusive");
+	
+	gettimeofday(&start, NULL);
+	for(size_t i=0; i<BIG_CNT; i++) DS_nq(queue, recs+i);
+	for(size_t i=0; i<BIG_CNT; i++) DS_insert(heap, DS_dq(queue));
+	gettimeofday(&mid, NULL);
+	for(size_t i=0; i<BIG_CNT; i++) DS_insert(tree, DS_remove(heap));
+	DS_empty(tree);
+	gettimeofday(&stop, NULL);
+	
+	printf("\t%-9s queue to heap %8.4fs, heap to tree %8.4fs\n",
+		intrusive? "intrusive" : "copying",
+		elapsed(&start, &mid), elapsed(&mid, &stop));
+	
+	DS_delete(queue);
+	DS_delete(heap);
+	DS_delete(tree);
+}
+
+static void intrusive_bench(void){
+	big * recs = (big*) calloc(BIG_CNT, sizeof(big));
+	
+	for(size_t i=0; i<BIG_CNT; i++) recs[i].key = rng();
+	
+	printf("%u %zu byte records:\n", BIG_CNT, sizeof(big));
+	intrusive_run(recs, false);
+	intrusive_run(recs, true);
+	free(recs);
+}
+
+// order elements of any size by the uint64_t at their start
+static int cmp_lead(const void * left, const void * right){
+	return (int)cmp_u64(left, right);
+}
+
+// heapify the same elements with each arity, in a buffer aligned for it
+static void heapify_bench(const uint * arities, uint arity_cnt){
+	struct timeval start, stop;
+	uint8_t *      base, * buffer;
+	uint64_t       k;
+	
+	printf("DS_heapify_arity() over %zu MiB:\n", HEAP_BYTES>>20);
+	for(size_t size=8; size<=256; size*=2){
+		base = (uint8_t*) aligned_alloc(64, HEAP_BYTES + 8*size);
+		memset(base, 0, HEAP_BYTES + 8*size);
+		
+		printf("\t%3zu bytes", size);
+		for(uint a=0; a<arity_cnt; a++){
+			buffer = base + (arities[a]-1)*size;
+			rng_state = 0x9E3779B97F4A7C15;
+			for(size_t i=0; i<HEAP_BYTES/size; i++){
+				k = rng();
+				memcpy(buffer + i*size, &k, sizeof(k));
+			}
+			
+			gettimeofday(&start, NULL);
+			DS_heapify_arity(buffer, HEAP_BYTES/size, size, &cmp_lead, arities[a]);
+			gettimeofday(&stop, NULL);
+			printf("  %u-ary %7.4fs", arities[a], elapsed(&start, &stop));
+		}
+		putchar('\n');
+		free(base);
+	}
+}
+
+// fill a heap with random keys and empty it again with each arity
+static void arity_bench(const uint * arities, uint arity_cnt){
+	struct timeval start, mid, stop;
+	uint8_t        data[256] = {0};
+	uint64_t       k;
+	DS             heap;
+	
+	printf("DS_heap fill and drain over %zu MiB:\n", HEAP_BYTES>>20);
+	for(size_t size=8; size<=sizeof(data); size*=2){
+		printf("\t%3zu bytes", size);
+		for(uint a=0; a<arity_cnt; a++){
+			heap = DS_new_heap(size, &cmp_u64);
+			if(DS_heap_arity(heap, arities[a])) puts("ERROR: bad arity");
+			rng_state = 0x9E3779B97F4A7C15;
+			
+			gettimeofday(&start, NULL);
+			for(size_t i=0; i<HEAP_BYTES/size; i++){
+				k = rng();
+				memcpy(data, &k, sizeof(k));
+				DS_insert(heap, data);
+			}
+			gettimeofday(&mid, NULL);
+			while(DS_remove(heap));
+			gettimeofday(&stop, NULL);
+			
+			printf("  %u-ary %7.4fs +%7.4fs", arities[a],
+				elapsed(&start, &mid), elapsed(&mid, &stop));
+			DS_delete(heap);
+		}
+		putchar('\n');
+	}
+}
+
+// fill and drain heaps of large records that copy them or only their keys
+static void keyed_bench(void){
+	struct timeval start, mid, stop;
+	uint8_t        data[512] = {0};
+	uint64_t       k;
+	DS             heap;
+	
+	printf("Heap of records fill and drain over %zu MiB:\n", HEAP_BYTES>>20);
+	for(size_t size=32; size<=sizeof(data); size*=2){
+		printf("\t%3zu bytes", size);
+		for(uint keyed=0; keyed<2; keyed++){
+			heap = keyed? DS_new_keyed_heap(size, sizeof(uint64_t), &key,
+				&cmp_u64) : DS_new_heap(size, &cmp_u64);
+			rng_state = 0x9E3779B97F4A7C15;
+			
+			gettimeofday(&start, NULL);
+			for(size_t i=0; i<HEAP_BYTES/size; i++){
+				k = rng();
+				memcpy(data, &k, sizeof(k));
+				DS_insert(heap, data);
+			}
+			gettimeofday(&mid, NULL);
+			while(DS_remove(heap));
+			gettimeofday(&stop, NULL);
+			
+			printf("  %-6s %7.4fs +%7.4fs", keyed? "keyed": "copied",
+				elapsed(&start, &mid), elapsed(&mid, &stop));
+			DS_delete(heap);
+		}
+		putchar('\n');
+	}
+}
+
+static void heap_bench(void){
+	static const uint arities[] = {2, 4, 8};
+	
+	heapify_bench(arities, sizeof(arities)/sizeof(uint));
+	arity_bench  (arities, sizeof(arities)/sizeof(uint));
+	keyed_bench();
+}
+
+// the dist comes first so that cmp_u64() orders these
+typedef struct {
+	uint64_t dist;
+	size_t   vertex;
+} path;
+
+/*	Shortest paths from vertex 0. Without decrease-key the array heap gets a
+ *	new entry on every improvement and skips the stale ones as they come out.
+ */
+static void dijkstra_run(const uint32_t * edges, bool pairing){
+	struct timeval start, stop;
+	DS             heap;
+	path **        handles = (path**) calloc(GRAPH_CNT, sizeof(path*));
+	uint64_t *     dist    = (uint64_t*) malloc(GRAPH_CNT*sizeof(uint64_t));
+	uint64_t       sum = 0, d;
+	size_t         peak = 0;
+	path           top, * next;
+	
+	heap = pairing? DS_new_pairing_heap(sizeof(path), &cmp_u64) :
+		DS_new_heap(sizeof(path), &cmp_u64);
+	for(size_t i=0; i<GRAPH_CNT; i++) dist[i] = UINT64_MAX;
+	
+	gettimeofday(&start, NULL);
+	dist[0] = 0;
+	handles[0] = (path*) DS_insert(heap, &(path){0, 0});
+	while(!DS_isempty(heap)){
+		if(DS_count(heap) > peak) peak = DS_count(heap);
+		top = *(const path*) DS_remove(heap);
+		if(top.dist != dist[top.vertex]) continue;
+		
+		for(size_t i=top.vertex*GRAPH_DEG; i<(top.vertex+1)*GRAPH_DEG; i++){
+			d = top.dist + (edges[i] >> 24);
+			if(d >= dist[edges[i] & 0xffffff]) continue;
+			
+			dist[edges[i] & 0xffffff] = d;
+			if(pairing && (next = handles[edges[i] & 0xffffff])){
+				next->dist = d;
+				if(DS_heap_update(heap, next)) puts("ERROR: update failed");
+			}
+			else handles[edges[i] & 0xffffff] = (path*) DS_insert(heap,
+				&(path){d, edges[i] & 0xffffff});
+		}
+	}
+	gettimeofday(&stop, NULL);
+	
+	for(size_t i=0; i<GRAPH_CNT; i++) if(dist[i] != UINT64_MAX) sum += dist[i];
+	printf("\t%-8s %8.4fs, peak %7zu entries (checksum %016lx)\n",
+		pairing? "pairing": "array", elapsed(&start, &stop), peak, sum);
+	
+	DS_delete(heap);
+	free(handles);
+	free(dist);
+}
+
+// the same search with the distances as radix heap keys, stale entries skipped
+static void dijkstra_radix(const uint32_t * edges){
+	struct timeval   start, stop;
+	DS               heap = DS_new_radix_heap(sizeof(size_t));
+	uint64_t *       dist = (uint64_t*) malloc(GRAPH_CNT*sizeof(uint64_t));
+	uint64_t         sum = 0, d, top;
+	size_t           peak = 0, vertex;
+	
+	for(size_t i=0; i<GRAPH_CNT; i++) dist[i] = UINT64_MAX;
+	
+	gettimeofday(&start, NULL);
+	dist[0] = 0;
+	DS_radix_push(heap, 0, &(size_t){0});
+	while(!DS_isempty(heap)){
+		if(DS_count(heap) > peak) peak = DS_count(heap);
+		vertex = *(const size_t*) DS_radix_pop(heap, &top);
+		if(top != dist[vertex]) continue;
+		
+		for(size_t i=vertex*GRAPH_DEG; i<(vertex+1)*GRAPH_DEG; i++){
+			d = top + (edges[i] >> 24);
+			if(d >= dist[edges[i] & 0xffffff]) continue;
+			
+			dist[edges[i] & 0xffffff] = d;
+			DS_radix_push(heap, d, &(size_t){edges[i] & 0xffffff});
+		}
+	}
+	gettimeofday(&stop, NULL);
+	
+	for(size_t i=0; i<GRAPH_CNT; i++) if(dist[i] != UINT64_MAX) sum += dist[i];
+	printf("\t%-8s %8.4fs, peak %7zu entries (checksum %016lx)\n",
+		"radix", elapsed(&start, &stop), peak, sum);
+	
+	DS_delete(heap);
+	free(dist);
+}
+
+// each edge holds the target vertex in its low 24 bits and the weight above
+static void dijkstra_bench(void){
+	uint32_t * edges = (uint32_t*) malloc(GRAPH_CNT*GRAPH_DEG*sizeof(uint32_t));
+	
+	for(size_t i=0; i<GRAPH_CNT*GRAPH_DEG; i++)
+		edges[i] = (uint32_t)(rng() % GRAPH_CNT)
+			| (uint32_t)(rng() % 255 + 1) << 24;
+	
+	printf("Dijkstra over %u vertices with %u edges each:\n",
+		GRAPH_CNT, GRAPH_DEG);
+	dijkstra_run(edges, false);
+	dijkstra_run(edges, true);
+	dijkstra_radix(edges);
+	free(edges);
+}
+
+// time one sort of the same keys, on threads threads or with DS_sort() if 0
+static double sort_run(uint64_t * keys, uint threads){
+	struct timeval start, stop;
+	
+	rng_state = 0x9E3779B97F4A7C15;
+	for(size_t i=0; i<SORT_CNT; i++) keys[i] = rng();
+	
+	gettimeofday(&start, NULL);
+	if(threads) DS_sort_parallel(keys, SORT_CNT, sizeof(uint64_t), &cmp_lead,
+		threads);
+	else DS_sort(keys, SORT_CNT, sizeof(uint64_t), &cmp_lead);
+	gettimeofday(&stop, NULL);
+	
+	for(size_t i=1; i<SORT_CNT; i++) if(keys[i-1] > keys[i]){
+		puts("ERROR: sort failed");
+		break;
+	}
+	return elapsed(&start, &stop);
+}
+
+// threads beyond the core count still show the cost of the extra merging
+static void sort_bench(void){
+	uint64_t * keys  = (uint64_t*) malloc(SORT_CNT*sizeof(uint64_t));
+	long       cores = sysconf(_SC_NPROCESSORS_ONLN);
+	uint       max   = cores > 4? (uint)cores : 4;
+	double     base;
+	
+	printf("Sorting %u random keys on %ld cores:\n", SORT_CNT, cores);
+	base = sort_run(keys, 0);
+	printf("\tDS_sort          %8.4fs\n", base);
+	for(uint threads=1; threads<=max; threads<<=1){
+		double secs = sort_run(keys, threads);
+		printf("\t%2u threads       %8.4fs  %5.2fx\n", threads, secs,
+			base/secs);
+	}
+	free(keys);
+}
+
+struct queue_job{
+	DS              queue;
+	pthread_mutex_t lock;
+	size_t          ops;
+	bool            locked;
+	int8_t          pad[sizeof(size_t)-sizeof(bool)];
+};
+
+// every thread alternates between producing and consuming
+static void * queue_worker(void * arg){
+	struct queue_job * job = (struct queue_job*) arg;
+	uint64_t           num = 0;
+	
+	for(size_t i=0; i<job->ops; i++){
+		if(job->locked){
+			pthread_mutex_lock(&job->lock);
+			DS_nq(job->queue, &num);
+			pthread_mutex_unlock(&job->lock);
+			pthread_mutex_lock(&job->lock);
+			DS_dq(job->queue);
+			pthread_mutex_unlock(&job->lock);
+		}
+		else{
+			while(!DS_try_nq(job->queue, &num)) sched_yield();
+			while(!DS_try_dq(job->queue, &num)) sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static double queue_run(bool locked, uint threads){
+	struct queue_job job;
+	struct timeval   start, stop;
+	pthread_t        tid[8];
+	
+	job.locked = locked;
+	job.ops    = QUEUE_OPS/threads;
+	job.queue  = locked? DS_new_list(sizeof(uint64_t)) :
+		DS_new_mpmc_queue(sizeof(uint64_t), 1024);
+	pthread_mutex_init(&job.lock, NULL);
+	
+	gettimeofday(&start, NULL);
+	for(uint i=0; i<threads; i++)
+		pthread_create(tid+i, NULL, &queue_worker, &job);
+	for(uint i=0; i<threads; i++) pthread_join(tid[i], NULL);
+	gettimeofday(&stop, NULL);
+	
+	pthread_mutex_destroy(&job.lock);
+	DS_delete(job.queue);
+	return elapsed(&start, &stop);
+}
+
+struct pipe_job{
+	DS     queue;
+	size_t batch;
+};
+
+static void * pipe_producer(void * arg){
+	struct pipe_job * job = (struct pipe_job*) arg;
+	uint64_t          batch[PIPE_BATCH];
+	size_t            sent = 0, done;
+	
+	while(sent < QUEUE_OPS){
+		for(size_t i=0; i<job->batch; i++) batch[i] = sent+i;
+		
+		if(job->batch == 1) done = DS_try_nq(job->queue, batch);
+		else done = DS_nq_batch(job->queue, batch, job->batch);
+		
+		if(!done) sched_yield();
+		sent += done;
+	}
+	return NULL;
+}
+
+// nanoseconds per entry from one producer to one consumer
+static double pipe_run(DS queue, size_t batch){
+	struct pipe_job job;
+	struct timeval  start, stop;
+	pthread_t       tid;
+	uint64_t        buf[PIPE_BATCH], sum = 0;
+	size_t          got = 0, done;
+	
+	job.queue = queue;
+	job.batch = batch;
+	
+	gettimeofday(&start, NULL);
+	pthread_create(&tid, NULL, &pipe_producer, &job);
+	while(got < QUEUE_OPS){
+		if(batch == 1) done = DS_try_dq(queue, buf);
+		else done = DS_dq_batch(queue, buf, batch);
+		
+		if(!done) sched_yield();
+		for(size_t i=0; i<done; i++) sum += buf[i];
+		got += done;
+	}
+	pthread_join(tid, NULL);
+	gettimeofday(&stop, NULL);
+	
+	if(sum != (uint64_t)QUEUE_OPS*(QUEUE_OPS-1)/2) puts("ERROR: lost entries");
+	DS_delete(queue);
+	return elapsed(&start, &stop)*1e9/QUEUE_OPS;
+}
+
+static void queue_bench(void){
+	printf("%u queue round trips:\n", QUEUE_OPS);
+	
+	for(uint threads=1; threads<=8; threads<<=1)
+		printf("\t%u threads mutex list %8.4fs, mpmc %8.4fs\n", threads,
+			queue_run(true, threads), queue_run(false, threads));
+	
+	printf("%u entries from one producer to one consumer:\n", QUEUE_OPS);
+	printf("\tmpmc          %6.1fns per entry\n",
+		pipe_run(DS_new_mpmc_queue(sizeof(uint64_t), 1024), 1));
+	printf("\tspsc          %6.1fns per entry\n",
+		pipe_run(DS_new_spsc_queue(sizeof(uint64_t), 1024), 1));
+	printf("\tspsc batch %2u %6.1fns per entry\n", PIPE_BATCH,
+		pipe_run(DS_new_spsc_queue(sizeof(uint64_t), 1024), PIPE_BATCH));
+}
+
+struct steal_job{
+	DS            deque;
+	atomic_size_t stolen;
+	atomic_bool   finished;
+	int8_t        pad[sizeof(size_t)-sizeof(atomic_bool)];
+};
+
+static void * steal_worker(void * arg){
+	struct steal_job * job = (struct steal_job*) arg;
+	uint64_t           task;
+	size_t             stolen = 0;
+	
+	while(!atomic_load_explicit(&job->finished, memory_order_relaxed)){
+		if(DS_steal(job->deque, &task)) stolen++;
+		else sched_yield();
+	}
+	while(DS_steal(job->deque, &task)) stolen++;
+	
+	atomic_fetch_add(&job->stolen, stolen);
+	return NULL;
+}
+
+// the owner makes tasks and runs every other one itself
+static void steal_run(uint thieves){
+	struct steal_job job;
+	struct timeval   start, stop;
+	pthread_t        tid[8];
+	uint64_t         task;
+	
+	job.deque = DS_new_ws_deque(sizeof(uint64_t));
+	atomic_init(&job.finished, false);
+	atomic_init(&job.stolen, 0);
+	
+	gettimeofday(&start, NULL);
+	for(uint i=0; i<thieves; i++)
+		pthread_create(tid+i, NULL, &steal_worker, &job);
+	
+	for(task=0; task<TASK_CNT; task++){
+		DS_push_bottom(job.deque, &task);
+		if(task&1) DS_pop_bottom(job.deque, &task);
+	}
+	while(DS_pop_bottom(job.deque, &task));
+	
+	atomic_store(&job.finished, true);
+	for(uint i=0; i<thieves; i++) pthread_join(tid[i], NULL);
+	gettimeofday(&stop, NULL);
+	
+	printf("\t%u thieves %8.4fs, %5.1f%% stolen\n", thieves,
+		elapsed(&start, &stop),
+		100.0*(double)atomic_load(&job.stolen)/TASK_CNT);
+	DS_delete(job.deque);
+}
+
+static void steal_bench(void){
+	printf("%u tasks through a work stealing deque:\n", TASK_CNT);
+	for(uint thieves=0; thieves<=8; thieves = thieves? thieves<<1 : 1)
+		steal_run(thieves);
+}
+
+struct sync_job{
+	DS              map;
+	pthread_mutex_t lock; // guards a plain hash table
+	size_t          ops;
+	bool            locked;
+	int8_t          pad[sizeof(size_t)-sizeof(bool)];
+};
+
+static void * sync_worker(void * arg){
+	struct sync_job * job = (struct sync_job*) arg;
+	uint64_t          num, seed = (uintptr_t)&num, found = 0;
+	
+	for(size_t i=0; i<job->ops; i++){
+		seed = hash_u64(&seed);
+		num  = seed % KEY_CNT;
+		
+		if(job->locked){
+			pthread_mutex_lock(&job->lock);
+			if(i%SYNC_WRITE) found += DS_find(job->map, &num) != NULL;
+			else if(!DS_find(job->map, &num)) DS_insert(job->map, &num);
+			pthread_mutex_unlock(&job->lock);
+		}
+		else if(i%SYNC_WRITE) found += DS_sync_find(job->map, &num, &num);
+		else DS_sync_insert(job->map, &num);
+	}
+	
+	if(!found) puts("ERROR: nothing found");
+	return NULL;
+}
+
+// millions of operations per second
+static double sync_run(bool locked, uint threads){
+	struct sync_job job;
+	struct timeval  start, stop;
+	pthread_t       tid[32];
+	
+	job.locked = locked;
+	job.ops    = SYNC_OPS/threads;
+	job.map    = locked? DS_new_hash(sizeof(uint64_t), 0, false,
+		&hash_u64) : DS_new_sync_hash(sizeof(uint64_t), 0, &hash_u64);
+	pthread_mutex_init(&job.lock, NULL);
+	
+	for(uint64_t i=0; i<KEY_CNT; i++){
+		if(locked) DS_insert(job.map, &i);
+		else DS_sync_insert(job.map, &i);
+	}
+	
+	gettimeofday(&start, NULL);
+	for(uint i=0; i<threads; i++)
+		pthread_create(tid+i, NULL, &sync_worker, &job);
+	for(uint i=0; i<threads; i++) pthread_join(tid[i], NULL);
+	gettimeofday(&stop, NULL);
+	
+	pthread_mutex_destroy(&job.lock);
+	DS_delete(job.map);
+	return (double)SYNC_OPS/elapsed(&start, &stop)/1e6;
+}
+
+static void sync_bench(void){
+	printf("%u hash map operations, one in %u an update:\n",
+		SYNC_OPS, SYNC_WRITE);
+	for(uint threads=1; threads<=32; threads<<=1)
+		printf("\t%2u threads mutex hash %6.1fM/s, sync hash %6.1fM/s\n",
+			threads, sync_run(true, threads), sync_run(false, threads));
+}
+
+
+int main(void){
+	tree_bench(0);
+	tree_bench(1);
+	tree_bench(2);
+	ordered_bench();
+	prefix_bench();
+	
+	printf("%u node bst build and teardown:\n", ARENA_CNT);
+	arena_bench(false);
+	arena_bench(true);
+	
+	printf("%u node avl build from sorted keys:\n", ARENA_CNT);
+	bulk_bench(false, false);
+	bulk_bench(false, true);
+	bulk_bench(true, false);
+	bulk_bench(true, true);
+	snap_bench();
+	
+	intrusive_bench();
+	heap_bench();
+	dijkstra_bench();
+	sort_bench();
+	queue_bench();
+	steal_bench();
+	sync_bench();
+	
+	return EXIT_SUCCESS;
+}
@@ -18,6 +18,9 @@
 /******************************************************************************/
 
 
+// mmap()
+#define _POSIX_C_SOURCE 200809L
+
 #include <util/data.h>
 #include <util/types.h>
 #include <util/msg.h>
@@ -25,6 +28,13 @@
 #include <util/io.h>
 
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 
@@ -34,13 +44,31 @@
 
 
 #define DS_DEFAULT_TABLE_SZ 1023
+#define DS_DEFAULT_HEAP_SZ  64
+#define DS_DEFAULT_ARITY    4
+#define DS_DEFAULT_RADIX_SZ 16
+#define DS_DEFAULT_ARRAY_SZ 64
+#define DS_DEFAULT_SLAB_SZ  ((size_t)1<<16)
+#define DS_DEFAULT_DEQUE_SZ 64
+#define DS_DEFAULT_SHARDS   64
 
 typedef enum {
 	DS_list,
 	DS_circular_list,
+	DS_unrolled,
+	DS_array,
 	DS_bst,
+	DS_avl,
+	DS_splay,
+	DS_btree,
 	DS_heap,
-	DS_hash
+	DS_hash,
+	DS_mpmc,
+	DS_spsc,
+	DS_wsdeque,
+	DS_sync,
+	DS_pairing,
+	DS_radix
 } DS_type;
 
 typedef struct _list_node {
@@ -49,18 +77,170 @@ typedef struct _list_node {
 	int8_t data[];
 } * _lnode_pt;
 
+/*	Blocks of an unrolled list. The entries are data[start] to
+ *	data[start+count-1].
+ */
+typedef struct _list_block {
+	struct _list_block * next; // also links the freelist
+	struct _list_block * prev;
+	uint                 start;
+	uint                 count;
+	int8_t data[];
+} * _ublock_pt;
+
 typedef struct _tree_node {
 	struct _tree_node * parent;
 	struct _tree_node * left  ;
 	struct _tree_node * right ;
+	size_t              height; // of the subtree
+	size_t              size;   // number of nodes in the subtree
+	uint64_t            prefix; // of the key, when the tree has DS_key_prefix()
 	int8_t data[];
 } * _tnode_pt;
 
+typedef struct _btree_node {
+	struct _btree_node * parent;
+	struct _btree_node * prev; // leaves are linked in order
+	struct _btree_node * next; // also links the freelist
+	uint                 count; // number of keys
+	uint                 level; // 0 for leaves
+	int8_t keys[];
+} * _bnode_pt;
+
+/*	Hash tables are stored as a flat array of slots. Each slot carries the full
+ *	hash of its entry so that lookups and table growth never have to call the
+ *	hash function again.
+ */
+typedef struct _hash_slot {
+	uint64_t hash;
+	uint64_t dist; // distance from the home slot plus one, 0 if the slot is empty
+	int8_t data[];
+} * _hslot_pt;
+
+/*	Heaps are stored as a flat array of entries. The serial number records the
+ *	order of insertion so that equal entries come out first-in-first-out.
+ */
+typedef struct _heap_entry {
+	uint64_t serial;
+	int8_t data[];
+} * _hent_pt;
+
+/*	Node memory for structures with an arena. Nodes are handed out from the
+ *	front of the newest slab.
+ */
+typedef struct _slab {
+	struct _slab * next;
+	size_t         used; // bytes handed out
+	int8_t data[];
+} * _slab_pt;
+
+/*	Bounded lock free queues follow Dmitry Vyukov's design. Each cell carries a
+ *	sequence number saying which producer or consumer ticket may use it next, so
+ *	producers only contend on enq and consumers only on deq. The two counters
+ *	are kept on separate cache lines.
+ */
+#define _CACHE_LINE 64
+
+typedef struct _queue_cell {
+	atomic_size_t seq;
+	int8_t data[];
+} * _qcell_pt;
+
+typedef struct _queue {
+	_Alignas(_CACHE_LINE) atomic_size_t enq; // next producer ticket
+	int8_t enq_pad[_CACHE_LINE - sizeof(atomic_size_t)];
+	atomic_size_t deq; // next consumer ticket
+	int8_t deq_pad[_CACHE_LINE - sizeof(atomic_size_t)];
+	int8_t cells[];
+} * _queue_pt;
+
+/*	Single-producer single-consumer rings need no atomic read-modify-write. Each
+ *	side owns one index and keeps a private copy of the other, which it only
+ *	reloads when the copy says the ring is full or empty.
+ */
+typedef struct _ring {
+	_Alignas(_CACHE_LINE) atomic_size_t back; // written by the producer
+	size_t front_seen; // the producer's copy of front
+	int8_t back_pad[_CACHE_LINE - sizeof(atomic_size_t) - sizeof(size_t)];
+	atomic_size_t front; // written by the consumer
+	size_t back_seen; // the consumer's copy of back
+	int8_t front_pad[_CACHE_LINE - sizeof(atomic_size_t) - sizeof(size_t)];
+	int8_t data[];
+} * _ring_pt;
+
+/*	Work stealing deques follow Chase and Lev, with the memory orderings of Le et
+ *	al. The owner pushes and pops at the bottom, and thieves take from the top
+ *	with a single CAS. The entries live in a separate array that the owner
+ *	replaces when it fills. Thieves may still be reading a replaced array, so
+ *	it is kept on the freelist until the deque is flushed.
+ */
+typedef struct _deque_array {
+	struct _deque_array * next; // links replaced arrays
+	size_t                size; // a power of two
+	int8_t data[];
+} * _darray_pt;
+
+typedef struct _deque {
+	_Alignas(_CACHE_LINE) _Atomic(imax) top; // thieves take from here
+	int8_t              top_pad[_CACHE_LINE - sizeof(_Atomic(imax))];
+	_Atomic(imax)       bottom; // the owner works here
+	_Atomic(_darray_pt) array;
+	int8_t              bottom_pad[
+		_CACHE_LINE - sizeof(_Atomic(imax)) - sizeof(_Atomic(_darray_pt))];
+} * _deque_pt;
+
+typedef struct _shard * _shard_pt;
+
+/*	Radix heaps sort their entries into buckets by the highest bit in which
+ *	each key differs from the last key removed. Bucket i holds the keys that
+ *	first differ in bit i-1, and bucket 0 the keys equal to it. Keys may not
+ *	be less than the last key removed, so the lowest bucket that is not empty
+ *	holds the smallest keys. Each entry is its key followed by its data.
+ */
+#define _RADIX_BUCKETS 65
+
+typedef struct _radix_bucket {
+	int8_t * entries;
+	size_t   start; // the next entry to remove, only bucket 0 removes any
+	size_t   count; // entries before count are in use
+	size_t   size;  // room for entries
+} * _rbucket_pt;
+
+typedef struct _radix {
+	uint64_t             last; // the key last removed
+	struct _radix_bucket bucket[_RADIX_BUCKETS];
+} * _radix_pt;
+
 typedef union {
 	_lnode_pt l;
+	_ublock_pt u;
 	_tnode_pt t;
+	_bnode_pt b;
+	_hslot_pt h;
+	int8_t *  a;
+	_hent_pt  e;
+	_queue_pt q;
+	_ring_pt  r;
+	_deque_pt d;
+	_darray_pt w;
+	_shard_pt s;
+	_radix_pt x;
 } _node_pt;
 
+/*	Cursors keep a position of their own so that any number of them can read a
+ *	structure without moving its current position.
+ */
+struct _cursor {
+	DS       root;
+	_node_pt node;  // NULL until the cursor is placed
+	size_t   index; // in an unrolled block, B-tree leaf, array, or heap
+};
+
+/*	Comparison used by the array based heap functions. The context allows the
+ *	same sifting code to serve both DS_heap and the caller's arrays.
+ */
+typedef imax (*_cmp_pt)(const void * ctx, const void * left, const void * right);
+
 struct _root {
 	_node_pt     head;
 	_node_pt     tail;
@@ -71,14 +251,89 @@ struct _root {
 		uint64_t     (*hash)(const void * data);
 	} keys;
 	imax         (*cmp_keys) (const void * left, const void * right);
+	uint64_t     (*prefix)   (const void * key); // orders keys before cmp_keys
+	_slab_pt     arena;
+	size_t       slab_size; // 0 if nodes are allocated individually
+	uint64_t     serial; // the next heap serial number
 	size_t       data_size;
 	size_t       key_size;
-	size_t       table_size;
+	size_t       table_size; // number of slots in an array based structure
+	size_t       index;    // position of current in an array or B-tree leaf,
+	                       // or the hash slots a walk has wrapped into
+	size_t       hook;     // offset of the DS_hook in an intrusive record
+	size_t       slots; // payloads of a keyed heap, those past count are free
+	uint         leaf_cap; // entries per B-tree leaf or unrolled list block,
+	                       // or children per heap node
+	uint         node_cap; // keys per internal B-tree node
 	DS_type      type;
 	uint         count;  // number of nodes in the structure
 	bool         dups;  // duplicate data allowed
+	bool         shared; // a concurrent hash map shard with lock free readers
+	bool         intrusive; // nodes are DS_hooks inside the caller's records
+	int8_t       pad[sizeof(size_t) - 3*sizeof(bool)];
+};
+
+/*	Concurrent hash maps are split into shards, each an ordinary hash table
+ *	with a mutex for its writers. Readers never lock. A writer makes the
+ *	sequence number odd while it changes the table, and a reader keeps what it
+ *	copied out only if the sequence number was even and unchanged all along.
+ *	Readers find the table through slots and size, which the writer publishes
+ *	when it unlocks, and never through the root of the table.
+ */
+struct _shard {
+	_Alignas(_CACHE_LINE) pthread_mutex_t lock;
+	struct _root                          table;
+	_Atomic(_hslot_pt)                    slots; // table.head.h
+	atomic_size_t                         size;  // table.table_size
+	atomic_uint                           seq;
+	int8_t                                pad[_CACHE_LINE - (
+		sizeof(pthread_mutex_t) + sizeof(struct _root) +
+		sizeof(_Atomic(_hslot_pt)) + sizeof(atomic_size_t) +
+		sizeof(atomic_uint)
+	) % _CACHE_LINE];
 };
 
+/*	Structures that move their data around return removed data from a scratch
+ *	area allocated just past the root.
+ */
+#define _scratch(R) ((void*)((R)+1))
+
+/*	Intrusive lists and trees use the DS_hook in the caller's record as the node
+ *	header, so only the way from a node to its data differs. Intrusive heaps
+ *	keep a pointer to each record in place of its data.
+ */
+_Static_assert(sizeof(DS_hook) == sizeof(struct _tree_node),
+	"DS_hook must match the tree node header");
+_Static_assert(sizeof(DS_hook) >= sizeof(struct _list_node),
+	"DS_hook must cover the list node header");
+
+#define _data(R,N) ((R)->intrusive? (int8_t*)(N) - (R)->hook : (N)->data)
+#define _hook(R,D) ((int8_t*)(D) + (R)->hook)
+#define _edata(R,E) (((R)->intrusive || (R)->key_size)? \
+	*(int8_t**)(void*)(E)->data : (E)->data)
+
+/*	B-tree node layout. Keys come first, followed by the data in a leaf or the
+ *	child pointers in an internal node.
+ */
+#define _BTREE_NODE_SZ ((size_t)1<<12)
+
+#define _bkeys_sz(R,C) (((size_t)(C)*(R)->key_size+7) & ~(size_t)7)
+#define _bkey(R,N,I)   ((N)->keys + (size_t)(I)*(R)->key_size)
+#define _bdata(R,N,I) \
+	((N)->keys + _bkeys_sz(R,(R)->leaf_cap) + (size_t)(I)*(R)->data_size)
+#define _bchild(R,N)   ((_bnode_pt*)((N)->keys + _bkeys_sz(R,(R)->node_cap)))
+
+inline static size_t __attribute__((pure)) _btree_node_sz(const DS root){
+	size_t leaf, node;
+	
+	leaf = sizeof(struct _btree_node) + _bkeys_sz(root, root->leaf_cap)
+		+ root->leaf_cap*root->data_size;
+	node = sizeof(struct _btree_node) + _bkeys_sz(root, root->node_cap)
+		+ (root->node_cap+1)*sizeof(_bnode_pt);
+	
+	return leaf > node? leaf : node;
+}
+
 /********************************* MESSAGES ***********************************/
 
 // ERRORS
@@ -88,6 +343,8 @@ const char* _e_nsense ="ERROR: Nonsensical action for given structure type";
 const char* _e_null   ="ERROR: the DS pointer is NULL";
 const char* _e_nimp   ="ERROR: that feature is not implemented";
 const char* _e_over   ="ERROR: Overflow";
+const char* _e_file   ="ERROR: Could not read or write the snapshot file";
+const char* _e_snap   ="ERROR: The file is not a snapshot of this structure";
 
 
 /******************************************************************************/
@@ -100,20 +357,90 @@ inline static void _error(const char * message){
 	msg_print(NULL, V_ERROR, "data.h: %s\n", message);
 }
 
-inline static _node_pt _new_node(const DS const root){
+// the size of one node, 0 for structures that are not made of nodes
+inline static size_t __attribute__((pure)) _node_sz(const DS root){
+	switch(root->type){
+	case DS_list         :
+	case DS_circular_list: return sizeof(struct _list_node)+root->data_size;
+	case DS_unrolled     :
+		return sizeof(struct _list_block)+root->leaf_cap*root->data_size;
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_pairing      : return sizeof(struct _tree_node)+root->data_size;
+	case DS_btree        : return _btree_node_sz(root);
+	case DS_heap         : return root->key_size? root->data_size : 0;
+	case DS_array        :
+	case DS_hash         :
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	default              : return 0;
+	}
+}
+
+/*	Get memory for a new node. Structures with an arena carve their nodes out of
+ *	large slabs that are only released all at once.
+ */
+static void * _alloc_node(DS root){
+	const size_t size = (_node_sz(root)+7) & ~(size_t)7;
+	_slab_pt     slab = root->arena;
+	void *       node;
+	
+	if(!root->slab_size){
+		if(!( node = malloc(size) )) _error(_e_mem);
+		return node;
+	}
+	
+	if(!slab || slab->used + size > root->slab_size){
+		slab = (_slab_pt) malloc(sizeof(struct _slab) + root->slab_size);
+		if(!slab){
+			_error(_e_mem);
+			return NULL;
+		}
+		slab->next  = root->arena;
+		slab->used  = 0;
+		root->arena = slab;
+	}
+	
+	node = slab->data + slab->used;
+	slab->used += size;
+	return node;
+}
+
+// free every slab, optionally keeping the newest one for reuse
+static void _arena_release(DS root, bool keep){
+	_slab_pt slab = root->arena, dead;
+	
+	if(keep && slab){
+		slab->used = 0;
+		slab = slab->next;
+		root->arena->next = NULL;
+	}
+	else root->arena = NULL;
+	
+	while(slab){
+		dead = slab;
+		slab = slab->next;
+		free(dead);
+	}
+}
+
+inline static _node_pt _new_node(const DS root){
 	_node_pt new_node; // will return null on failure
 	
 	switch(root->type){
 	case DS_list         :
 	case DS_circular_list:
-	case DS_hash         :
 		if (root->freelist.l){ // check the freelist first
 			new_node = root->freelist;
 			root->freelist.l = root->freelist.l->prev;
 		}
 		else {
-			new_node.l=(_lnode_pt) malloc(sizeof(struct _list_node)+root->data_size);
-			if (!new_node.l) _error(_e_mem);
+			new_node.l=(_lnode_pt) _alloc_node(root);
+			if (!new_node.l) return new_node;
 		}
 		
 		// Make sure it's clean for the next use
@@ -121,24 +448,70 @@ inline static _node_pt _new_node(const DS const root){
 		new_node.l->prev = NULL;
 		break;
 	
-	case DS_heap:
+	case DS_unrolled:
+		if (root->freelist.u){
+			new_node = root->freelist;
+			root->freelist.u = root->freelist.u->next;
+		}
+		else {
+			new_node.u=(_ublock_pt) _alloc_node(root);
+			if (!new_node.u) return new_node;
+		}
+		
+		// Make sure it's clean for the next use
+		new_node.u->next  = NULL;
+		new_node.u->prev  = NULL;
+		new_node.u->start = 0;
+		new_node.u->count = 0;
+		break;
+	
 	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+	case DS_pairing:
 		if (root->freelist.t){
 			new_node = root->freelist;
 			root->freelist.t = root->freelist.t->left;
 		}
 		else{
-			new_node.t=(_tnode_pt) malloc(sizeof(struct _tree_node)+root->data_size);
-			if (!new_node.t) _error(_e_mem);
+			new_node.t=(_tnode_pt) _alloc_node(root);
+			if (!new_node.t) return new_node;
 		}
 		
 		// Make sure it's clean for the next use
 		new_node.t->left = NULL;
 		new_node.t->right = NULL;
 		new_node.t->parent = NULL;
+		new_node.t->height = 1;
+		new_node.t->size   = 1;
 		break;
 	
+	case DS_btree:
+		if (root->freelist.b){
+			new_node = root->freelist;
+			root->freelist.b = root->freelist.b->next;
+		}
+		else{
+			new_node.b=(_bnode_pt) _alloc_node(root);
+			if (!new_node.b) return new_node;
+		}
+		
+		// Make sure it's clean for the next use
+		new_node.b->parent = NULL;
+		new_node.b->prev   = NULL;
+		new_node.b->next   = NULL;
+		new_node.b->count  = 0;
+		new_node.b->level  = 0;
+		break;
 	
+	case DS_array:
+	case DS_heap:
+	case DS_hash:
+	case DS_sync:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_radix:
+	case DS_mpmc:
 	default:
 		_error(_e_invtype);
 		new_node.l = NULL;
@@ -147,6 +520,38 @@ inline static _node_pt _new_node(const DS const root){
 	return new_node;
 }
 
+/*	A list or tree node holding data. An intrusive structure takes the hook in
+ *	the caller's record instead of copying.
+ */
+static _node_pt _data_node(const DS root, const void * data){
+	_node_pt node;
+	
+	if(!root->intrusive){
+		node = _new_node(root);
+		if(!node.l) return node;
+		
+		if(root->type == DS_list || root->type == DS_circular_list)
+			memcpy(node.l->data, data, root->data_size);
+		else memcpy(node.t->data, data, root->data_size);
+		return node;
+	}
+	
+	node.a = _hook(root, data);
+	memset(node.a, 0, sizeof(DS_hook));
+	if(root->type != DS_list && root->type != DS_circular_list){
+		node.t->height = 1;
+		node.t->size   = 1;
+	}
+	return node;
+}
+
+// move a removed list node to the freelist, an intrusive one is the caller's
+inline static void _lnode_free(DS root, _lnode_pt node){
+	if(root->intrusive) return;
+	node->prev = root->freelist.l;
+	root->freelist.l = node;
+}
+
 inline static void _print_node(_tnode_pt node, uint lvl){
 	for (uint i=0; i<lvl; i++)
 		printf("   ");
@@ -169,1089 +574,5431 @@ inline static void _print_node(_tnode_pt node, uint lvl){
 	}
 }
 
-inline static _tnode_pt _remove_least_in_tree(_tnode_pt * parent_pt){
-	_tnode_pt node;
-	
-	while((*parent_pt)->left) parent_pt = &(*parent_pt)->left;
+/*********************************** TREES ************************************/
+
+#define _height(N) ((N)? (N)->height : 0)
+#define _size(N)   ((N)? (N)->size   : 0)
+
+// recalculate the height and size of a node from its children
+inline static void _tree_update(_tnode_pt node){
+	node->height = 1 + (_height(node->left) > _height(node->right)?
+		_height(node->left) : _height(node->right));
+	node->size = 1 + _size(node->left) + _size(node->right);
+}
+
+// count a newly linked node in the size of every subtree above it
+inline static void _tree_grow(_tnode_pt node){
+	while(( node = node->parent )) node->size++;
+}
+
+static _tnode_pt __attribute__((pure)) _tree_min(_tnode_pt node){
+	while(node->left) node = node->left;
+	return node;
+}
+
+static _tnode_pt __attribute__((pure)) _tree_max(_tnode_pt node){
+	while(node->right) node = node->right;
+	return node;
+}
+
+// the in-order successor of node, NULL after the last node
+static _tnode_pt __attribute__((pure)) _tree_next(_tnode_pt node){
+	// We can assume the left children have already been visited
+	if(node->right) return _tree_min(node->right);
 	
-	// we know there is no left child, but there may be a right
-	node = *parent_pt;
-	*parent_pt = node->right;
+	/* If there are no more right children then we must go up. To prevent
+	duplicate visits, we must go up until we approach a parent from the left
+	child
+	*/
+	while(node->parent && node->parent->right == node) node = node->parent;
+	return node->parent;
+}
+
+// the in-order predecessor of node, NULL before the first node
+static _tnode_pt __attribute__((pure)) _tree_prev(_tnode_pt node){
+	if(node->left) return _tree_max(node->left);
 	
+	while(node->parent && node->parent->left == node) node = node->parent;
+	return node->parent;
+}
+
+// the node with the given zero based in-order index
+static _tnode_pt __attribute__((pure)) _tree_select(_tnode_pt node, size_t idx){
+	while(idx != _size(node->left)){
+		if(idx < _size(node->left)) node = node->left;
+		else{
+			idx -= _size(node->left)+1;
+			node = node->right;
+		}
+	}
 	return node;
 }
 
+/*	Compare key, whose prefix is given, with the key of node. Keys with
+ *	different prefixes are ordered without touching the data at all.
+ */
+inline static imax
+_tree_cmp(const DS root, const void * key, uint64_t prefix, _tnode_pt node){
+	if(root->prefix && prefix != node->prefix)
+		return prefix < node->prefix? -1 : 1;
+	return root->cmp_keys(key, root->keys.key(_data(root, node)));
+}
 
-/******************************************************************************/
-//                       PUBLIC FUNCTION DEFINITIONS
-/******************************************************************************/
+inline static uint64_t _tree_prefix(const DS root, const void * key){
+	return root->prefix? root->prefix(key) : 0;
+}
 
+// the node holding key, or NULL and the last node visited in *last
+static _tnode_pt
+_tree_search(const DS root, const void * key, _tnode_pt * last){
+	_tnode_pt node   = root->head.t;
+	uint64_t  prefix = _tree_prefix(root, key);
+	imax      result;
+	
+	*last = NULL;
+	while(node){
+		result = _tree_cmp(root, key, prefix, node);
+		if(!result) return node;
+		
+		*last = node;
+		node  = result > 0? node->right : node->left;
+	}
+	return NULL;
+}
 
-/****************************** NEW STRUCTURE *********************************/
+// point whatever pointed at old_node at new_node
+inline static void _tree_replace(DS root, _tnode_pt old_node, _tnode_pt new_node){
+	if(!old_node->parent) root->head.t = new_node;
+	else if(old_node->parent->left == old_node)
+		old_node->parent->left = new_node;
+	else old_node->parent->right = new_node;
+}
 
-DS DS_new_list(size_t data_size){
-	DS new_structure;
+static _tnode_pt _rotate_left(DS root, _tnode_pt node){
+	_tnode_pt pivot = node->right;
 	
-	// Allocate space
-	new_structure= (DS) calloc(1, sizeof(struct _root));
-	if (new_structure == NULL) {
-		_error(_e_mem);
-		return NULL;
-	}
+	node->right = pivot->left;
+	if(pivot->left) pivot->left->parent = node;
 	
-	new_structure->type       = DS_list;
-	new_structure->data_size  = data_size;
-	new_structure->count      = 0        ;
+	_tree_replace(root, node, pivot);
+	pivot->parent = node->parent;
+	pivot->left   = node;
+	node->parent  = pivot;
 	
-	return new_structure;
+	_tree_update(node);
+	_tree_update(pivot);
+	return pivot;
 }
 
-
-DS DS_new_circular(size_t data_size){
-	DS new_structure;
+static _tnode_pt _rotate_right(DS root, _tnode_pt node){
+	_tnode_pt pivot = node->left;
 	
-	// Allocate space
-	new_structure= (DS) calloc(1, sizeof(struct _root));
-	if (new_structure == NULL) {
-		_error(_e_mem);
-		return NULL;
-	}
+	node->left = pivot->right;
+	if(pivot->right) pivot->right->parent = node;
 	
-	new_structure->type       = DS_circular_list;
-	new_structure->data_size  = data_size;
-	new_structure->count      = 0        ;
+	_tree_replace(root, node, pivot);
+	pivot->parent = node->parent;
+	pivot->right  = node;
+	node->parent  = pivot;
 	
-	return new_structure;
+	_tree_update(node);
+	_tree_update(pivot);
+	return pivot;
 }
 
+/*	Restore the AVL balance from node up to the root of the tree. No subtree may
+ *	have a height more than one greater than its sibling.
+ */
+static void _avl_rebalance(DS root, _tnode_pt node){
+	while(node){
+		_tree_update(node);
+		
+		if(_height(node->left) > _height(node->right)+1){
+			if(_height(node->left->left) < _height(node->left->right))
+				_rotate_left(root, node->left);
+			node = _rotate_right(root, node);
+		}
+		else if(_height(node->right) > _height(node->left)+1){
+			if(_height(node->right->right) < _height(node->right->left))
+				_rotate_right(root, node->right);
+			node = _rotate_left(root, node);
+		}
+		
+		node = node->parent;
+	}
+}
 
-DS DS_new_bst(
-	size_t       data_size,
-	bool         duplicates_allowed,
-	const void * (*key)(const void * data),
-	imax         (*cmp_keys)(const void * left , const void * right)
-){
-	DS new_structure;
+/*	Remove a node from the tree and return the lowest node whose subtree has
+ *	changed. That is where rebalancing must start.
+ */
+static _tnode_pt _tree_unlink(DS root, _tnode_pt node){
+	_tnode_pt child, swapnode, start;
 	
-	if (!key || !cmp_keys){
-		_error(_e_nsense);
-		return NULL;
+	// No more than one child
+	if(!node->left || !node->right){
+		child = node->left? node->left : node->right;
+		_tree_replace(root, node, child);
+		if(child) child->parent = node->parent;
+		return node->parent;
 	}
 	
-	// Allocate space
-	new_structure= (DS) calloc(1, sizeof(struct _root));
-	if (new_structure == NULL) {
-		_error(_e_mem);
-		return NULL;
-	}
+	// Two Children, replace it with the least node in the right subtree
+	swapnode = node->right;
+	while(swapnode->left) swapnode = swapnode->left;
 	
-	new_structure->keys.key = key;
-	new_structure->cmp_keys = cmp_keys;
+	if(swapnode->parent == node) start = swapnode;
+	else{
+		start = swapnode->parent;
+		
+		// we know there is no left child, but there may be a right
+		start->left = swapnode->right;
+		if(swapnode->right) swapnode->right->parent = start;
+		
+		swapnode->right = node->right;
+		swapnode->right->parent = swapnode;
+	}
 	
-	new_structure->type       = DS_bst;
-	new_structure->data_size  = data_size;
-	new_structure->count      = 0        ;
-	new_structure->dups       = duplicates_allowed;
+	swapnode->left = node->left;
+	swapnode->left->parent = swapnode;
+	swapnode->parent = node->parent;
+	swapnode->height = node->height;
+	swapnode->size   = node->size;
+	_tree_replace(root, node, swapnode);
 	
-	return new_structure;
+	return start;
 }
 
-DS DS_new_heap(
-	size_t data_size,
-	imax    (*cmp_data)(const void * left , const void * right)
-){
-	DS new_structure;
+/*	Move a node to the root of the tree with a series of rotations. Along the
+ *	way the depth of every node on the path is roughly halved, so recently used
+ *	nodes stay near the root.
+ */
+static void _splay(DS root, _tnode_pt node){
+	_tnode_pt parent, grand;
 	
-	if (!cmp_data){
-		_error(_e_nsense);
-		return NULL;
+	while((parent = node->parent)){
+		grand = parent->parent;
+		
+		if(!grand){ // zig
+			if(parent->left == node) _rotate_right(root, parent);
+			else                     _rotate_left (root, parent);
+		}
+		else if((grand->left == parent) == (parent->left == node)){ // zig-zig
+			if(parent->left == node){
+				_rotate_right(root, grand);
+				_rotate_right(root, parent);
+			}
+			else{
+				_rotate_left(root, grand);
+				_rotate_left(root, parent);
+			}
+		}
+		else{ // zig-zag
+			if(parent->left == node){
+				_rotate_right(root, parent);
+				_rotate_left (root, grand);
+			}
+			else{
+				_rotate_left (root, parent);
+				_rotate_right(root, grand);
+			}
+		}
 	}
+}
+
+// take a node out of the tree and put it on the freelist
+static void _tree_remove(DS root, _tnode_pt node){
+	_tnode_pt start;
 	
-	// Allocate space
-	new_structure= (DS) calloc(1, sizeof(struct _root));
-	if (new_structure == NULL) {
-		_error(_e_mem);
-		return NULL;
+	if(root->type == DS_splay) _splay(root, node);
+	
+	start = _tree_unlink(root, node);
+	
+	if(root->type == DS_avl) _avl_rebalance(root, start);
+	else for(; start; start = start->parent) _tree_update(start);
+	
+	if(!root->intrusive){
+		node->left = root->freelist.t;
+		root->freelist.t = node;
 	}
+	root->count--;
+}
+
+/*	Build a perfectly balanced subtree from the next count entries of sorted
+ *	data. Nodes are taken from the spare chain, which is linked through left.
+ */
+static _tnode_pt _tree_build(
+	DS              root,
+	_tnode_pt *     spare,
+	const int8_t ** data,
+	size_t          count,
+	_tnode_pt       parent
+){
+	_tnode_pt node;
 	
-	new_structure->type      = DS_heap  ;
-	new_structure->data_size = data_size;
-	new_structure->count     = 0        ;
-	new_structure->cmp_keys  = cmp_data ;
+	if(!count) return NULL;
 	
-	return new_structure;
+	node   = *spare;
+	*spare = node->left;
+	
+	node->parent = parent;
+	node->left   = _tree_build(root, spare, data, count/2, node);
+	memcpy(node->data, *data, root->data_size);
+	node->prefix = _tree_prefix(root, root->keys.key(node->data));
+	*data += root->data_size;
+	node->right  = _tree_build(root, spare, data, count - count/2 - 1, node);
+	_tree_update(node);
+	
+	return node;
 }
 
 
+/********************************** B-TREES ***********************************/
 
-DS DS_new_hash(
-	size_t   data_size,
-	size_t   table_size,
-	bool     duplicates_allowed,
-	uint64_t (*hash_func)(const void * data)
-){
-	DS new_structure;
+/*	DS_btree is a B+tree. Every entry lives in a leaf and the leaves are linked
+ *	in order. Internal nodes only hold copies of keys to guide the search. The
+ *	keys of each node are kept together in one array so that a search within a
+ *	node touches only a few cache lines, and the data follows the keys in
+ *	leaves. Every node is allocated at _BTREE_NODE_SZ bytes, so the number of
+ *	entries per node depends on the key and data sizes.
+ *
+ *	In an internal node, child i holds the keys from key i-1 up to key i. The
+ *	separator keys are not updated when entries are removed. They only need to
+ *	remain bounds on the keys in the children.
+ */
+
+inline static void _btree_free(DS root, _bnode_pt node){
+	node->next = root->freelist.b;
+	root->freelist.b = node;
+}
+
+// make sure the freelist holds at least count nodes
+static return_t _btree_reserve(DS root, uint count){
+	_bnode_pt node = root->freelist.b;
 	
-	if (!hash_func){
-		_error(_e_nsense);
-		return NULL;
-	}
+	for(; node && count; count--) node = node->next;
 	
-	// Allocate space
-	new_structure= (DS) calloc(1, sizeof(struct _root));
-	if (new_structure == NULL) {
-		_error(_e_mem);
-		return NULL;
+	while(count--){
+		node = (_bnode_pt) _alloc_node(root);
+		if(!node) return r_failure;
+		_btree_free(root, node);
 	}
 	
-	new_structure->type      = DS_hash           ;
-	new_structure->data_size = data_size         ;
-	new_structure->count     = 0                 ;
-	new_structure->dups      = duplicates_allowed;
-	new_structure->keys.hash = hash_func         ;
+	return r_success;
+}
+
+// return the index of the first key in node not before key, or after key
+static uint __attribute__((pure))
+_btree_bound(const DS root, _bnode_pt node, const void * key, bool upper){
+	uint lo = 0, hi = node->count, mid;
+	imax result;
 	
-	if(!table_size) new_structure->table_size = DS_DEFAULT_TABLE_SZ;
-	new_structure->table_size = table_size;
+	while(lo < hi){
+		mid = (lo+hi)/2;
+		result = root->cmp_keys(_bkey(root, node, mid), key);
+		if(result < 0 || (upper && !result)) lo = mid+1;
+		else hi = mid;
+	}
 	
-	return new_structure;
+	return lo;
 }
 
-/********************** ACTIONS ON WHOLE DATA STRUCTURE ***********************/
+static _bnode_pt __attribute__((pure))
+_btree_descend(const DS root, const void * key, bool upper){
+	_bnode_pt node = root->head.b;
+	
+	while(node->level)
+		node = _bchild(root, node)[_btree_bound(root, node, key, upper)];
+	
+	return node;
+}
 
-inline void DS_delete(DS root){
-	DS_empty(root);
-	DS_flush(root); // clear the freelist
-	free    (root);
+// the index of node among its parent's children
+static uint __attribute__((pure)) _btree_slot(const DS root, _bnode_pt node){
+	_bnode_pt * children = _bchild(root, node->parent);
+	uint        i        = 0;
+	
+	while(children[i] != node) i++;
+	return i;
 }
 
-inline void DS_empty (DS root){
-	while (DS_remove(root));
+inline static void _btree_adopt(DS root, _bnode_pt node, uint first, uint last){
+	for(; first<=last; first++) _bchild(root, node)[first]->parent = node;
 }
 
-inline void DS_flush (DS root){
-	_node_pt dead_node;
+/*	Move count leaf entries. The current position follows its entry so that it
+ *	survives splits and rebalancing.
+ */
+static void _bleaf_move(
+	DS root,
+	_bnode_pt dst, uint dst_idx,
+	_bnode_pt src, uint src_idx,
+	uint count
+){
+	if(!count) return;
+	
+	memmove(_bkey(root, dst, dst_idx), _bkey(root, src, src_idx),
+		count*root->key_size);
+	memmove(_bdata(root, dst, dst_idx), _bdata(root, src, src_idx),
+		count*root->data_size);
+	
+	if(root->current.b == src && root->index >= src_idx
+	&& root->index < src_idx+count){
+		root->current.b = dst;
+		root->index     = root->index - src_idx + dst_idx;
+	}
+}
+
+/*	Link a new node into the tree as the right sibling of left, with key as the
+ *	separator between them. The caller must have reserved enough nodes for any
+ *	splits on the way up.
+ */
+static void _btree_link(DS root, _bnode_pt left, const void * key, _bnode_pt right){
+	_bnode_pt parent = left->parent, sibling;
+	uint      pos, half;
+	
+	if(!parent){ // grow a new root
+		parent = _new_node(root).b;
+		parent->level = left->level+1;
+		_bchild(root, parent)[0] = left;
+		left->parent  = parent;
+		root->head.b  = parent;
+	}
+	
+	pos = _btree_slot(root, left);
+	
+	// split a full parent around its middle key, node_cap is odd
+	if(parent->count == root->node_cap){
+		half    = root->node_cap/2;
+		sibling = _new_node(root).b;
+		sibling->level = parent->level;
+		sibling->count = half;
+		memcpy(_bkey(root, sibling, 0), _bkey(root, parent, half+1),
+			half*root->key_size);
+		memcpy(_bchild(root, sibling), _bchild(root, parent)+half+1,
+			(half+1)*sizeof(_bnode_pt));
+		_btree_adopt(root, sibling, 0, half);
+		parent->count = half;
+		
+		// the middle key is left in place just past the end of parent
+		_btree_link(root, parent, _bkey(root, parent, half), sibling);
+		
+		if(pos > half){
+			parent = sibling;
+			pos   -= half+1;
+		}
+	}
+	
+	memmove(_bkey(root, parent, pos+1), _bkey(root, parent, pos),
+		(parent->count-pos)*root->key_size);
+	memcpy(_bkey(root, parent, pos), key, root->key_size);
+	memmove(_bchild(root, parent)+pos+2, _bchild(root, parent)+pos+1,
+		(parent->count-pos)*sizeof(_bnode_pt));
+	_bchild(root, parent)[pos+1] = right;
+	right->parent = parent;
+	parent->count++;
+}
+
+// insert data at pos in leaf, splitting as needed
+static void * _btree_insert(DS root, _bnode_pt leaf, uint pos, const void * data){
+	_bnode_pt node, right = NULL;
+	uint      keep, needed;
+	
+	if(leaf->count == root->leaf_cap){
+		// reserve every node the split could need so it cannot fail halfway
+		needed = 1;
+		for(node = leaf->parent; node && node->count == root->node_cap;
+			node = node->parent)
+			needed++;
+		if(!node) needed++;
+		if(_btree_reserve(root, needed) == r_failure) return NULL;
+		
+		right = _new_node(root).b;
+		keep  = (root->leaf_cap+1)/2;
+		if(pos < keep) keep--;
+		
+		_bleaf_move(root, right, 0, leaf, keep, leaf->count-keep);
+		right->count = leaf->count-keep;
+		leaf->count  = keep;
+		
+		right->prev = leaf;
+		right->next = leaf->next;
+		if(leaf->next) leaf->next->prev = right;
+		leaf->next = right;
+		
+		if(pos > keep){
+			leaf = right;
+			pos -= keep;
+		}
+	}
+	
+	_bleaf_move(root, leaf, pos+1, leaf, pos, leaf->count-pos);
+	memcpy(_bkey(root, leaf, pos), root->keys.key(data), root->key_size);
+	memcpy(_bdata(root, leaf, pos), data, root->data_size);
+	leaf->count++;
+	root->count++;
+	
+	root->current.b = leaf;
+	root->index     = pos;
+	
+	// the separator is only known once the new entry is in place
+	if(right) _btree_link(root, right->prev, _bkey(root, right, 0), right);
+	
+	return _bdata(root, leaf, pos);
+}
+
+// move one entry from the end of left to the front of its right sibling
+static void _btree_shift_right(DS root, _bnode_pt left, _bnode_pt right){
+	_bnode_pt parent = left->parent;
+	uint      sep    = _btree_slot(root, left);
+	
+	if(!left->level){
+		_bleaf_move(root, right, 1, right, 0, right->count);
+		_bleaf_move(root, right, 0, left, left->count-1, 1);
+		memcpy(_bkey(root, parent, sep), _bkey(root, right, 0), root->key_size);
+	}
+	else{
+		memmove(_bkey(root, right, 1), _bkey(root, right, 0),
+			right->count*root->key_size);
+		memmove(_bchild(root, right)+1, _bchild(root, right),
+			(right->count+1)*sizeof(_bnode_pt));
+		memcpy(_bkey(root, right, 0), _bkey(root, parent, sep), root->key_size);
+		_bchild(root, right)[0] = _bchild(root, left)[left->count];
+		_bchild(root, right)[0]->parent = right;
+		memcpy(_bkey(root, parent, sep), _bkey(root, left, left->count-1),
+			root->key_size);
+	}
+	
+	left->count--;
+	right->count++;
+}
+
+// move one entry from the front of right to the end of its left sibling
+static void _btree_shift_left(DS root, _bnode_pt left, _bnode_pt right){
+	_bnode_pt parent = left->parent;
+	uint      sep    = _btree_slot(root, left);
+	
+	if(!left->level){
+		_bleaf_move(root, left, left->count, right, 0, 1);
+		_bleaf_move(root, right, 0, right, 1, right->count-1);
+		memcpy(_bkey(root, parent, sep), _bkey(root, right, 0), root->key_size);
+	}
+	else{
+		memcpy(_bkey(root, left, left->count), _bkey(root, parent, sep),
+			root->key_size);
+		_bchild(root, left)[left->count+1] = _bchild(root, right)[0];
+		_bchild(root, left)[left->count+1]->parent = left;
+		memcpy(_bkey(root, parent, sep), _bkey(root, right, 0), root->key_size);
+		memmove(_bkey(root, right, 0), _bkey(root, right, 1),
+			(right->count-1)*root->key_size);
+		memmove(_bchild(root, right), _bchild(root, right)+1,
+			right->count*sizeof(_bnode_pt));
+	}
+	
+	left->count++;
+	right->count--;
+}
+
+// merge right into its left sibling and remove it from the parent
+static void _btree_merge(DS root, _bnode_pt left, _bnode_pt right){
+	_bnode_pt parent = left->parent;
+	uint      sep    = _btree_slot(root, left);
+	
+	if(!left->level){
+		_bleaf_move(root, left, left->count, right, 0, right->count);
+		left->count += right->count;
+		left->next = right->next;
+		if(right->next) right->next->prev = left;
+	}
+	else{
+		memcpy(_bkey(root, left, left->count), _bkey(root, parent, sep),
+			root->key_size);
+		memcpy(_bkey(root, left, left->count+1), _bkey(root, right, 0),
+			right->count*root->key_size);
+		memcpy(_bchild(root, left)+left->count+1, _bchild(root, right),
+			(right->count+1)*sizeof(_bnode_pt));
+		_btree_adopt(root, left, left->count+1, left->count+1+right->count);
+		left->count += right->count+1;
+	}
+	
+	memmove(_bkey(root, parent, sep), _bkey(root, parent, sep+1),
+		(parent->count-sep-1)*root->key_size);
+	memmove(_bchild(root, parent)+sep+1, _bchild(root, parent)+sep+2,
+		(parent->count-sep-1)*sizeof(_bnode_pt));
+	parent->count--;
+	
+	_btree_free(root, right);
+}
+
+// restore the minimum fill of node after a removal
+static void _btree_fix(DS root, _bnode_pt node){
+	_bnode_pt parent = node->parent, left, right;
+	uint      min, pos;
+	
+	if(!parent){ // the root may hold any number of keys
+		if(node->count) return;
+		
+		if(node->level){
+			root->head.b = _bchild(root, node)[0];
+			root->head.b->parent = NULL;
+		}
+		else root->head.b = NULL;
+		
+		_btree_free(root, node);
+		return;
+	}
+	
+	min = (node->level? root->node_cap : root->leaf_cap)/2;
+	if(node->count >= min) return;
+	
+	pos   = _btree_slot(root, node);
+	left  = pos? _bchild(root, parent)[pos-1] : NULL;
+	right = pos < parent->count? _bchild(root, parent)[pos+1] : NULL;
+	
+	if     (left  && left ->count > min) _btree_shift_right(root, left, node);
+	else if(right && right->count > min) _btree_shift_left (root, node, right);
+	else{
+		if(left) _btree_merge(root, left, node);
+		else     _btree_merge(root, node, right);
+		_btree_fix(root, parent);
+	}
+}
+
+// remove an entry, the following entry becomes current
+static void _btree_erase(DS root, _bnode_pt leaf, uint idx){
+	if(idx+1 < leaf->count){
+		root->current.b = leaf;
+		root->index     = idx+1;
+	}
+	else if(leaf->next){
+		root->current.b = leaf->next;
+		root->index     = 0;
+	}
+	else if(idx){
+		root->current.b = leaf;
+		root->index     = idx-1;
+	}
+	else root->current.b = NULL; // the last entry
+	
+	_bleaf_move(root, leaf, idx, leaf, idx+1, leaf->count-idx-1);
+	leaf->count--;
+	root->count--;
+	
+	_btree_fix(root, leaf);
+}
+
+static _bnode_pt __attribute__((pure)) _btree_first(const DS root){
+	_bnode_pt node = root->head.b;
+	
+	while(node->level) node = _bchild(root, node)[0];
+	return node;
+}
+
+static _bnode_pt __attribute__((pure)) _btree_last(const DS root){
+	_bnode_pt node = root->head.b;
+	
+	while(node->level) node = _bchild(root, node)[node->count];
+	return node;
+}
+
+// put a whole subtree on the freelist
+static void _btree_clear(DS root, _bnode_pt node){
+	if(node->level)
+		for(uint i=0; i<=node->count; i++)
+			_btree_clear(root, _bchild(root, node)[i]);
+	
+	_btree_free(root, node);
+}
+
+
+/******************************** HASH TABLES *********************************/
+
+/*	The hash table uses open addressing with Robin Hood displacement. Every slot
+ *	records how far its entry is from its home slot. An incoming entry takes the
+ *	slot of any resident that is closer to home than itself, and the resident
+ *	continues down the table. This keeps the probe sequences short and nearly
+ *	uniform even at high load. Removal shifts the following entries back by one
+ *	so that no tombstones are needed.
+ *
+ *	The table always has one extra slot at the end. It is used as scratch space
+ *	while displacing entries, and to return removed data to the caller.
+ *
+ *	DS_first() and DS_next() walk the table in slot order. When a removal shifts
+ *	entries back across the end of the table, the entry from slot 0 lands in the
+ *	last slot although the walk has already visited it. root->index counts the
+ *	slots at the end of the table that hold such entries, and the walk stops
+ *	before them.
+ */
+
+// the table grows when it would be more than 7/8 full
+#define _hash_max_load(A) ((A) - ((A)>>3))
+
+#define _hslot_sz(R) ((sizeof(struct _hash_slot)+(R)->data_size+7) & ~(size_t)7)
+#define _hslot_at(R,I) ((_hslot_pt)((int8_t*)(R)->head.h + (I)*_hslot_sz(R)))
+#define _hslot_idx(R,S) ((size_t)((int8_t*)(S) - (int8_t*)(R)->head.h)/_hslot_sz(R))
+
+// 0 if the power of two would not fit in a size_t
+inline static size_t __attribute__((const)) _pow2_ceil(size_t n){
+	size_t p = 8;
+	
+	if(n > SIZE_MAX/2+1) return 0;
+	while(p < n) p <<= 1;
+	return p;
+}
+
+// Find the slot holding the given hash without moving the current position
+static _hslot_pt __attribute__((pure))
+_hash_lookup(const DS root, uint64_t hash){
+	const size_t mask = root->table_size-1;
+	size_t       i    = hash & mask;
+	uint64_t     dist = 1;
+	_hslot_pt    slot;
+	
+	if(!root->head.h) return NULL;
+	
+	while((slot = _hslot_at(root, i))->dist >= dist){
+		if(slot->hash == hash) return slot;
+		dist++;
+		i = (i+1) & mask;
+	}
+	
+	return NULL;
+}
+
+/*	Copy data that another thread may be reading or writing at the same time.
+ *	A thief may read a deque entry while the owner is reusing its slot, and a
+ *	reader may probe a shard's table while its writer changes it. Both throw
+ *	such a copy away, but each side accesses the data with relaxed atomics so
+ *	that the race is well defined.
+ */
+static void _relaxed_copy(void * dst, const void * src, size_t size){
+	const _Atomic(uint64_t) * word_src = (const _Atomic(uint64_t)*) src;
+	const _Atomic(uint8_t)  * byte_src = (const _Atomic(uint8_t )*) src;
+	_Atomic(uint64_t)       * word_dst = (_Atomic(uint64_t)*) dst;
+	_Atomic(uint8_t)        * byte_dst = (_Atomic(uint8_t )*) dst;
+	
+	if(((uintptr_t)dst | (uintptr_t)src | size) & 7){
+		for(size_t i=0; i<size; i++) atomic_store_explicit(byte_dst+i,
+			atomic_load_explicit(byte_src+i, memory_order_relaxed),
+			memory_order_relaxed);
+	}
+	else{
+		for(size_t i=0; i<size/8; i++) atomic_store_explicit(word_dst+i,
+			atomic_load_explicit(word_src+i, memory_order_relaxed),
+			memory_order_relaxed);
+	}
+}
+
+/*	Stores to the slots of a shared table, which lock free readers may be
+ *	probing, see _shard_read(). The slot size is a multiple of 8.
+ */
+static void _hslot_copy(const DS root, _hslot_pt dst, const void * src){
+	if(root->shared) _relaxed_copy(dst, src, _hslot_sz(root));
+	else memcpy(dst, src, _hslot_sz(root));
+}
+
+static void _hslot_swap(const DS root, _hslot_pt slot, _hslot_pt carry){
+	_Atomic(uint64_t) * word = (_Atomic(uint64_t)*) slot;
+	int8_t *            held = (int8_t*) carry;
+	uint64_t            temp, next;
+	
+	if(!root->shared){
+		DS_memswap(slot, carry, _hslot_sz(root));
+		return;
+	}
+	
+	// the carry is the scratch slot, which readers never probe
+	for(size_t i=0; i<_hslot_sz(root)/8; i++){
+		memcpy(&next, held + i*8, 8);
+		temp = atomic_load_explicit(word+i, memory_order_relaxed);
+		atomic_store_explicit(word+i, next, memory_order_relaxed);
+		memcpy(held + i*8, &temp, 8);
+	}
+}
+
+static void _hslot_set(const DS root, uint64_t * field, uint64_t value){
+	if(root->shared) atomic_store_explicit(
+		(_Atomic(uint64_t)*) field, value, memory_order_relaxed);
+	else *field = value;
+}
+
+// Place a new entry in the table, returning the slot where it landed
+static _hslot_pt _hash_place(DS root, uint64_t hash, const void * data){
+	const size_t    mask    = root->table_size-1;
+	const _hslot_pt carry   = _hslot_at(root, root->table_size);
+	size_t          i       = hash & mask;
+	_hslot_pt       slot, landed = NULL;
+	
+	carry->hash = hash;
+	carry->dist = 1;
+	memcpy(carry->data, data, root->data_size);
+	
+	while((slot = _hslot_at(root, i))->dist){
+		if(slot->dist < carry->dist){ // the resident is richer, displace it
+			_hslot_swap(root, slot, carry);
+			if(!landed) landed = slot;
+		}
+		carry->dist++;
+		i = (i+1) & mask;
+	}
+	
+	_hslot_copy(root, slot, carry);
+	return landed? landed : slot;
+}
+
+// Move the table to a new allocation of the given number of slots
+static return_t _hash_resize(DS root, size_t slots){
+	const size_t slot_sz = _hslot_sz(root);
+	_hslot_pt    old     = root->head.h;
+	size_t       old_sz  = root->table_size;
+	_hslot_pt    slot;
+	
+	root->head.h = (_hslot_pt) calloc(slots+1, slot_sz);
+	if(!root->head.h){
+		_error(_e_mem);
+		root->head.h = old;
+		return r_failure;
+	}
+	root->table_size = slots;
+	
+	if(old){
+		for(size_t i=0; i<old_sz; i++){
+			slot = (_hslot_pt)((int8_t*)old + i*slot_sz);
+			if(slot->dist) _hash_place(root, slot->hash, slot->data);
+		}
+		
+		if(root->shared){ // a reader may still be probing it
+			_hslot_set(root, &old->hash, (uint64_t)(uintptr_t)root->freelist.h);
+			root->freelist.h = old;
+		}
+		else free(old);
+	}
+	
+	return r_success;
+}
+
+// The first occupied slot at or after index i, NULL if there is none
+static _hslot_pt __attribute__((pure))
+_hash_scan(const DS root, size_t i){
+	for(; i<root->table_size; i++)
+		if(_hslot_at(root, i)->dist) return _hslot_at(root, i);
+	return NULL;
+}
+
+// true if the walk has already visited the entry in this slot
+#define _hash_wrapped(R,S) (_hslot_idx(R,S) >= (R)->table_size - (R)->index)
+
+/*	The entry at the current position. A removal can leave the current slot
+ *	empty, and only then is the next entry looked for. Once the walk has ended
+ *	this returns NULL and current stays where it is.
+ */
+static _hslot_pt _hash_current(DS root){
+	_hslot_pt slot = root->current.h;
+	
+	if(!slot->dist) slot = _hash_scan(root, _hslot_idx(root, slot));
+	if(!slot || _hash_wrapped(root, slot)) return NULL;
+	return root->current.h = slot;
+}
+
+
+/*********************************** ARRAYS ***********************************/
+
+#define _at(A) ((uint8_t*)buffer+((A)*size))
+
+// copy one element, letting the compiler inline the common sizes
+inline static void _elcpy(void *dst, const void *src, const size_t size){
+	switch(size){
+	case 4 : memcpy(dst, src, 4 ); break;
+	case 8 : memcpy(dst, src, 8 ); break;
+	case 16: memcpy(dst, src, 16); break;
+	default: memcpy(dst, src, size);
+	}
+}
+
+/*	In a heap of arity D the children of element A are D*A+1 through D*A+D.
+ *	The sifting functions move a hole rather than the element itself, so each
+ *	level costs one copy instead of a swap. The element being placed must not
+ *	be in the part of the array that is sifted.
+ */
+#define _heap_child(A,D) ((A)*(D)+1)
+#define _heap_parent(A,D) (((A)-1)/(D))
+
+inline static void _sift_down(
+	void         *buffer,
+	      size_t hole,  // index to fill, <=stop
+	const size_t stop,  // how far to sift down
+	const size_t size,
+	const size_t arity,
+	_cmp_pt      compare,
+	const void   *ctx,
+	const void   *element
+){
+	size_t child, last, best;
+	
+	while((child = _heap_child(hole, arity)) <= stop){
+		last = child+arity-1 < stop? child+arity-1 : stop;
+		
+		// the children share a cache line when the array is aligned for it
+		for(best = child++; child <= last; child++)
+			if(compare(ctx, _at(best), _at(child)) > 0) best = child;
+		
+		if(compare(ctx, element, _at(best)) <= 0) break;
+		
+		_elcpy(_at(hole), _at(best), size);
+		hole = best;
+	}
+	
+	_elcpy(_at(hole), element, size);
+}
+
+// returns the final index of the element
+inline static size_t _sift_up(
+	void         *buffer,
+	const size_t stop, // how far to sift up, <=hole
+	      size_t hole, // index to fill
+	const size_t size,
+	const size_t arity,
+	_cmp_pt      compare,
+	const void   *ctx,
+	const void   *element
+){
+	size_t parent;
+	
+	while(hole > stop){
+		parent = _heap_parent(hole, arity);
+		if(compare(ctx, _at(parent), element) <= 0) break;
+		
+		_elcpy(_at(hole), _at(parent), size);
+		hole = parent;
+	}
+	
+	_elcpy(_at(hole), element, size);
+	return hole;
+}
+
+/*********************************** HEAPS ************************************/
+
+/*	DS_heap keeps its entries in a growable array with two extra entries at the
+ *	end. The first holds removed data for the caller, and the second holds an
+ *	entry while it is sifted into place. The array starts leaf_cap-1 entries
+ *	after a cache line boundary, so the children of each node form a group of
+ *	leaf_cap entries. The groups start on cache line boundaries only when
+ *	leaf_cap*_hent_sz() is a multiple of the cache line. Otherwise a group may
+ *	straddle one more line than it fills.
+ *
+ *	The entries of a keyed heap hold a pointer to the payload followed by a
+ *	copy of its key, so sifting never touches the payloads. The payloads come
+ *	from the arena and never move. Each of the first `slots` entries holds a
+ *	different payload, and those past count are free for the next insertion.
+ */
+
+#define _hent_dsz(R) \
+	((R)->key_size? sizeof(void*)+(R)->key_size : (R)->data_size)
+#define _hent_sz(R) ((sizeof(struct _heap_entry)+_hent_dsz(R)+7) & ~(size_t)7)
+#define _ekey(R,E) ((E)->data + sizeof(void*))
+#define _heap_cmp_for(R) ((R)->key_size? &_keyed_cmp : &_heap_cmp)
+#define _hent_at(R,I) ((_hent_pt)((int8_t*)(R)->head.e + (I)*_hent_sz(R)))
+#define _hent_tmp(R) _hent_at(R, (R)->table_size+1)
+#define _heap_base(R) \
+	((void*)((int8_t*)(R)->head.e - ((R)->leaf_cap-1)*_hent_sz(R)))
+
+// order by the caller's comparison, then by the order of insertion
+static imax _heap_cmp(const void * ctx, const void * left, const void * right){
+	const DS root = (const DS)ctx;
+	imax     result;
+	
+	result = root->cmp_keys(
+		_edata(root, (const struct _heap_entry*)left ),
+		_edata(root, (const struct _heap_entry*)right)
+	);
+	if(result) return result;
+	
+	return ((const struct _heap_entry*)left )->serial <
+	       ((const struct _heap_entry*)right)->serial ? -1 : 1;
+}
+
+// as _heap_cmp() with the keys copied into the entries
+static imax _keyed_cmp(const void * ctx, const void * left, const void * right){
+	const DS root = (const DS)ctx;
+	imax     result;
+	
+	result = root->cmp_keys(
+		_ekey(root, (const struct _heap_entry*)left ),
+		_ekey(root, (const struct _heap_entry*)right)
+	);
+	if(result) return result;
+	
+	return ((const struct _heap_entry*)left )->serial <
+	       ((const struct _heap_entry*)right)->serial ? -1 : 1;
+}
+
+/*	Store data in an entry, an intrusive heap stores a pointer to it. A keyed
+ *	heap copies it to a free payload and stores a pointer and the key.
+ *	Returns the stored data, NULL if there was no memory for it.
+ */
+inline static void * _heap_put(DS root, _hent_pt entry, const void * data){
+	int8_t * payload;
+	
+	if(root->intrusive) memcpy(entry->data, &data, sizeof(data));
+	else if(!root->key_size) memcpy(entry->data, data, root->data_size);
+	else{
+		if(root->count < root->slots)
+			payload = _edata(root, _hent_at(root, root->count));
+		else if(( payload = (int8_t*) _alloc_node(root) )) root->slots++;
+		else return NULL;
+		
+		memcpy(payload, data, root->data_size);
+		memcpy(entry->data, &payload, sizeof(payload));
+		memcpy(_ekey(root, entry), root->keys.key(payload), root->key_size);
+	}
+	
+	return _edata(root, entry);
+}
+
+static return_t _heap_resize(DS root, size_t entries){
+	const size_t pad = root->leaf_cap-1;
+	void *       new_array;
+	
+	if(posix_memalign(&new_array, _CACHE_LINE, (pad+entries+2)*_hent_sz(root))){
+		_error(_e_mem);
+		return r_failure;
+	}
+	
+	if(root->head.e){
+		memcpy((int8_t*)new_array + pad*_hent_sz(root), root->head.e,
+			(root->key_size? root->slots : root->count)*_hent_sz(root));
+		free(_heap_base(root));
+	}
+	
+	root->head.e     = (_hent_pt)((int8_t*)new_array + pad*_hent_sz(root));
+	root->table_size = entries;
+	if(root->count) root->current = root->head;
+	return r_success;
+}
+
+/******************************* PAIRING HEAPS ********************************/
+
+/*	DS_pairing is a pairing heap made of tree nodes, so that the entries never
+ *	move and a pointer to one can be handed back to change or remove it. In a
+ *	pairing heap node, left is the first child and right is the next sibling.
+ *	parent is the parent of a first child, and the previous sibling of the
+ *	rest. size holds the serial number that keeps equal entries in order.
+ */
+
+#define _pair_node(R,D) ((R)->intrusive? (_tnode_pt)(void*)_hook(R,D) : \
+	(_tnode_pt)(void*)((int8_t*)(D) - offsetof(struct _tree_node, data)))
+
+// whether node a should come out of the heap before node b
+inline static bool _pair_before(const DS root, _tnode_pt a, _tnode_pt b){
+	imax result = root->cmp_keys(_data(root, a), _data(root, b));
+	return result < 0 || (!result && a->size < b->size);
+}
+
+// join two heaps, the loser becomes the first child of the winner
+static _tnode_pt _pair_meld(const DS root, _tnode_pt a, _tnode_pt b){
+	_tnode_pt temp;
+	
+	if(!a) return b;
+	if(!b) return a;
+	
+	if(_pair_before(root, b, a)){
+		temp = a;
+		a    = b;
+		b    = temp;
+	}
+	
+	b->right  = a->left;
+	if(b->right) b->right->parent = b;
+	b->parent = a;
+	a->left   = b;
+	a->right  = NULL;
+	a->parent = NULL;
+	
+	return a;
+}
+
+/*	Join a list of sibling heaps in two passes, first melding them in pairs
+ *	from the left, then melding the pairs from the right. This is what gives
+ *	the pairing heap its amortized O(log n) removal.
+ */
+static _tnode_pt _pair_merge(const DS root, _tnode_pt first){
+	_tnode_pt pairs = NULL, next, result = NULL;
+	
+	// the pairs are stacked through right
+	while(first){
+		next = first->right? first->right->right : NULL;
+		first = _pair_meld(root, first, first->right);
+		first->right = pairs;
+		pairs = first;
+		first = next;
+	}
+	
+	while(pairs){
+		next   = pairs->right;
+		result = _pair_meld(root, pairs, result);
+		pairs  = next;
+	}
+	
+	// a lone heap was never melded and still has its old links
+	if(result) result->parent = result->right = NULL;
+	return result;
+}
+
+// take a subtree out of the heap
+static void _pair_cut(_tnode_pt node){
+	if(node->parent->left == node) node->parent->left = node->right;
+	else node->parent->right = node->right;
+	if(node->right) node->right->parent = node->parent;
+	
+	node->parent = NULL;
+	node->right  = NULL;
+}
+
+// take node out of the heap, leaving it with no children
+static void _pair_unlink(DS root, _tnode_pt node){
+	_tnode_pt children = node->left;
+	
+	if(node == root->head.t) root->head.t = NULL;
+	else _pair_cut(node);
+	
+	node->left = NULL;
+	if(children) children->parent = NULL;
+	root->head.t = _pair_meld(root, root->head.t, _pair_merge(root, children));
+	root->current = root->head;
+}
+
+// take node out of the heap and put it on the freelist
+static const void * _pair_remove(DS root, _tnode_pt node){
+	_pair_unlink(root, node);
+	
+	if(!root->intrusive){
+		node->left = root->freelist.t;
+		root->freelist.t = node;
+	}
+	root->count--;
+	
+	return _data(root, node);
+}
+
+// the next node in preorder, climbing over first children to their parents
+static _tnode_pt __attribute__((pure)) _pair_next(_tnode_pt node){
+	if(node->left) return node->left;
+	
+	for(; node; node = node->parent){
+		if(node->right) return node->right;
+		while(node->parent && node->parent->left != node) node = node->parent;
+	}
+	return NULL;
+}
+
+
+/******************************** RADIX HEAPS *********************************/
+
+#define _rent_sz(R) ((sizeof(uint64_t)+(R)->data_size+7) & ~(size_t)7)
+#define _rent_at(R,B,I) ((B)->entries + (I)*_rent_sz(R))
+#define _rent_key(E) (*(uint64_t*)(void*)(E))
+#define _rent_data(E) ((E) + sizeof(uint64_t))
+
+// the bucket of a key, given the last key removed
+inline static uint __attribute__((const))
+_radix_index(uint64_t last, uint64_t key){
+	return key == last? 0 : 64 - (uint)__builtin_clzll(key ^ last);
+}
+
+// make room for more entries at the end of a bucket
+static return_t _radix_reserve(DS root, _rbucket_pt bucket, size_t more){
+	int8_t * entries;
+	size_t   size;
+	
+	if(bucket->count + more <= bucket->size) return r_success;
+	
+	// bucket 0 is consumed from the front, reuse that space if it is most
+	if(bucket->start && bucket->start >= bucket->count/2
+		&& bucket->count - bucket->start + more <= bucket->size
+	){
+		memmove(bucket->entries, _rent_at(root, bucket, bucket->start),
+			(bucket->count - bucket->start)*_rent_sz(root));
+		bucket->count -= bucket->start;
+		bucket->start  = 0;
+		return r_success;
+	}
+	
+	size = bucket->size? bucket->size : DS_DEFAULT_RADIX_SZ;
+	while(size < bucket->count + more) size <<= 1;
+	
+	entries = (int8_t*) realloc(bucket->entries, size*_rent_sz(root));
+	if(!entries){
+		_error(_e_mem);
+		return r_failure;
+	}
+	
+	bucket->entries = entries;
+	bucket->size    = size;
+	return r_success;
+}
+
+/*	Make sure that bucket 0 holds the smallest keys. If it is empty, the
+ *	smallest key of the lowest bucket that is not becomes the last key, and the
+ *	whole bucket is spread over the buckets below it. Every entry moves to a
+ *	lower bucket, so none moves more than 64 times. The room is reserved first
+ *	so that a failure leaves the heap as it was.
+ */
+static return_t _radix_settle(DS root){
+	const _radix_pt radix = root->head.x;
+	_rbucket_pt     from;
+	size_t          more[_RADIX_BUCKETS] = {0};
+	uint64_t        min;
+	uint            i, top;
+	
+	if(radix->bucket[0].start < radix->bucket[0].count) return r_success;
+	radix->bucket[0].start = radix->bucket[0].count = 0;
+	
+	for(top=1; !radix->bucket[top].count; top++);
+	from = radix->bucket + top;
+	
+	min = _rent_key(_rent_at(root, from, 0));
+	for(size_t j=1; j<from->count; j++)
+		if(_rent_key(_rent_at(root, from, j)) < min)
+			min = _rent_key(_rent_at(root, from, j));
+	
+	for(size_t j=0; j<from->count; j++)
+		more[_radix_index(min, _rent_key(_rent_at(root, from, j)))]++;
+	for(i=0; i<top; i++)
+		if(more[i] && _radix_reserve(root, radix->bucket+i, more[i]))
+			return r_failure;
+	
+	// in order, so that equal keys stay first-in-first-out
+	radix->last = min;
+	for(size_t j=0; j<from->count; j++){
+		i = _radix_index(min, _rent_key(_rent_at(root, from, j)));
+		memcpy(_rent_at(root, radix->bucket+i, radix->bucket[i].count++),
+			_rent_at(root, from, j), _rent_sz(root));
+	}
+	from->count = 0;
+	
+	return r_success;
+}
+
+// the payload with the smallest key
+static void * _radix_front(DS root){
+	const _rbucket_pt bucket = root->head.x->bucket;
+	
+	if(_radix_settle(root)) return NULL;
+	return _rent_data(_rent_at(root, bucket, bucket->start));
+}
+
+
+/******************************* UNROLLED LISTS *******************************/
+
+/*	DS_unrolled is a list of blocks, each holding up to leaf_cap entries in a
+ *	contiguous run starting at the block's start slot. Adding at the front of
+ *	the list fills the first block downward, and adding at the back fills the
+ *	last block upward, so stacks and queues never move entries. Inserting or
+ *	removing in the middle only moves entries within one block.
+ */
+
+#define _UNROLL_BLOCK_SZ ((size_t)1<<10)
+
+#define _uelem(R,B,I) \
+	((B)->data + (size_t)((B)->start+(I))*(R)->data_size)
+
+inline static void * _ulist_seek(DS root, _ublock_pt block, size_t i){
+	root->current.u = block;
+	root->index     = i;
+	return _uelem(root, block, i);
+}
+
+// link a new empty block after the given block, or first if after is NULL
+static _ublock_pt _ulist_link(DS root, _ublock_pt after){
+	_ublock_pt block = _new_node(root).u;
+	
+	if(!block) return NULL;
+	
+	block->prev = after;
+	block->next = after? after->next : root->head.u;
+	
+	if(block->next) block->next->prev = block;
+	else            root->tail.u      = block;
+	if(after) after->next  = block;
+	else      root->head.u = block;
+	
+	return block;
+}
+
+// take a block out of the list and put it on the freelist
+static void _ulist_unlink(DS root, _ublock_pt block){
+	if(block->prev) block->prev->next = block->next;
+	else            root->head.u      = block->next;
+	if(block->next) block->next->prev = block->prev;
+	else            root->tail.u      = block->prev;
+	
+	block->next = root->freelist.u;
+	root->freelist.u = block;
+}
+
+// insert data before entry i of block, splitting the block if it is full
+static void * _ulist_insert(DS root, _ublock_pt block, uint i, const void * data){
+	const size_t size = root->data_size;
+	_ublock_pt   right;
+	uint         half;
+	
+	if(block->count == root->leaf_cap){
+		if(!( right = _ulist_link(root, block) )) return NULL;
+		
+		half = block->count/2;
+		memcpy(right->data, _uelem(root, block, half), (block->count-half)*size);
+		right->count = block->count-half;
+		block->count = half;
+		
+		if(i > half){
+			block = right;
+			i    -= half;
+		}
+	}
+	
+	// move the shorter side of the block, if there is room on that side
+	if(block->start && (i < block->count/2 ||
+		block->start+block->count == root->leaf_cap)){
+		block->start--;
+		memmove(_uelem(root, block, 0), _uelem(root, block, 1), i*size);
+	}
+	else memmove(_uelem(root, block, i+1), _uelem(root, block, i),
+		(block->count-i)*size);
+	
+	block->count++;
+	root->count++;
+	
+	return memcpy(_ulist_seek(root, block, i), data, size);
+}
+
+/*	Remove entry i of block. The following entry becomes current, or the new
+ *	last entry if there is none.
+ */
+static const void * _ulist_remove(DS root, _ublock_pt block, uint i){
+	const size_t size = root->data_size;
+	_ublock_pt   next = block->next, prev;
+	const void * data;
+	
+	data = memcpy(_scratch(root), _uelem(root, block, i), size);
+	
+	if(i < block->count/2){
+		memmove(_uelem(root, block, 1), _uelem(root, block, 0), i*size);
+		block->start++;
+	}
+	else memmove(_uelem(root, block, i), _uelem(root, block, i+1),
+		(block->count-i-1)*size);
+	
+	block->count--;
+	root->count--;
+	
+	if(!block->count){
+		_ulist_unlink(root, block);
+		if(next) _ulist_seek(root, next, 0);
+		else if(root->tail.u) _ulist_seek(root, root->tail.u, root->tail.u->count-1);
+		else root->current.u = NULL;
+		return data;
+	}
+	
+	// merge with a neighbor when the two fit in half a block
+	if(next && block->count + next->count <= root->leaf_cap/2){
+		memmove(block->data, _uelem(root, block, 0), block->count*size);
+		block->start = 0;
+		memcpy(_uelem(root, block, block->count), _uelem(root, next, 0),
+			next->count*size);
+		block->count += next->count;
+		_ulist_unlink(root, next);
+		next = block->next;
+	}
+	else if((prev = block->prev)
+		&& prev->count + block->count <= root->leaf_cap/2
+	){
+		memmove(prev->data, _uelem(root, prev, 0), prev->count*size);
+		prev->start = 0;
+		memcpy(_uelem(root, prev, prev->count), _uelem(root, block, 0),
+			block->count*size);
+		i           += prev->count;
+		prev->count += block->count;
+		_ulist_unlink(root, block);
+		block = prev;
+	}
+	
+	if(i < block->count) _ulist_seek(root, block, i);
+	else if(next)        _ulist_seek(root, next, 0);
+	else                 _ulist_seek(root, block, block->count-1);
+	
+	return data;
+}
+
+
+/****************************** DYNAMIC ARRAYS ********************************/
+
+/*	DS_array keeps its entries in one contiguous allocation with free slots at
+ *	both ends, so that entries can be added or removed at either end in
+ *	amortized constant time. tail points to the allocation and head to the
+ *	first entry. table_size is the number of slots in the allocation.
+ */
+
+#define _aelem(R,I) ((R)->head.a + (size_t)(I)*(R)->data_size)
+#define _alead(R)   ((size_t)((R)->head.a - (R)->tail.a)/(R)->data_size)
+
+// set the current position to the entry at index i
+inline static void * _array_seek(DS root, size_t i){
+	root->index = i;
+	return root->current.a = _aelem(root, i);
+}
+
+// make room for one more entry at the front or the back of an array
+static return_t _array_room(DS root, bool front){
+	const size_t size  = root->data_size;
+	const size_t lead  = _alead(root);
+	const size_t trail = root->table_size - lead - root->count;
+	const size_t spare = root->table_size - root->count;
+	size_t       slots, start;
+	int8_t *     new_array;
+	
+	if(front? lead : trail) return r_success;
+	
+	// if the other end has most of the room, move the entries to the middle
+	if(spare > root->table_size/2){
+		start = front? spare - spare/2 : spare/2;
+		memmove(root->tail.a + start*size, root->head.a, root->count*size);
+		root->head.a = root->tail.a + start*size;
+	}
+	
+	// otherwise double the allocation and put the new room where it is needed
+	else{
+		slots = root->table_size? root->table_size<<1 : DS_DEFAULT_ARRAY_SZ;
+		
+		if(front){
+			new_array = (int8_t*) malloc(slots*size);
+			if(!new_array){
+				_error(_e_mem);
+				return r_failure;
+			}
+			start = slots - root->count - trail;
+			if(root->count)
+				memcpy(new_array + start*size, root->head.a, root->count*size);
+			free(root->tail.a);
+		}
+		else{
+			new_array = (int8_t*) realloc(root->tail.a, slots*size);
+			if(!new_array){
+				_error(_e_mem);
+				return r_failure;
+			}
+			start = lead;
+		}
+		
+		root->tail.a     = new_array;
+		root->head.a     = new_array + start*size;
+		root->table_size = slots;
+	}
+	
+	if(root->count) _array_seek(root, root->index);
+	return r_success;
+}
+
+/***************************** CONCURRENT QUEUES ******************************/
+
+/*	A queue with a capacity of n holds cells for n tickets. The cell for ticket
+ *	t has the sequence number t when it is free for the producer, t+1 when it is
+ *	full for the consumer, and t+n once it has been emptied for the next lap.
+ */
+
+#define _qcell_sz(R) ((sizeof(struct _queue_cell)+(R)->data_size+7) & ~(size_t)7)
+#define _qcell_at(R,T) ((_qcell_pt)( \
+	(R)->head.q->cells + ((T) & ((R)->table_size-1))*_qcell_sz(R)))
+
+#define _relem(R,I) \
+	((R)->head.r->data + ((I) & ((R)->table_size-1))*(R)->data_size)
+
+// allocate a root followed by size bytes of cache aligned queue memory
+static DS _new_aligned(size_t size){
+	const size_t offset =
+		(sizeof(struct _root) + _CACHE_LINE-1) & ~(size_t)(_CACHE_LINE-1);
+	DS           root;
+	
+	if(size > SIZE_MAX - offset - _CACHE_LINE){
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	size = (offset + size + _CACHE_LINE-1) & ~(size_t)(_CACHE_LINE-1);
+	if(!( root = (DS) aligned_alloc(_CACHE_LINE, size) )){
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	memset(root, 0, sizeof(struct _root));
+	root->head.a = (int8_t*)root + offset;
+	return root;
+}
+
+// ready the queue for first use, not safe while the queue is in use
+static void _queue_reset(DS root){
+	if(root->type == DS_spsc){
+		atomic_store(&root->head.r->back , 0);
+		atomic_store(&root->head.r->front, 0);
+		root->head.r->front_seen = 0;
+		root->head.r->back_seen  = 0;
+		return;
+	}
+	
+	for(size_t i=0; i<root->table_size; i++)
+		atomic_store(&_qcell_at(root, i)->seq, i);
+	atomic_store(&root->head.q->enq, 0);
+	atomic_store(&root->head.q->deq, 0);
+}
+
+// entries in the queue, only a snapshot while it is in use
+static size_t _queue_len(const DS root){
+	size_t front, back;
+	
+	if(root->type == DS_spsc){
+		front = atomic_load(&root->head.r->front);
+		back  = atomic_load(&root->head.r->back);
+	}
+	else{
+		front = atomic_load(&root->head.q->deq);
+		back  = atomic_load(&root->head.q->enq);
+	}
+	
+	return back > front? back-front : 0;
+}
+
+// copy up to count entries into a ring, only called by the producer
+static size_t _ring_put(DS root, const int8_t * data, size_t count){
+	_ring_pt ring = root->head.r;
+	size_t   back = atomic_load_explicit(&ring->back, memory_order_relaxed);
+	size_t   split;
+	
+	if(ring->front_seen + root->table_size - back < count)
+		ring->front_seen = atomic_load_explicit(&ring->front, memory_order_acquire);
+	if(count > ring->front_seen + root->table_size - back)
+		count = ring->front_seen + root->table_size - back;
+	if(!count) return 0;
+	
+	// the entries may wrap around the end of the ring
+	split = root->table_size - (back & (root->table_size-1));
+	if(split > count) split = count;
+	memcpy(_relem(root, back), data, split*root->data_size);
+	memcpy(ring->data, data + split*root->data_size,
+		(count-split)*root->data_size);
+	
+	atomic_store_explicit(&ring->back, back+count, memory_order_release);
+	return count;
+}
+
+// copy up to count entries out of a ring, only called by the consumer
+static size_t _ring_get(DS root, int8_t * data, size_t count){
+	_ring_pt ring  = root->head.r;
+	size_t   front = atomic_load_explicit(&ring->front, memory_order_relaxed);
+	size_t   split;
+	
+	if(ring->back_seen - front < count)
+		ring->back_seen = atomic_load_explicit(&ring->back, memory_order_acquire);
+	if(count > ring->back_seen - front) count = ring->back_seen - front;
+	if(!count) return 0;
+	
+	split = root->table_size - (front & (root->table_size-1));
+	if(split > count) split = count;
+	memcpy(data, _relem(root, front), split*root->data_size);
+	memcpy(data + split*root->data_size, ring->data,
+		(count-split)*root->data_size);
+	
+	atomic_store_explicit(&ring->front, front+count, memory_order_release);
+	return count;
+}
+
+// entries in the deque, only a snapshot while it is in use
+static size_t _deque_len(const DS root){
+	imax top    = atomic_load(&root->head.d->top);
+	imax bottom = atomic_load(&root->head.d->bottom);
+	
+	return bottom > top? (size_t)(bottom-top) : 0;
+}
+
+#define _delem(R,A,I) ((A)->data + ((size_t)(I) & ((A)->size-1))*(R)->data_size)
+
+
+/*	Give the owner a larger array holding the entries from top to bottom. The
+ *	old one is retired rather than freed.
+ */
+static _darray_pt _deque_grow(DS root, _darray_pt old, imax top, imax bottom){
+	_darray_pt array;
+	size_t     size = old? old->size<<1 : DS_DEFAULT_DEQUE_SZ;
+	
+	array = (_darray_pt) malloc(
+		sizeof(struct _deque_array) + size*root->data_size);
+	if(!array){
+		_error(_e_mem);
+		return NULL;
+	}
+	array->size = size;
+	
+	for(imax i=top; i<bottom; i++)
+		memcpy(_delem(root, array, i), _delem(root, old, i), root->data_size);
+	
+	if(old){
+		old->next = root->freelist.w;
+		root->freelist.w = old;
+	}
+	atomic_store_explicit(&root->head.d->array, array, memory_order_release);
+	return array;
+}
+
+/**************************** CONCURRENT HASH MAPS ****************************/
+
+/*	The shard is picked by hash bits far above the ones that pick a slot in its
+ *	table, so that the entries of one shard still spread over its whole table.
+ */
+#define _shard_of(R,H) ((R)->head.s + (((H)>>32) & ((R)->table_size-1)))
+
+// take the writer lock and warn the readers that the table is changing
+static void _shard_lock(_shard_pt shard){
+	pthread_mutex_lock(&shard->lock);
+	atomic_store_explicit(&shard->seq,
+		atomic_load_explicit(&shard->seq, memory_order_relaxed)+1,
+		memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+static void _shard_unlock(_shard_pt shard){
+	// the table may have been replaced
+	atomic_store_explicit(&shard->slots, shard->table.head.h,
+		memory_order_release);
+	atomic_store_explicit(&shard->size, shard->table.table_size,
+		memory_order_release);
+	atomic_store_explicit(&shard->seq,
+		atomic_load_explicit(&shard->seq, memory_order_relaxed)+1,
+		memory_order_release);
+	pthread_mutex_unlock(&shard->lock);
+}
+
+// a field of a slot that a writer may be changing
+#define _hslot_load(F) \
+	atomic_load_explicit((_Atomic(uint64_t)*) &(F), memory_order_relaxed)
+
+/*	Copy out the entry with the given hash without taking the lock. The table
+ *	and its size are checked to belong together before probing. A writer may
+ *	change the slots during the probe, so they are read with relaxed atomics
+ *	and the copy is thrown away if a writer got in. Tables replaced by growth
+ *	stay allocated until DS_flush(), so a probe never touches freed memory.
+ */
+static bool _shard_read(_shard_pt shard, uint64_t hash, void * data){
+	const size_t slot_sz = _hslot_sz(&shard->table);
+	_hslot_pt    table, slot;
+	size_t       mask, i;
+	uint64_t     dist;
+	uint         seq;
+	bool         found;
+	
+	for(;;){
+		seq = atomic_load_explicit(&shard->seq, memory_order_acquire);
+		if(seq & 1){ // a writer is at work
+			sched_yield();
+			continue;
+		}
+		
+		table = atomic_load_explicit(&shard->slots, memory_order_acquire);
+		mask  = atomic_load_explicit(&shard->size , memory_order_acquire)-1;
+		atomic_thread_fence(memory_order_acquire);
+		if(atomic_load_explicit(&shard->seq, memory_order_relaxed) != seq)
+			continue;
+		
+		found = false;
+		i     = hash & mask;
+		dist  = 1;
+		while(table &&
+			_hslot_load((slot = (_hslot_pt)((int8_t*)table + i*slot_sz))->dist)
+				>= dist
+		){
+			if(_hslot_load(slot->hash) == hash){
+				_relaxed_copy(data, slot->data, shard->table.data_size);
+				found = true;
+				break;
+			}
+			dist++;
+			i = (i+1) & mask;
+		}
+		
+		atomic_thread_fence(memory_order_acquire);
+		if(atomic_load_explicit(&shard->seq, memory_order_relaxed) == seq)
+			return found;
+	}
+}
+
+// entries in the map, each shard is counted under its lock
+static size_t _sync_len(const DS root){
+	size_t len = 0;
+	
+	for(size_t i=0; i<root->table_size; i++){
+		pthread_mutex_lock(&root->head.s[i].lock);
+		len += root->head.s[i].table.count;
+		pthread_mutex_unlock(&root->head.s[i].lock);
+	}
+	
+	return len;
+}
+
+/********************************* SNAPSHOTS **********************************/
+
+/*	A snapshot file is this header followed by count entries of data_size
+ *	bytes packed together in traversal order. The checksum covers the header,
+ *	taken with the checksum field zeroed, and then each entry in turn.
+ *	Everything is in the byte order of the machine that wrote it.
+ */
+#define _SNAP_VERSION 1
+#define _SNAP_SEED    0xcbf29ce484222325
+
+static const char _snap_magic[8] = "DS_SNAP";
+
+struct _snap_head {
+	char     magic[8];
+	uint32_t version;
+	uint32_t type;
+	uint64_t data_size;
+	uint64_t count;
+	uint64_t checksum;
+};
+
+// FNV-1a a word at a time, with a shift so the high bits reach the low ones
+static uint64_t __attribute__((pure))
+_checksum(uint64_t sum, const void * data, size_t size){
+	const uint8_t * bytes = (const uint8_t*)data;
+	uint64_t        word;
+	
+	for(; size >= sizeof(word); size -= sizeof(word), bytes += sizeof(word)){
+		memcpy(&word, bytes, sizeof(word));
+		sum  = (sum ^ word) * 0x100000001b3;
+		sum ^= sum >> 32;
+	}
+	while(size--) sum = (sum ^ *bytes++) * 0x100000001b3;
+	
+	return sum;
+}
+
+static bool
+_snap_entry(FILE * file, const DS root, const void * data, uint64_t * sum){
+	*sum = _checksum(*sum, data, root->data_size);
+	return fwrite(data, root->data_size, 1, file) == 1 || !root->data_size;
+}
+
+// fill an empty dynamic array in one copy
+static return_t _snap_array(DS root, const int8_t * data, size_t count){
+	int8_t * new_array;
+	
+	if(root->table_size < count){
+		new_array = (int8_t*) realloc(root->tail.a, count*root->data_size);
+		if(!new_array){
+			_error(_e_mem);
+			return r_failure;
+		}
+		root->tail.a     = new_array;
+		root->table_size = count;
+	}
+	
+	root->head.a = root->tail.a;
+	memcpy(root->head.a, data, count*root->data_size);
+	root->count = (uint)count;
+	_array_seek(root, count-1);
+	
+	return r_success;
+}
+
+
+/******************************************************************************/
+//                       PUBLIC FUNCTION DEFINITIONS
+/******************************************************************************/
+
+
+/****************************** NEW STRUCTURE *********************************/
+
+DS DS_new_list(size_t data_size){
+	DS new_structure;
+	
+	// Allocate space
+	new_structure= (DS) calloc(1, sizeof(struct _root));
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->type       = DS_list;
+	new_structure->data_size  = data_size;
+	new_structure->count      = 0        ;
+	
+	return new_structure;
+}
+
+
+DS DS_new_circular(size_t data_size){
+	DS new_structure;
+	
+	// Allocate space
+	new_structure= (DS) calloc(1, sizeof(struct _root));
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->type       = DS_circular_list;
+	new_structure->data_size  = data_size;
+	new_structure->count      = 0        ;
+	
+	return new_structure;
+}
+
+
+DS DS_new_unrolled(size_t data_size){
+	DS     new_structure;
+	size_t block_cap;
+	
+	block_cap = (_UNROLL_BLOCK_SZ - sizeof(struct _list_block)) / (data_size? data_size : 1);
+	if(block_cap < 4) block_cap = 4;
+	
+	// Allocate space, with room to return removed data
+	new_structure= (DS) calloc(1, sizeof(struct _root) + data_size);
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->type       = DS_unrolled;
+	new_structure->data_size  = data_size;
+	new_structure->leaf_cap   = (uint)block_cap;
+	new_structure->count      = 0        ;
+	
+	return new_structure;
+}
+
+
+DS DS_new_array(size_t data_size){
+	DS new_structure;
+	
+	// Allocate space, with room to return removed data
+	new_structure= (DS) calloc(1, sizeof(struct _root) + data_size);
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->type       = DS_array;
+	new_structure->data_size  = data_size;
+	new_structure->count      = 0        ;
+	
+	return new_structure;
+}
+
+
+DS DS_new_bst(
+	size_t       data_size,
+	bool         duplicates_allowed,
+	const void * (*key)(const void * data),
+	imax         (*cmp_keys)(const void * left , const void * right)
+){
+	DS new_structure;
+	
+	if (!key || !cmp_keys){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	// Allocate space
+	new_structure= (DS) calloc(1, sizeof(struct _root));
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->keys.key = key;
+	new_structure->cmp_keys = cmp_keys;
+	
+	new_structure->type       = DS_bst;
+	new_structure->data_size  = data_size;
+	new_structure->count      = 0        ;
+	new_structure->dups       = duplicates_allowed;
+	
+	return new_structure;
+}
+
+DS DS_new_avl(
+	size_t       data_size,
+	bool         duplicates_allowed,
+	const void * (*key)(const void * data),
+	imax         (*cmp_keys)(const void * left , const void * right)
+){
+	DS new_structure;
+	
+	new_structure = DS_new_bst(data_size, duplicates_allowed, key, cmp_keys);
+	if (new_structure) new_structure->type = DS_avl;
+	
+	return new_structure;
+}
+
+DS DS_new_splay(
+	size_t       data_size,
+	bool         duplicates_allowed,
+	const void * (*key)(const void * data),
+	imax         (*cmp_keys)(const void * left , const void * right)
+){
+	DS new_structure;
+	
+	new_structure = DS_new_bst(data_size, duplicates_allowed, key, cmp_keys);
+	if (new_structure) new_structure->type = DS_splay;
+	
+	return new_structure;
+}
+
+DS DS_new_btree(
+	size_t       data_size,
+	size_t       key_size,
+	bool         duplicates_allowed,
+	const void * (*key)(const void * data),
+	imax         (*cmp_keys)(const void * left , const void * right)
+){
+	DS     new_structure;
+	size_t leaf_cap, node_cap;
+	
+	if (!key || !cmp_keys || !key_size){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	// fit as many entries as will go in a node
+	leaf_cap = (_BTREE_NODE_SZ - sizeof(struct _btree_node) - 8)
+		/ (key_size + data_size);
+	node_cap = (_BTREE_NODE_SZ - sizeof(struct _btree_node) - 8 - sizeof(_bnode_pt))
+		/ (key_size + sizeof(_bnode_pt));
+	
+	if(leaf_cap < 4) leaf_cap = 4;
+	if(node_cap < 3) node_cap = 3;
+	if(!(node_cap & 1)) node_cap--; // internal splits need an odd count
+	
+	// Allocate space, with room to return removed data
+	new_structure= (DS) calloc(1, sizeof(struct _root) + data_size);
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->keys.key = key;
+	new_structure->cmp_keys = cmp_keys;
+	
+	new_structure->type       = DS_btree;
+	new_structure->data_size  = data_size;
+	new_structure->key_size   = key_size;
+	new_structure->leaf_cap   = (uint)leaf_cap;
+	new_structure->node_cap   = (uint)node_cap;
+	new_structure->count      = 0        ;
+	new_structure->dups       = duplicates_allowed;
+	
+	return new_structure;
+}
+
+DS DS_new_heap(
+	size_t data_size,
+	imax    (*cmp_data)(const void * left , const void * right)
+){
+	DS new_structure;
+	
+	if (!cmp_data){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	// Allocate space
+	new_structure= (DS) calloc(1, sizeof(struct _root));
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->type      = DS_heap         ;
+	new_structure->data_size = data_size       ;
+	new_structure->count     = 0               ;
+	new_structure->cmp_keys  = cmp_data        ;
+	new_structure->leaf_cap  = DS_DEFAULT_ARITY;
+	
+	return new_structure;
+}
+
+DS DS_new_keyed_heap(
+	size_t data_size,
+	size_t key_size,
+	const void * (*key)(const void * data),
+	imax         (*cmp_keys)(const void * left, const void * right)
+){
+	DS new_structure;
+	
+	if (!key || !key_size || !data_size){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	new_structure = DS_new_heap(data_size, cmp_keys);
+	if (!new_structure) return NULL;
+	
+	new_structure->key_size = key_size;
+	new_structure->keys.key = key;
+	
+	// the payloads are packed into slabs
+	if (DS_arena(new_structure, 0)){
+		free(new_structure);
+		return NULL;
+	}
+	
+	return new_structure;
+}
+
+DS DS_new_radix_heap(size_t data_size){
+	DS new_structure;
+	
+	// the buckets follow the root in the same allocation
+	new_structure = (DS) calloc(1, sizeof(struct _root)+sizeof(struct _radix));
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->type      = DS_radix;
+	new_structure->data_size = data_size;
+	new_structure->head.x    = (_radix_pt)(void*)(new_structure+1);
+	
+	return new_structure;
+}
+
+DS DS_new_pairing_heap(
+	size_t data_size,
+	imax   (*cmp_data)(const void * left , const void * right)
+){
+	DS new_structure;
+	
+	new_structure = DS_new_heap(data_size, cmp_data);
+	if (new_structure) new_structure->type = DS_pairing;
+	
+	return new_structure;
+}
+
+
+
+DS DS_new_hash(
+	size_t   data_size,
+	size_t   table_size,
+	bool     duplicates_allowed,
+	uint64_t (*hash_func)(const void * data)
+){
+	DS new_structure;
+	
+	if (!hash_func){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	// the table itself is allocated on the first insertion
+	table_size = _pow2_ceil(table_size? table_size : DS_DEFAULT_TABLE_SZ);
+	if (!table_size) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	// Allocate space
+	new_structure= (DS) calloc(1, sizeof(struct _root));
+	if (new_structure == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure->type      = DS_hash           ;
+	new_structure->data_size = data_size         ;
+	new_structure->count     = 0                 ;
+	new_structure->dups      = duplicates_allowed;
+	new_structure->keys.hash = hash_func         ;
+	new_structure->table_size = table_size;
+	
+	return new_structure;
+}
+
+DS DS_new_mpmc_queue(size_t data_size, size_t capacity){
+	DS     new_structure;
+	size_t cell;
+	
+	if (!capacity){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	capacity = _pow2_ceil(capacity);
+	cell     = (sizeof(struct _queue_cell)+data_size+7) & ~(size_t)7;
+	if (!capacity || data_size > SIZE_MAX/2
+		|| capacity > (SIZE_MAX - sizeof(struct _queue))/cell
+	){
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	// the ring follows the root in the same allocation
+	new_structure = _new_aligned(sizeof(struct _queue) + capacity*cell);
+	if (new_structure == NULL) return NULL;
+	
+	new_structure->type       = DS_mpmc  ;
+	new_structure->data_size  = data_size;
+	new_structure->table_size = capacity ;
+	_queue_reset(new_structure);
+	
+	return new_structure;
+}
+
+DS DS_new_spsc_queue(size_t data_size, size_t capacity){
+	DS new_structure;
+	
+	if (!capacity){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	capacity = _pow2_ceil(capacity);
+	if (!capacity
+		|| (data_size && capacity > (SIZE_MAX - sizeof(struct _ring))/data_size)
+	){
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	new_structure = _new_aligned(sizeof(struct _ring) + capacity*data_size);
+	if (new_structure == NULL) return NULL;
+	
+	new_structure->type       = DS_spsc  ;
+	new_structure->data_size  = data_size;
+	new_structure->table_size = capacity ;
+	_queue_reset(new_structure);
+	
+	return new_structure;
+}
+
+DS DS_new_ws_deque(size_t data_size){
+	DS new_structure;
+	
+	// the array itself is allocated on the first push
+	new_structure = _new_aligned(sizeof(struct _deque));
+	if (new_structure == NULL) return NULL;
+	
+	new_structure->type      = DS_wsdeque;
+	new_structure->data_size = data_size ;
+	atomic_init(&new_structure->head.d->top   , 0);
+	atomic_init(&new_structure->head.d->bottom, 0);
+	atomic_init(&new_structure->head.d->array , NULL);
+	
+	return new_structure;
+}
+
+DS DS_new_sync_hash(
+	size_t   data_size,
+	size_t   shards,
+	uint64_t (*hash_func)(const void * data)
+){
+	DS        new_structure;
+	_shard_pt shard;
+	
+	if (!hash_func){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	shards = shards? _pow2_ceil(shards) : DS_DEFAULT_SHARDS;
+	if (!shards || shards > SIZE_MAX/sizeof(struct _shard)){
+		_error(_e_mem);
+		return NULL;
+	}
+	
+	// the shards follow the root in the same allocation
+	new_structure = _new_aligned(shards*sizeof(struct _shard));
+	if (new_structure == NULL) return NULL;
+	
+	new_structure->type       = DS_sync  ;
+	new_structure->data_size  = data_size;
+	new_structure->keys.hash  = hash_func;
+	new_structure->table_size = shards   ;
+	
+	// the tables themselves are allocated on their first insertion
+	for(size_t i=0; i<shards; i++){
+		shard = new_structure->head.s + i;
+		atomic_init(&shard->seq, 0);
+		atomic_init(&shard->slots, NULL);
+		pthread_mutex_init(&shard->lock, NULL);
+		memset(&shard->table, 0, sizeof(struct _root));
+		
+		shard->table.type       = DS_hash  ;
+		shard->table.data_size  = data_size;
+		shard->table.keys.hash  = hash_func;
+		shard->table.shared     = true     ;
+		shard->table.table_size = _pow2_ceil(DS_DEFAULT_TABLE_SZ/shards);
+		atomic_init(&shard->size, shard->table.table_size);
+	}
+	
+	return new_structure;
+}
+
+/********************** ACTIONS ON WHOLE DATA STRUCTURE ***********************/
+
+inline void DS_delete(DS root){
+	DS_empty(root);
+	DS_flush(root); // clear the freelist
+	
+	if(root->type == DS_sync)
+		for(size_t i=0; i<root->table_size; i++)
+			pthread_mutex_destroy(&root->head.s[i].lock);
+	
+	free(root);
+}
+
+void DS_empty (DS root){
+	_node_pt  node;
+	_tnode_pt child;
+	
+	if(root->type == DS_heap){
+		root->current.e = NULL;
+		root->count     = 0;
+		return;
+	}
+	else if(root->type == DS_hash){
+		if(root->head.h && root->shared) // readers stop at an empty slot
+			for(size_t i=0; i<root->table_size; i++)
+				_hslot_set(root, &_hslot_at(root, i)->dist, 0);
+		else if(root->head.h)
+			memset(root->head.h, 0, root->table_size*_hslot_sz(root));
+		root->current.h = NULL;
+		root->count     = 0;
+		return;
+	}
+	else if(root->arena){ // drop every node at once
+		_arena_release(root, true);
+		root->freelist.l = NULL;
+		root->head.l     = NULL;
+		root->tail.l     = NULL;
+		root->current.l  = NULL;
+		root->count      = 0;
+		return;
+	}
+	else if(root->type == DS_unrolled){ // move all the blocks to the freelist
+		if(root->head.u){
+			root->tail.u->next = root->freelist.u;
+			root->freelist     = root->head;
+		}
+		root->head.u    = NULL;
+		root->tail.u    = NULL;
+		root->current.u = NULL;
+		root->count     = 0;
+		return;
+	}
+	else if(root->type == DS_array){
+		root->head      = root->tail;
+		root->current.a = NULL;
+		root->count     = 0;
+		return;
+	}
+	else if(root->type == DS_mpmc || root->type == DS_spsc){
+		_queue_reset(root);
+		return;
+	}
+	else if(root->type == DS_radix){ // keep the bucket arrays
+		for(uint i=0; i<_RADIX_BUCKETS; i++)
+			root->head.x->bucket[i].start = root->head.x->bucket[i].count = 0;
+		root->head.x->last = 0;
+		root->current.x    = NULL;
+		root->count        = 0;
+		return;
+	}
+	else if(root->type == DS_wsdeque){
+		atomic_store(&root->head.d->top   , 0);
+		atomic_store(&root->head.d->bottom, 0);
+		return;
+	}
+	else if(root->type == DS_sync){
+		for(size_t i=0; i<root->table_size; i++){
+			_shard_lock(root->head.s+i);
+			DS_empty(&root->head.s[i].table);
+			_shard_unlock(root->head.s+i);
+		}
+		return;
+	}
+	else if(root->type == DS_pairing){ // unfold it into a list of siblings
+		node = root->head;
+		while(node.t){
+			if(node.t->left){
+				child        = node.t->left;
+				node.t->left = child->right;
+				child->right = node.t;
+				node.t       = child;
+			}
+			else{
+				child = node.t->right;
+				if(!root->intrusive){
+					node.t->left     = root->freelist.t;
+					root->freelist.t = node.t;
+				}
+				node.t = child;
+			}
+		}
+		root->head.t    = NULL;
+		root->current.t = NULL;
+		root->count     = 0;
+		return;
+	}
+	else if(root->type == DS_btree){
+		if(root->head.b) _btree_clear(root, root->head.b);
+		root->head.b    = NULL;
+		root->current.b = NULL;
+		root->count     = 0;
+		return;
+	}
+	
+	while (DS_remove(root));
+}
+
+void DS_flush (DS root){
+	_node_pt    dead_node;
+	_rbucket_pt bucket;
+	size_t      fit;
+	
+	if(root->slab_size){ // arena nodes can only be released all together
+		if(!root->count){
+			_arena_release(root, false);
+			root->freelist.l = NULL;
+			root->slots      = 0;
+		}
+		if(root->type != DS_heap) return; // a keyed heap also has its array
+	}
+	
+	switch (root->type){
+	case DS_list:
+	case DS_circular_list:
+		while (root->freelist.l) {
+		dead_node = root->freelist;
+		root->freelist.l = root->freelist.l->prev;
+		free(dead_node.l);
+		}
+		return;
+	
+	case DS_unrolled:
+		while (root->freelist.u) {
+		dead_node = root->freelist;
+		root->freelist.u = root->freelist.u->next;
+		free(dead_node.u);
+		}
+		return;
+	
+	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+	case DS_pairing:
+		while (root->freelist.t) {
+		dead_node = root->freelist;
+		root->freelist.t = root->freelist.t->left;
+		free(dead_node.t);
+		}
+		return;
+	
+	case DS_btree:
+		while (root->freelist.b) {
+		dead_node = root->freelist;
+		root->freelist.b = root->freelist.b->next;
+		free(dead_node.b);
+		}
+		return;
+	
+	case DS_array:
+		if(!root->count){
+			free(root->tail.a);
+			root->head.a     = NULL;
+			root->tail.a     = NULL;
+			root->table_size = 0;
+		}
+		else if(root->count < root->table_size){ // shrink to fit
+			memmove(root->tail.a, root->head.a, root->count*root->data_size);
+			root->head.a = root->tail.a;
+			dead_node.a = (int8_t*) realloc(root->tail.a, root->count*root->data_size);
+			if(dead_node.a){
+				root->head       = dead_node;
+				root->tail       = dead_node;
+				root->table_size = root->count;
+			}
+			_array_seek(root, root->index);
+		}
+		return;
+	
+	case DS_heap:
+		if(!root->count){
+			if(root->head.e) free(_heap_base(root));
+			root->head.e     = NULL;
+			root->table_size = 0;
+		}
+		else if(root->key_size){ // keep the free payloads
+			if(root->slots < root->table_size) _heap_resize(root, root->slots);
+		}
+		else if(root->count < root->table_size) // shrink to fit
+			_heap_resize(root, root->count);
+		return;
+	
+	case DS_hash:
+		if(!root->count){
+			free(root->head.h);
+			root->head.h = NULL;
+		}
+		else{ // shrink the table to fit its contents
+			fit = _pow2_ceil(root->count + root->count/7 + 1);
+			if(fit < root->table_size && _hash_resize(root, fit) == r_success){
+				root->current.h = _hash_scan(root, 0);
+				root->index     = 0;
+			}
+		}
+		
+		// tables replaced in a shard are linked through their first slot
+		while(root->freelist.h){
+			dead_node        = root->freelist;
+			root->freelist.h = (_hslot_pt)(uintptr_t)root->freelist.h->hash;
+			free(dead_node.h);
+		}
+		return;
+	
+	case DS_sync: // no reader can be probing a replaced table now
+		for(size_t i=0; i<root->table_size; i++)
+			DS_flush(&root->head.s[i].table);
+		return;
+	
+	case DS_spsc:
+	case DS_mpmc: return; // the ring is allocated with the root
+	
+	case DS_radix: // release the buckets that hold nothing
+		for(uint i=0; i<_RADIX_BUCKETS; i++){
+			bucket = root->head.x->bucket + i;
+			if(bucket->start < bucket->count) continue;
+			free(bucket->entries);
+			memset(bucket, 0, sizeof(struct _radix_bucket));
+		}
+		return;
+	
+	case DS_wsdeque: // no thief can be reading a replaced array now
+		while (root->freelist.w) {
+		dead_node = root->freelist;
+		root->freelist.w = root->freelist.w->next;
+		free(dead_node.w);
+		}
+		
+		if(DS_isempty(root)){
+			free(atomic_load(&root->head.d->array));
+			atomic_store(&root->head.d->array, NULL);
+		}
+		return;
+	
+	default: _error(_e_invtype); return;
+	}
+}
+
+
+return_t DS_arena(DS root, size_t slab_size){
+	size_t min;
+	
+	if (!root){
+		_error(_e_null);
+		return r_failure;
+	}
+	
+	if (!_node_sz(root) || root->count || root->intrusive){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	// release whatever the structure is holding now
+	DS_flush(root);
+	
+	// every slab holds a reasonable number of nodes
+	min = ((_node_sz(root)+7) & ~(size_t)7)*16;
+	if (!slab_size) slab_size = DS_DEFAULT_SLAB_SZ;
+	root->slab_size = slab_size < min? min : slab_size;
+	
+	return r_success;
+}
+
+return_t DS_intrusive(DS root, size_t hook_offset){
+	if (!root){
+		_error(_e_null);
+		return r_failure;
+	}
+	
+	switch (root->type){
+	case DS_list         :
+	case DS_circular_list:
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_heap         :
+	case DS_pairing      : break;
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_btree        :
+	case DS_hash         :
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return r_failure;
+	default              : _error(_e_invtype); return r_failure;
+	}
+	
+	if (root->count || root->slab_size){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	// cached nodes and arrays were sized for copies of the data
+	DS_flush(root);
+	
+	root->intrusive = true;
+	root->hook      = hook_offset;
+	if (root->type == DS_heap) root->data_size = sizeof(void*);
+	
+	return r_success;
+}
+
+return_t DS_key_prefix(DS root, uint64_t (*prefix)(const void * key)){
+	if (!root || !prefix){
+		_error(_e_null);
+		return r_failure;
+	}
+	
+	switch (root->type){
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        : break;
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_btree        :
+	case DS_heap         :
+	case DS_hash         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return r_failure;
+	default              : _error(_e_invtype); return r_failure;
+	}
+	
+	// the nodes already in the tree have no prefix
+	if (root->count){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	root->prefix = prefix;
+	return r_success;
+}
+
+return_t DS_heap_arity(DS root, uint arity){
+	if (!root){
+		_error(_e_null);
+		return r_failure;
+	}
+	
+	if (root->type != DS_heap || root->count || arity < 2){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	// the padding at the front of the array depends on the arity
+	DS_flush(root);
+	
+	root->leaf_cap = arity;
+	return r_success;
+}
+
+// the first eight bytes, big endian so that integer order is strcmp() order
+uint64_t __attribute__((pure)) DS_prefix_string(const void * key){
+	const uint8_t * str    = (const uint8_t*)key;
+	uint64_t        prefix = 0;
+	uint            i;
+	
+	for (i = 0; i < 8 && str[i]; i++) prefix |= (uint64_t)str[i] << (56 - 8*i);
+	return prefix;
+}
+
+uint64_t __attribute__((pure)) DS_prefix_u64(const void * key){
+	return *(const uint64_t*)key;
+}
+
+// Simple tests
+inline uint DS_count(const DS root) {
+	if (!root){
+		_error(_e_null);
+		return 0;
+	}
+	if (root->type == DS_mpmc || root->type == DS_spsc)
+		return (uint)_queue_len(root);
+	if (root->type == DS_wsdeque) return (uint)_deque_len(root);
+	if (root->type == DS_sync) return (uint)_sync_len(root);
+	return root->count;
+}
+
+inline bool DS_isempty (const DS root) {
+	if (!root){
+		_error(_e_null);
+		return true;
+	}
+	if (root->type == DS_mpmc || root->type == DS_spsc)
+		return !_queue_len(root);
+	if (root->type == DS_wsdeque) return !_deque_len(root);
+	if (root->type == DS_sync) return !_sync_len(root);
+	return !root->count;
+}
+
+bool DS_isleaf (const DS root){
+	if (!root){
+		_error(_e_null);
+		return false;
+	}
+
+	switch (root->type){
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        : break;
+	case DS_btree        :
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         :
+	case DS_list         :
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_circular_list: _error(_e_nsense); return false;
+	default: _error(_e_invtype); return false;
+	}
+	
+	return (!( root->current.t->left || root->current.t->right ));
+}
+
+// Dump the contents of the data structure
+void DS_dump (const DS root){
+	_node_pt this_node;
+	
+	if (!root){
+		_error(_e_null);
+		return;
+	}
+	
+	this_node = root->head;
+	
+	switch (root->type){
+	case DS_list:
+		while(this_node.l != NULL) {
+			printf("%s\n", (char*) _data(root, this_node.l));
+			this_node.l = this_node.l->next;
+		}
+		break;
+	
+	case DS_circular_list:
+		if (this_node.l == NULL) break;
+		do {
+			printf("%s\n", (char*) _data(root, this_node.l));
+			this_node.l = this_node.l->next;
+		} while (this_node.l != root->head.l);
+		break;
+	
+	case DS_bst :
+	case DS_avl :
+	case DS_splay:
+		if (this_node.t == NULL) break;
+		_print_node(root->head.t, 0);
+		break;
+	
+	case DS_btree: // in order
+		if (this_node.b == NULL) break;
+		for(this_node.b = _btree_first(root); this_node.b;
+			this_node.b = this_node.b->next)
+			for(uint i=0; i<this_node.b->count; i++)
+				printf("%s\n", (char*) _bdata(root, this_node.b, i));
+		break;
+	
+	case DS_unrolled:
+		for(; this_node.u; this_node.u = this_node.u->next)
+			for(uint i=0; i<this_node.u->count; i++)
+				printf("%s\n", (char*) _uelem(root, this_node.u, i));
+		break;
+	
+	case DS_array:
+		for(uint i=0; i<root->count; i++)
+			printf("%s\n", (char*) _aelem(root, i));
+		break;
+	
+	case DS_heap: // array order
+		for(uint i=0; i<root->count; i++)
+			printf("%s\n", (char*) _edata(root, _hent_at(root, i)));
+		break;
+	
+	case DS_pairing: // preorder
+		for(; this_node.t; this_node.t = _pair_next(this_node.t))
+			printf("%s\n", (char*) _data(root, this_node.t));
+		break;
+	
+	case DS_radix: // bucket order
+		if (!root->data_size) break;
+		for(uint i=0; i<_RADIX_BUCKETS; i++){
+			this_node.x = root->head.x;
+			for(size_t j=this_node.x->bucket[i].start;
+				j<this_node.x->bucket[i].count; j++)
+				printf("%s\n", (char*) _rent_data(
+					_rent_at(root, this_node.x->bucket+i, j)));
+		}
+		break;
+	
+	case DS_hash:
+		if (this_node.h == NULL) break;
+		for(size_t i=0; i<root->table_size; i++){
+			this_node.h = _hslot_at(root, i);
+			if(this_node.h->dist) printf("%s\n", (char*) this_node.h->data);
+		}
+		break;
+	
+	case DS_sync:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_mpmc: // entries may be changing under us
+		_error(_e_nsense);
+		break;
+	
+	default:
+		_error(_e_invtype);
+	}
+}
+
+/**************************** ADD TO DATA STRUCTURE ***************************/
+
+void * DS_insert (DS root, const void * data){
+	_node_pt    new_node;
+	_tnode_pt * position;
+	imax        result;
+	uint64_t    hash, prefix;
+	uint        pos;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	switch (root->type){
+	case DS_list:
+		if (root->current.l == root->head.l)
+			return DS_insert_first(root, data);
+		else if (root->current.l == root->tail.l)
+			return DS_insert_last (root, data);
+		
+		new_node = _data_node(root, data);
+		if (new_node.l == NULL) return NULL;
+		
+		if (root->head.l == NULL){
+			root->head = new_node;
+			root->tail = new_node;
+		}
+		else {
+			new_node.l->next=root->current.l;
+			new_node.l->prev=root->current.l->prev;
+			root->current.l->prev->next = new_node.l;
+			root->current.l->prev       = new_node.l;
+		}
+		
+		root->current=new_node;
+		root->count++;
+		
+		return _data(root, new_node.l);
+	
+	
+	case DS_unrolled:
+		if (!root->count) return DS_insert_first(root, data);
+		return _ulist_insert(root, root->current.u, (uint)root->index, data);
+	
+	case DS_array:
+		if (!root->count) return DS_insert_last(root, data);
+		
+		// shift whichever side of the current position is shorter
+		if (root->index < root->count/2){
+			if (_array_room(root, true) == r_failure) return NULL;
+			root->head.a -= root->data_size;
+			memmove(root->head.a, root->head.a + root->data_size,
+				root->index*root->data_size);
+		}
+		else{
+			if (_array_room(root, false) == r_failure) return NULL;
+			memmove(_aelem(root, root->index+1), _aelem(root, root->index),
+				(root->count-root->index)*root->data_size);
+		}
+		root->count++;
+		
+		return memcpy(_array_seek(root, root->index), data, root->data_size);
+	
+	
+	case DS_circular_list:
+		new_node = _data_node(root, data);
+		if (new_node.l == NULL) return NULL;
+		
+		if (root->head.l == NULL){
+			root->head = new_node;
+			new_node.l->next = new_node.l;
+			new_node.l->prev = new_node.l;
+		}
+		else {
+			new_node.l->next=root->current.l;
+			new_node.l->prev=root->current.l->prev;
+			root->current.l->prev->next = new_node.l;
+			root->current.l->prev       = new_node.l;
+		}
+		
+		root->current=new_node;
+		root->count++;
+		
+		return _data(root, new_node.l);
+	
+	
+	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+		// Find the position
+		prefix   = _tree_prefix(root, root->keys.key(data));
+		position = &(root->head.t);
+		while (*position){
+			root->current.t = *position;
+			result = _tree_cmp(root, root->keys.key(data), prefix, *position);
+			if      (result <0) position = &(root->current.t->left);
+			else if (result >0) position = &(root->current.t->right);
+			else { // result is 0
+				if(root->dups) position = &(root->current.t->right);
+				else {
+					//_error(_e_repeat);
+					return NULL;
+				}
+			}
+		}
+		
+		// position now points to a null _tnode_pt where the new node will go
+		
+		// allocate the node
+		new_node = _data_node(root, data);
+		if (new_node.t == NULL) return NULL;
+		
+		// insert the node
+		new_node.t->parent = root->current.t;
+		new_node.t->prefix = prefix;
+		*position = new_node.t;
+		root->current=new_node;
+		root->count++;
+		_tree_grow(new_node.t);
+		
+		if     (root->type == DS_avl  ) _avl_rebalance(root, new_node.t->parent);
+		else if(root->type == DS_splay) _splay(root, new_node.t);
+		
+		return _data(root, new_node.t);
+	
+	case DS_btree:
+		if (root->head.b == NULL){
+			new_node = _new_node(root);
+			if (new_node.b == NULL) return NULL;
+			root->head = new_node;
+		}
+		
+		// equal keys go after the ones already there
+		new_node.b = _btree_descend(root, root->keys.key(data), true);
+		pos = _btree_bound(root, new_node.b, root->keys.key(data), true);
+		
+		if(!root->dups && pos && !root->cmp_keys(
+			root->keys.key(data), _bkey(root, new_node.b, pos-1)
+		))
+			return NULL;
+		
+		return _btree_insert(root, new_node.b, pos, data);
+	
+	case DS_heap:
+		// make room
+		if(root->count == root->table_size && _heap_resize(
+			root, root->table_size? root->table_size<<1 : DS_DEFAULT_HEAP_SZ
+		) == r_failure)
+			return NULL;
+		
+		// sift it up from the bottom of the heap
+		new_node.e = _hent_tmp(root);
+		new_node.e->serial = root->serial++;
+		if(!_heap_put(root, new_node.e, data)) return NULL;
+		new_node.e = _hent_at(root, _sift_up(root->head.e, 0, root->count,
+			_hent_sz(root), root->leaf_cap, _heap_cmp_for(root), root,
+			new_node.e));
+		root->count++;
+		root->current = root->head;
+		
+		return _edata(root, new_node.e);
+	
+	case DS_pairing:
+		new_node = _data_node(root, data);
+		if (new_node.t == NULL) return NULL;
+		
+		new_node.t->size = root->serial++;
+		root->head.t     = _pair_meld(root, root->head.t, new_node.t);
+		root->current    = root->head;
+		root->count++;
+		
+		return _data(root, new_node.t);
+	
+	case DS_hash:
+		hash = root->keys.hash(data);
+		if(!root->dups && _hash_lookup(root, hash)) return NULL;
+		
+		// make room
+		if(!root->head.h || root->count+1 > _hash_max_load(root->table_size)){
+			if(_hash_resize(root, root->head.h?
+				root->table_size<<1 : root->table_size
+			) == r_failure)
+				return NULL;
+		}
+		
+		root->current.h = _hash_place(root, hash, data);
+		root->index     = 0;
+		root->count++;
+		return root->current.h->data;
+	
+	case DS_sync:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_radix:
+	case DS_mpmc: _error(_e_nsense); return NULL;
+	default: _error(_e_invtype); return NULL;
+	}
+}
+
+void * DS_insert_first(DS root, const void * data){
+	_node_pt new_node;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	switch (root->type){
+	case DS_list         : break;
+	case DS_unrolled     : // fill the first block downward
+		if (!root->head.u || !root->head.u->start){
+			if (!( new_node.u = _ulist_link(root, NULL) )) return NULL;
+			new_node.u->start = root->leaf_cap;
+		}
+		root->head.u->start--;
+		root->head.u->count++;
+		root->count++;
+		return memcpy(_ulist_seek(root, root->head.u, 0), data, root->data_size);
+	
+	case DS_array        :
+		if (_array_room(root, true) == r_failure) return NULL;
+		root->head.a -= root->data_size;
+		root->count++;
+		return memcpy(_array_seek(root, 0), data, root->data_size);
+	
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         :
+	case DS_circular_list:
+	case DS_heap         :
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_btree        : _error(_e_nsense ); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+	
+	// allocate the node
+	new_node = _data_node(root, data);
+	if (new_node.l == NULL) return NULL;
+	
+	// if the structure is empty
+	if (root->head.l == NULL) root->tail=new_node;
+	else{
+		new_node.l->next = root->head.l;
+		root->head.l->prev = new_node.l;
+	}
+	root->current=new_node;
+	root->head   =new_node;
+	root->count++;
+	
+	return _data(root, new_node.l);
+}
+
+void * DS_insert_last (DS root, const void * data){
+	_node_pt new_node;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	switch (root->type){
+	case DS_list         : break;
+	case DS_unrolled     : // fill the last block upward
+		if (!root->tail.u ||
+			root->tail.u->start + root->tail.u->count == root->leaf_cap)
+			if (!_ulist_link(root, root->tail.u)) return NULL;
+		root->tail.u->count++;
+		root->count++;
+		return memcpy(
+			_ulist_seek(root, root->tail.u, root->tail.u->count-1),
+			data, root->data_size
+		);
+	
+	case DS_array        :
+		if (_array_room(root, false) == r_failure) return NULL;
+		root->count++;
+		return memcpy(_array_seek(root, root->count-1), data, root->data_size);
+	
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         :
+	case DS_circular_list:
+	case DS_heap         :
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_btree        : _error(_e_nsense ); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+	
+	// allocate the node
+	new_node = _data_node(root, data);
+	if (new_node.l == NULL) return NULL;
+	
+	// if the structure is empty
+	if (root->head.l == NULL) root->head=new_node;
+	else{
+		new_node.l->prev = root->tail.l;
+		root->tail.l->next = new_node.l;
+	}
+	
+	root->current=new_node;
+	root->tail   =new_node;
+	root->count++;
+	
+	return _data(root, new_node.l);
+}
+
+return_t DS_bulk_load(DS root, const void * data, size_t count){
+	const int8_t * next  = (const int8_t*) data;
+	_tnode_pt      spare = NULL;
+	_node_pt       node;
+	size_t         got;
+	
+	if (!root){
+		_error(_e_null);
+		return r_failure;
+	}
+	
+	if ((root->type != DS_bst && root->type != DS_avl && root->type != DS_splay)
+		|| root->count || root->intrusive){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	if ((uint)count != count){
+		_error(_e_over);
+		return r_failure;
+	}
+	
+	// get every node first so that a failure leaves the tree untouched
+	for(got=0; got<count; got++){
+		node = _new_node(root);
+		if (!node.t) break;
+		node.t->left = spare;
+		spare        = node.t;
+	}
+	
+	if (got < count){ // give back what we got
+		while(spare){
+			node.t           = spare;
+			spare            = spare->left;
+			node.t->left     = root->freelist.t;
+			root->freelist.t = node.t;
+		}
+		return r_failure;
+	}
+	
+	root->head.t    = _tree_build(root, &spare, &next, count, NULL);
+	root->current.t = root->head.t? _tree_max(root->head.t) : NULL;
+	root->count     = (uint)count;
+	
+	return r_success;
+}
+
+/*********************** REMOVE FROM DATA STRUCTURE ***************************/
+
+const void * DS_remove(DS root){
+	const void * data;
+	_hslot_pt slot, next;
+	size_t    idx, i, end;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	//data = _data(root, root->current.l);
+	
+	switch (root->type){
+	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+		// save the data
+		data = _data(root, root->current.t);
+		
+		_tree_remove(root, root->current.t);
+		
+		// Reset current to the head
+		root->current = root->head;
+		return data;
+	
+	case DS_btree:
+		data = memcpy(_scratch(root),
+			_bdata(root, root->current.b, root->index), root->data_size);
+		_btree_erase(root, root->current.b, (uint)root->index);
+		return data;
+	
+	case DS_unrolled:
+		return _ulist_remove(root, root->current.u, (uint)root->index);
+	
+	case DS_array:
+		data = memcpy(_scratch(root), root->current.a, root->data_size);
+		
+		// close the gap from whichever side is shorter
+		if (root->index < root->count/2){
+			memmove(root->head.a + root->data_size, root->head.a,
+				root->index*root->data_size);
+			root->head.a += root->data_size;
+		}
+		else memmove(root->current.a, root->current.a + root->data_size,
+			(root->count-root->index-1)*root->data_size);
+		
+		// set current to the following entry
+		if (!--root->count) root->current.a = NULL;
+		else _array_seek(root,
+			root->index < root->count? root->index : root->count-1);
+		return data;
+		
+	case DS_list:
+		// save the data
+		data = _data(root, root->current.l);
+		
+		// Check if we are at the beginning or end
+		if (root->current.l == root->head.l)
+			return DS_remove_first(root);
+		else if (root->current.l == root->tail.l)
+			return DS_remove_last (root);
+	
+	case DS_circular_list:
+		// save the data
+		data = _data(root, root->current.l);
+		
+		if (root->current.l->next == root->current.l){
+			// last node in a circular list
+			root->head.l = NULL;
+		}
+		else{
+			// Close the gap
+			root->current.l->prev->next = root->current.l->next;
+			root->current.l->next->prev = root->current.l->prev;
+		}
+		
+		_lnode_free(root, root->current.l);
+		
+		root->current.l = root->current.l->next;
+		break;
+	
+	case DS_hash:
+		if(!( slot = _hash_current(root) )) return NULL;
+		idx = _hslot_idx(root, slot);
+		end = root->table_size - root->index;
+		
+		// save the data in the scratch slot
+		data = memcpy(
+			_hslot_at(root, root->table_size)->data,
+			slot->data,
+			root->data_size
+		);
+		
+		// shift the following entries back toward their home slots
+		i = idx;
+		while((next = _hslot_at(root, (i+1) & (root->table_size-1)))->dist > 1){
+			_hslot_copy(root, slot, next);
+			_hslot_set(root, &slot->dist, next->dist-1);
+			slot = next;
+			i++;
+		}
+		_hslot_set(root, &slot->dist, 0);
+		
+		// a visited entry moved into the walk, from slot 0 or the slots after it
+		if(i >= end) root->index++;
+		
+		// current stays on the slot, see _hash_current()
+		if (--root->count == 0) root->current.h = NULL;
+		else root->current.h = _hslot_at(root, idx);
+		
+		return data;
+	
+	case DS_heap:
+		// save the top in the scratch entry
+		memcpy(_hent_at(root, root->table_size), root->head.e, _hent_sz(root));
+		data = _edata(root, _hent_at(root, root->table_size));
+		
+		// sift the bottom down from the top
+		if (--root->count)
+			_sift_down(root->head.e, 0, root->count-1, _hent_sz(root),
+				root->leaf_cap, _heap_cmp_for(root), root,
+				_hent_at(root, root->count));
+		else root->current.e = NULL;
+		
+		// the payload is free, but unchanged until the next insertion
+		if (root->key_size)
+			memcpy(_hent_at(root, root->count)->data, &data, sizeof(data));
+		
+		return data;
+	
+	case DS_pairing: return _pair_remove(root, root->head.t);
+	case DS_radix  : return DS_radix_pop(root, NULL);
+	
+	case DS_sync:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_mpmc: _error(_e_nsense); return NULL;
+	default: _error(_e_invtype); return NULL;
+	}
+	
+	if (!root->head.l){
+		root->current.l = NULL;
+		root->tail.l    = NULL;
+	}
+	
+	root->count--;
+	return data;
+}
+
+
+const void * DS_remove_first(DS root){
+	const void * data;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
+	case DS_list:
+		root->current = root->head;
+		data = _data(root, root->current.l);
+		
+		// remove from structure
+		root->head.l = root->head.l->next;
+		if (root->head.l) root->head.l->prev = NULL;
+		
+		_lnode_free(root, root->current.l);
+		
+		// set current
+		root->current = root->head;
+		if (!root->head.l) root->tail.l = NULL;
+		
+		break;
+	
+	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+		root->current = root->head;
+		while(root->current.t->left) root->current.t = root->current.t->left;
+		
+		data = _data(root, root->current.t);
+		_tree_remove(root, root->current.t);
+		
+		// set current to next in-order node
+		root->current = root->head;
+		if (root->current.t) // may have been the last node
+			while (root->current.t->left)
+				root->current.t = root->current.t->left;
+		
+		return data;
+	
+	case DS_unrolled: return _ulist_remove(root, root->head.u, 0);
+	
+	case DS_array: // the vacated slot holds the data until the next insertion
+		data = root->head.a;
+		root->head.a += root->data_size;
+		if (!--root->count) root->current.a = NULL;
+		else _array_seek(root, 0);
+		return data;
+	
+	case DS_btree:
+		root->current.b = _btree_first(root);
+		data = memcpy(_scratch(root),
+			_bdata(root, root->current.b, 0), root->data_size);
+		_btree_erase(root, root->current.b, 0);
+		return data;
+	
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         :
+	case DS_circular_list: _error(_e_nsense ); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+	
+	root->count--;
+	return data;
+}
+
+
+const void * DS_remove_last (DS root){
+	const void * data;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
+	case DS_list:
+		root->current = root->tail;
+		data = _data(root, root->current.l);
+		
+		// remove from structure
+		root->tail.l = root->tail.l->prev;
+		if (root->tail.l) root->tail.l->next = NULL;
+		
+		_lnode_free(root, root->current.l);
+		
+		// set current
+		root->current = root->tail;
+		if (!root->tail.l) root->head.l = NULL;
+		break;
+	
+	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+		root->current = root->head;
+		while(root->current.t->right) root->current.t = root->current.t->right;
+		
+		data = _data(root, root->current.t);
+		_tree_remove(root, root->current.t);
+		
+		// set current
+		root->current = root->head;
+		if (root->current.t) // may have been the last node
+			while (root->current.t->right)
+				root->current.t = root->current.t->right;
+		return data;
+	
+	case DS_unrolled:
+		return _ulist_remove(root, root->tail.u, root->tail.u->count-1);
+	
+	case DS_array:
+		data = _aelem(root, root->count-1);
+		if (!--root->count) root->current.a = NULL;
+		else _array_seek(root, root->count-1);
+		return data;
+	
+	case DS_btree:
+		root->current.b = _btree_last(root);
+		root->index     = root->current.b->count-1;
+		data = memcpy(_scratch(root),
+			_bdata(root, root->current.b, root->index), root->data_size);
+		_btree_erase(root, root->current.b, (uint)root->index);
+		return data;
+	
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         :
+	case DS_circular_list: _error(_e_nsense ); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+	
+	
+	root->count--;
+	return data;
+}
+
+const void * DS_swap(DS root, const void * data){
+	_hent_pt scratch;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->type != DS_heap){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	if (root->current.e == NULL) return NULL;
+	
+	// a keyed heap needs an entry past the bottom for the old payload
+	if (root->key_size && root->count == root->table_size
+		&& _heap_resize(root, root->table_size<<1) == r_failure)
+		return NULL;
+	
+	// save the top in the scratch entry
+	scratch = _hent_at(root, root->table_size);
+	memcpy(scratch, root->head.e, _hent_sz(root));
+	
+	// sift the new data down from the top
+	_hent_tmp(root)->serial = root->serial++;
+	if (!_heap_put(root, _hent_tmp(root), data)) return NULL;
+	_sift_down(root->head.e, 0, root->count-1, _hent_sz(root), root->leaf_cap,
+		_heap_cmp_for(root), root, _hent_tmp(root));
+	
+	if (root->key_size)
+		memcpy(_hent_at(root, root->count)->data, scratch->data, sizeof(void*));
+	
+	return _edata(root, scratch);
+}
+
+return_t DS_heap_update(DS root, void * handle){
+	_tnode_pt node, child;
+	
+	if (!root || !handle){
+		_error(_e_null);
+		return r_failure;
+	}
+	
+	if (root->type != DS_pairing){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	node = _pair_node(root, handle);
+	for(child = node->left; child; child = child->right)
+		if(_pair_before(root, child, node)) break;
+	
+	// still ahead of its children, so the whole subtree can move up
+	if(!child){
+		if(node == root->head.t) return r_success;
+		_pair_cut(node);
+	}
+	else _pair_unlink(root, node);
+	
+	root->head.t  = _pair_meld(root, root->head.t, node);
+	root->current = root->head;
+	
+	return r_success;
+}
+
+const void * DS_heap_remove(DS root, void * handle){
+	if (!root || !handle){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->type != DS_pairing){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	return _pair_remove(root, _pair_node(root, handle));
+}
+
+/********************** VIEW RECORD IN DATA STRUCTURE *************************/
+
+void * DS_find(const DS root, const void * key){
+	_tnode_pt node, last;
+	_bnode_pt leaf;
+	_hslot_pt slot;
+	uint pos;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
+	case DS_bst:
+	case DS_avl:
+	case DS_splay: break;
+	case DS_hash:
+		if(!( slot = _hash_lookup(root, root->keys.hash(key)) )) return NULL;
+		root->current.h = slot;
+		root->index     = 0;
+		return slot->data;
+	
+	case DS_btree:
+		leaf = _btree_descend(root, key, false);
+		pos  = _btree_bound(root, leaf, key, false);
+		
+		// the first match may start the next leaf
+		if(pos == leaf->count){
+			if(!( leaf = leaf->next )) return NULL;
+			pos = 0;
+		}
+		if(root->cmp_keys(key, _bkey(root, leaf, pos))) return NULL;
+		
+		root->current.b = leaf;
+		root->index     = pos;
+		return _bdata(root, leaf, pos);
+	
+	case DS_heap         :
+	case DS_list         :
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_circular_list: _error(_e_nsense); return NULL;
+	default: _error(_e_invtype); return NULL;
+	}
+	
+	if (( node = _tree_search(root, key, &last) )){
+		root->current.t = node;
+		if (root->type == DS_splay) _splay(root, node);
+		return _data(root, node);
+	}
+	
+	// a splay tree splays the last node visited even on a miss
+	if (root->type == DS_splay) _splay(root, last);
+	
+	return NULL;
+}
+
+
+// VISITING
+void * DS_first(const DS root){ // visit the first node
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
+	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+		root->current.t = _tree_min(root->head.t);
+		return _data(root, root->current.t);
+	
+	case DS_btree:
+		root->current.b = _btree_first(root);
+		root->index     = 0;
+		return _bdata(root, root->current.b, 0);
+	
+	case DS_unrolled: return _ulist_seek(root, root->head.u, 0);
+	case DS_array   : return _array_seek(root, 0);
+	
+	case DS_list:
+		root->current=root->head;
+		return _data(root, root->current.l);
+	
+	case DS_heap: // the top of the heap
+		root->current=root->head;
+		return _edata(root, root->current.e);
+	
+	case DS_pairing:
+		root->current=root->head;
+		return _data(root, root->current.t);
+	
+	case DS_radix: return _radix_front(root);
+	
+	case DS_hash: // table order
+		root->current.h = _hash_scan(root, 0);
+		root->index     = 0;
+		return root->current.h->data;
+	
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_mpmc         :
+	case DS_circular_list: _error(_e_nsense ); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+}
+
+void * DS_last(const DS root){ // visit the last node
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
+	case DS_bst:
+	case DS_avl:
+	case DS_splay:
+		root->current.t = _tree_max(root->head.t);
+		return _data(root, root->current.t);
+	
+	case DS_btree:
+		root->current.b = _btree_last(root);
+		root->index     = root->current.b->count-1;
+		return _bdata(root, root->current.b, root->index);
+	
+	case DS_unrolled:
+		return _ulist_seek(root, root->tail.u, root->tail.u->count-1);
+	case DS_array: return _array_seek(root, root->count-1);
+	
+	case DS_list:
+		root->current=root->tail;
+		return _data(root, root->current.l);
+	
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         :
+	case DS_circular_list: _error(_e_nsense ); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+}
+
+void * DS_next(const DS root){ // visit the next in-order node
+	_tnode_pt node;
+	_hslot_pt slot;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
 	
 	switch (root->type){
+	case DS_bst: // this is an in-order traversal
+	case DS_avl:
+	case DS_splay:
+		// at the last node current stays where it is
+		if (!( node = _tree_next(root->current.t) )) return NULL;
+		root->current.t = node;
+		return _data(root, node);
+	
 	case DS_list:
 	case DS_circular_list:
-		while (root->freelist.l) {
-		dead_node = root->freelist;
-		root->freelist.l = root->freelist.l->prev;
-		free(dead_node.l);
+		root->current.l=root->current.l->next;
+		if(!root->current.l) {
+			root->current=root->tail;
+			return NULL;
 		}
-		return;
+		else return _data(root, root->current.l);
 	
-	case DS_heap:
+	case DS_btree: // follow the leaf links
+		if (root->index+1 < root->current.b->count) root->index++;
+		else if (root->current.b->next){
+			root->current.b = root->current.b->next;
+			root->index     = 0;
+		}
+		else return NULL; // leave current at the last entry
+		return _bdata(root, root->current.b, root->index);
+	
+	case DS_unrolled:
+		if (root->index+1 < root->current.u->count)
+			return _ulist_seek(root, root->current.u, root->index+1);
+		if (!root->current.u->next) return NULL; // leave current at the last
+		return _ulist_seek(root, root->current.u->next, 0);
+	
+	case DS_array:
+		if (root->index+1 == root->count) return NULL;
+		return _array_seek(root, root->index+1);
+	
+	case DS_hash:
+		slot = _hash_scan(root, _hslot_idx(root, root->current.h)+1);
+		if(!slot || _hash_wrapped(root, slot))
+			return NULL; // leave current at the last entry
+		root->current.h = slot;
+		return slot->data;
+	
+	case DS_sync:
+	case DS_pairing:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_radix:
+	case DS_mpmc:
+	case DS_heap: _error(_e_nsense); return NULL;
+	default     : _error(_e_invtype); return NULL;
+	}
+}
+
+void * DS_previous(const DS root){ // visit the previous in-order node
+	_tnode_pt node;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
 	case DS_bst:
-		while (root->freelist.t) {
-		dead_node = root->freelist;
-		root->freelist.t = root->freelist.t->left;
-		free(dead_node.t);
+	case DS_avl:
+	case DS_splay:
+		// at the first node current stays where it is
+		if (!( node = _tree_prev(root->current.t) )) return NULL;
+		root->current.t = node;
+		return _data(root, node);
+	
+	case DS_btree:
+		if (root->index) root->index--;
+		else if (root->current.b->prev){
+			root->current.b = root->current.b->prev;
+			root->index     = root->current.b->count-1;
 		}
-		return;
+		else return NULL; // leave current at the first entry
+		return _bdata(root, root->current.b, root->index);
+	
+	case DS_unrolled:
+		if (root->index) return _ulist_seek(root, root->current.u, root->index-1);
+		if (!root->current.u->prev) return NULL; // leave current at the first
+		return _ulist_seek(root,
+			root->current.u->prev, root->current.u->prev->count-1);
+	
+	case DS_array:
+		if (!root->index) return NULL;
+		return _array_seek(root, root->index-1);
+		
+	case DS_list:
+	case DS_circular_list:
+		root->current.l=root->current.l->prev;
+		if(!root->current.l){
+			root->current = root->tail;
+			return NULL;
+		}
+		else return _data(root, root->current.l);
+	
+	case DS_heap:
+	case DS_sync:
+	case DS_pairing:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_radix:
+	case DS_mpmc:
+	case DS_hash: _error(_e_nsense); return NULL;
+	default     : _error(_e_invtype); return NULL;
+	}
+}
+
+void * DS_current (DS root){ // visit the current node
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_pairing      : return _data(root, root->current.t);
+	case DS_btree        : return _bdata(root, root->current.b, root->index);
+	case DS_unrolled     : return _uelem(root, root->current.u, root->index);
+	case DS_array        : return root->current.a;
+	case DS_hash         :
+		return _hash_current(root)? root->current.h->data : NULL;
+	case DS_list         :
+	case DS_circular_list: return _data(root, root->current.l);
+	case DS_heap         : return _edata(root, root->current.e);
+	case DS_radix        : return _radix_front(root);
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_mpmc         : _error(_e_nsense); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+}
+
+// set the current position to a specific count from the beginning
+void * DS_position(const DS root, const unsigned int position){
+	_ublock_pt block;
+	_tnode_pt  node;
+	size_t     idx;
+	
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->current.l == NULL) return NULL;
+	
+	switch (root->type){
+	case DS_list         : break;
+	case DS_unrolled     : // skip whole blocks
+		if (!position || position > root->count) return NULL;
+		for(block = root->head.u, idx = position-1; idx >= block->count;
+			block = block->next)
+			idx -= block->count;
+		return _ulist_seek(root, block, idx);
+	
+	case DS_array        : // positions count from one
+		if (!position || position > root->count) return NULL;
+		return _array_seek(root, position-1);
+	
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        : // descend by subtree sizes
+		if (!position || position > root->count) return NULL;
+		node = _tree_select(root->head.t, position-1);
+		root->current.t = node;
+		if (root->type == DS_splay) _splay(root, node);
+		return _data(root, node);
+	
+	case DS_btree        :
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         :
+	case DS_circular_list: _error(_e_nsense); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
+	
+	root->current=root->head;
+	for (uint i=1; i != position; i++) root->current.l = root->current.l->next;
+	
+	return _data(root, root->current.l);
+}
+
+uint DS_rank(const DS root, const void * key){
+	_tnode_pt node, last = NULL;
+	uint      rank = 0;
+	uint64_t  prefix;
+	
+	if (!root){
+		_error(_e_null);
+		return 0;
+	}
+	
+	switch (root->type){
+	case DS_bst  :
+	case DS_avl  :
+	case DS_splay: break;
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_btree        :
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	case DS_hash         : _error(_e_nsense); return 0;
+	default              : _error(_e_invtype); return 0;
+	}
+	
+	// count everything to the left of the path to the first key not less
+	prefix = _tree_prefix(root, key);
+	node   = root->head.t;
+	while (node != NULL){
+		last = node;
+		if (_tree_cmp(root, key, prefix, node) > 0){
+			rank += (uint)_size(node->left)+1;
+			node  = node->right;
+		}
+		else node = node->left;
+	}
+	
+	if (root->type == DS_splay && last) _splay(root, last);
+	
+	return rank;
+}
+
+void * DS_tree_top(const DS root){
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if ((root->type != DS_bst && root->type != DS_avl && root->type != DS_splay)
+		|| !root->intrusive){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	return root->head.t? _data(root, root->head.t) : NULL;
+}
+
+void * DS_buffer(const DS root){
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->type != DS_array){
+		_error(_e_nsense);
+		return NULL;
+	}
+	
+	return root->count? root->head.a : NULL;
+}
+
+/***************************** CONCURRENT QUEUES ******************************/
+
+bool DS_try_nq(DS root, const void * data){
+	_qcell_pt cell;
+	size_t    ticket, seq;
+	
+	if (!root){
+		_error(_e_null);
+		return false;
+	}
+	
+	if (root->type == DS_spsc)
+		return _ring_put(root, (const int8_t*)data, 1) == 1;
+	if (root->type != DS_mpmc){
+		_error(_e_nsense);
+		return false;
+	}
+	
+	ticket = atomic_load_explicit(&root->head.q->enq, memory_order_relaxed);
+	for(;;){
+		cell = _qcell_at(root, ticket);
+		seq  = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		
+		if (seq == ticket){ // the cell is free, claim the ticket
+			if (atomic_compare_exchange_weak_explicit(&root->head.q->enq,
+				&ticket, ticket+1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		else if ((imax)(seq - ticket) < 0) return false; // full
+		else ticket =
+			atomic_load_explicit(&root->head.q->enq, memory_order_relaxed);
+	}
+	
+	memcpy(cell->data, data, root->data_size);
+	atomic_store_explicit(&cell->seq, ticket+1, memory_order_release);
+	return true;
+}
+
+bool DS_try_dq(DS root, void * data){
+	_qcell_pt cell;
+	size_t    ticket, seq;
+	
+	if (!root){
+		_error(_e_null);
+		return false;
+	}
+	
+	if (root->type == DS_spsc)
+		return _ring_get(root, (int8_t*)data, 1) == 1;
+	if (root->type != DS_mpmc){
+		_error(_e_nsense);
+		return false;
+	}
+	
+	ticket = atomic_load_explicit(&root->head.q->deq, memory_order_relaxed);
+	for(;;){
+		cell = _qcell_at(root, ticket);
+		seq  = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		
+		if (seq == ticket+1){ // the cell is full, claim the ticket
+			if (atomic_compare_exchange_weak_explicit(&root->head.q->deq,
+				&ticket, ticket+1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		else if ((imax)(seq - (ticket+1)) < 0) return false; // empty
+		else ticket =
+			atomic_load_explicit(&root->head.q->deq, memory_order_relaxed);
+	}
+	
+	memcpy(data, cell->data, root->data_size);
+	atomic_store_explicit(&cell->seq, ticket + root->table_size,
+		memory_order_release);
+	return true;
+}
+
+size_t DS_nq_batch(DS root, const void * data, size_t count){
+	size_t done = 0;
+	
+	if (!root){
+		_error(_e_null);
+		return 0;
+	}
+	
+	switch (root->type){
+	case DS_spsc: return _ring_put(root, (const int8_t*)data, count);
+	case DS_mpmc: // entries from other producers may be interleaved
+		while(done < count && DS_try_nq(root,
+			(const int8_t*)data + done*root->data_size))
+			done++;
+		return done;
+	
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_btree        :
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_radix        :
+	case DS_wsdeque      :
+	case DS_hash         : _error(_e_nsense); return 0;
+	default              : _error(_e_invtype); return 0;
+	}
+}
+
+size_t DS_dq_batch(DS root, void * data, size_t count){
+	size_t done = 0;
+	
+	if (!root){
+		_error(_e_null);
+		return 0;
+	}
+	
+	switch (root->type){
+	case DS_spsc: return _ring_get(root, (int8_t*)data, count);
+	case DS_mpmc:
+		while(done < count && DS_try_dq(root,
+			(int8_t*)data + done*root->data_size))
+			done++;
+		return done;
+	
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_btree        :
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_radix        :
+	case DS_wsdeque      :
+	case DS_hash         : _error(_e_nsense); return 0;
+	default              : _error(_e_invtype); return 0;
+	}
+}
+
+/**************************** WORK STEALING DEQUES ****************************/
+
+bool DS_push_bottom(DS root, const void * data){
+	_darray_pt array;
+	imax       top, bottom;
+	
+	if (!root){
+		_error(_e_null);
+		return false;
+	}
+	
+	if (root->type != DS_wsdeque){
+		_error(_e_nsense);
+		return false;
+	}
+	
+	bottom = atomic_load_explicit(&root->head.d->bottom, memory_order_relaxed);
+	top    = atomic_load_explicit(&root->head.d->top   , memory_order_acquire);
+	array  = atomic_load_explicit(&root->head.d->array , memory_order_relaxed);
+	
+	if (!array || (size_t)(bottom-top) >= array->size){
+		if(!( array = _deque_grow(root, array, top, bottom) )) return false;
+	}
+	
+	_relaxed_copy(_delem(root, array, bottom), data, root->data_size);
+	atomic_store_explicit(&root->head.d->bottom, bottom+1, memory_order_release);
+	return true;
+}
+
+bool DS_pop_bottom(DS root, void * data){
+	_darray_pt array;
+	imax       top, bottom;
+	bool       found = true;
+	
+	if (!root){
+		_error(_e_null);
+		return false;
+	}
+	
+	if (root->type != DS_wsdeque){
+		_error(_e_nsense);
+		return false;
+	}
 	
-	case DS_hash: _error(_e_nimp); return;
+	// claim the bottom entry before looking at what the thieves have taken
+	bottom = atomic_load_explicit(&root->head.d->bottom, memory_order_relaxed)-1;
+	array  = atomic_load_explicit(&root->head.d->array , memory_order_relaxed);
+	atomic_store_explicit(&root->head.d->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	top = atomic_load_explicit(&root->head.d->top, memory_order_relaxed);
 	
-	default: _error(_e_invtype); return;
+	if (top > bottom){ // it was already empty
+		atomic_store_explicit(&root->head.d->bottom, bottom+1,
+			memory_order_relaxed);
+		return false;
+	}
+	
+	memcpy(data, _delem(root, array, bottom), root->data_size);
+	
+	if (top == bottom){ // the last entry, race the thieves for it
+		found = atomic_compare_exchange_strong_explicit(&root->head.d->top,
+			&top, top+1, memory_order_seq_cst, memory_order_relaxed);
+		atomic_store_explicit(&root->head.d->bottom, bottom+1,
+			memory_order_relaxed);
 	}
+	
+	return found;
 }
 
+bool DS_steal(DS root, void * data){
+	_darray_pt array;
+	imax       top, bottom;
+	
+	if (!root){
+		_error(_e_null);
+		return false;
+	}
+	
+	if (root->type != DS_wsdeque){
+		_error(_e_nsense);
+		return false;
+	}
+	
+	for(;;){
+		top = atomic_load_explicit(&root->head.d->top, memory_order_acquire);
+		atomic_thread_fence(memory_order_seq_cst);
+		bottom =
+			atomic_load_explicit(&root->head.d->bottom, memory_order_acquire);
+		if (top >= bottom) return false;
+		
+		// the copy is only ours if the CAS succeeds
+		array = atomic_load_explicit(&root->head.d->array, memory_order_acquire);
+		_relaxed_copy(data, _delem(root, array, top), root->data_size);
+		
+		if (atomic_compare_exchange_strong_explicit(&root->head.d->top,
+			&top, top+1, memory_order_seq_cst, memory_order_relaxed))
+			return true;
+	}
+}
 
+/**************************** CONCURRENT HASH MAPS ****************************/
 
-// Simple tests
-inline uint DS_count(const DS root) {
+bool DS_sync_find(const DS root, const void * key, void * data){
+	uint64_t hash;
+	
 	if (!root){
 		_error(_e_null);
-		return 0;
+		return false;
 	}
-	return root->count;
+	
+	if (root->type != DS_sync){
+		_error(_e_nsense);
+		return false;
+	}
+	
+	hash = root->keys.hash(key);
+	return _shard_read(_shard_of(root, hash), hash, data);
 }
 
-inline bool DS_isempty (const DS root) {
+bool DS_sync_insert(DS root, const void * data){
+	_shard_pt shard;
+	_hslot_pt slot;
+	uint64_t  hash;
+	bool      done = true;
+	
 	if (!root){
 		_error(_e_null);
-		return true;
+		return false;
 	}
-	return !root->count;
+	
+	if (root->type != DS_sync){
+		_error(_e_nsense);
+		return false;
+	}
+	
+	hash  = root->keys.hash(data);
+	shard = _shard_of(root, hash);
+	
+	_shard_lock(shard);
+	if(( slot = _hash_lookup(&shard->table, hash) )) // replace the entry
+		_relaxed_copy(slot->data, data, root->data_size);
+	else done = DS_insert(&shard->table, data) != NULL;
+	_shard_unlock(shard);
+	
+	return done;
 }
 
-bool DS_isleaf (const DS root){
+bool DS_sync_remove(DS root, const void * key, void * data){
+	_shard_pt    shard;
+	const void * removed = NULL;
+	uint64_t     hash;
+	
 	if (!root){
 		_error(_e_null);
 		return false;
 	}
-
-	switch (root->type){
-	case DS_bst          : break;
-	case DS_heap         :
-	case DS_hash         :
-	case DS_list         :
-	case DS_circular_list: _error(_e_nsense); return false;
-	default: _error(_e_invtype); return false;
+	
+	if (root->type != DS_sync){
+		_error(_e_nsense);
+		return false;
 	}
 	
-	return (!( root->current.t->left || root->current.t->right ));
+	hash  = root->keys.hash(key);
+	shard = _shard_of(root, hash);
+	
+	_shard_lock(shard);
+	if(( shard->table.current.h = _hash_lookup(&shard->table, hash) )){
+		shard->table.index = 0;
+		removed = DS_remove(&shard->table);
+		if(data) memcpy(data, removed, root->data_size);
+	}
+	_shard_unlock(shard);
+	
+	return removed != NULL;
 }
 
-// Dump the contents of the data structure
-void DS_dump (const DS root){
-	_node_pt this_node;
+/******************************** RADIX HEAPS *********************************/
+
+void * DS_radix_push(DS root, uint64_t key, const void * data){
+	_radix_pt   radix;
+	_rbucket_pt bucket;
+	int8_t    * entry;
 	
-	if (!root){
+	if (!root || (!data && root->data_size)){
 		_error(_e_null);
-		return;
+		return NULL;
 	}
 	
-	this_node = root->head;
+	if (root->type != DS_radix || key < root->head.x->last){
+		_error(_e_nsense);
+		return NULL;
+	}
 	
-	switch (root->type){
-	case DS_list:
-		while(this_node.l != NULL) {
-			printf("%s\n", (char*) this_node.l->data);
-			this_node.l = this_node.l->next;
-		}
-		break;
+	radix  = root->head.x;
+	bucket = radix->bucket + _radix_index(radix->last, key);
 	
-	case DS_circular_list:
-		if (this_node.l == NULL) break;
-		do {
-			printf("%s\n", (char*) this_node.l->data);
-			this_node.l = this_node.l->next;
-		} while (this_node.l != root->head.l);
-		break;
+	if (bucket->start && bucket->start == bucket->count)
+		bucket->start = bucket->count = 0;
+	if (_radix_reserve(root, bucket, 1)) return NULL;
 	
-	case DS_heap:
-	case DS_bst :
-		if (this_node.t == NULL) break;
-		_print_node(root->head.t, 0);
-		break;
+	entry = _rent_at(root, bucket, bucket->count++);
+	_rent_key(entry) = key;
+	if (root->data_size) memcpy(_rent_data(entry), data, root->data_size);
 	
-	case DS_hash: _error(_e_nimp); return;
+	root->count++;
+	root->current = root->head;
+	return _rent_data(entry);
+}
+
+const void * DS_radix_pop(DS root, uint64_t * key){
+	_rbucket_pt bucket;
+	int8_t    * entry;
 	
-	default:
-		_error(_e_invtype);
+	if (!root){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (root->type != DS_radix){
+		_error(_e_nsense);
+		return NULL;
 	}
+	
+	if (!root->count || !_radix_front(root)) return NULL;
+	
+	bucket = root->head.x->bucket;
+	entry  = _rent_at(root, bucket, bucket->start++);
+	if (key) *key = _rent_key(entry);
+	
+	if (!--root->count) root->current.x = NULL;
+	return _rent_data(entry);
 }
 
-/**************************** ADD TO DATA STRUCTURE ***************************/
+/********************************** CURSORS ***********************************/
 
-void * DS_insert (DS root, const void * data){
-	_node_pt    new_node;
-	_tnode_pt * position;
-	imax        result;
+// the data at a placed cursor
+static void * __attribute__((pure)) _cursor_data(const DS_cursor cursor){
+	const DS root = cursor->root;
+	
+	switch (root->type){
+	case DS_list         :
+	case DS_circular_list: return _data(root, cursor->node.l);
+	case DS_unrolled     : return _uelem(root, cursor->node.u, cursor->index);
+	case DS_array        : return cursor->node.a;
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_pairing      : return _data(root, cursor->node.t);
+	case DS_btree        : return _bdata(root, cursor->node.b, cursor->index);
+	case DS_heap         : return _edata(root, cursor->node.e);
+	case DS_hash         : return cursor->node.h->data;
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         :
+	default              : return NULL;
+	}
+}
+
+DS_cursor DS_cursor_new(const DS root){
+	DS_cursor cursor;
 	
 	if (!root){
 		_error(_e_null);
 		return NULL;
 	}
 	
-	switch (root->type){
-	case DS_list:
-		if (root->current.l == root->head.l)
-			return DS_insert_first(root, data);
-		else if (root->current.l == root->tail.l)
-			return DS_insert_last (root, data);
-		
-		new_node = _new_node(root);
-		if (new_node.l == NULL) return NULL;
-		
-		if (root->head.l == NULL){
-			root->head = new_node;
-			root->tail = new_node;
-		}
-		else {
-			new_node.l->next=root->current.l;
-			new_node.l->prev=root->current.l->prev;
-			root->current.l->prev->next = new_node.l;
-			root->current.l->prev       = new_node.l;
-		}
-		
-		root->current=new_node;
-		root->count++;
-		
-		memcpy(new_node.l->data, data, root->data_size);
-		return new_node.l->data;
+	if (root->type == DS_wsdeque || root->type == DS_spsc
+		|| root->type == DS_mpmc || root->type == DS_sync){
+		_error(_e_nsense);
+		return NULL;
+	}
 	
+	cursor = (DS_cursor) malloc(sizeof(struct _cursor));
+	if (cursor == NULL) {
+		_error(_e_mem);
+		return NULL;
+	}
 	
-	case DS_circular_list:
-		new_node = _new_node(root);
-		if (new_node.l == NULL) return NULL;
-		
-		if (root->head.l == NULL){
-			root->head = new_node;
-			new_node.l->next = new_node.l;
-			new_node.l->prev = new_node.l;
-		}
-		else {
-			new_node.l->next=root->current.l;
-			new_node.l->prev=root->current.l->prev;
-			root->current.l->prev->next = new_node.l;
-			root->current.l->prev       = new_node.l;
-		}
-		
-		root->current=new_node;
-		root->count++;
-		
-		memcpy(new_node.l->data, data, root->data_size);
-		return new_node.l->data;
+	cursor->root   = root;
+	cursor->node.l = NULL;
+	cursor->index  = 0;
 	
+	return cursor;
+}
+
+void DS_cursor_delete(DS_cursor cursor){
+	free(cursor);
+}
+
+void * DS_cursor_first(DS_cursor cursor){
+	DS root;
 	
-	case DS_bst:
-		// Find the position
-		position = &(root->head.t);
-		while (*position){
-			root->current.t = *position;
-			result=root->cmp_keys(
-				root->keys.key(data),
-				root->keys.key(root->current.t->data)
-			);
-			if      (result <0) position = &(root->current.t->left);
-			else if (result >0) position = &(root->current.t->right);
-			else { // result is 0
-				if(root->dups) position = &(root->current.t->right);
-				else {
-					//_error(_e_repeat);
-					return NULL;
-				}
-			}
-		}
-		
-		// position now points to a null _tnode_pt where the new node will go
-		
-		// allocate the node
-		new_node = _new_node(root);
-		if (new_node.t == NULL) return NULL;
-		
-		// insert the node
-		new_node.t->parent = root->current.t;
-		*position = new_node.t;
-		root->current=new_node;
-		root->count++;
-		
-		// copy data and return it
-		memcpy(new_node.t->data, data, root->data_size);
-		return new_node.t->data;
+	if (!cursor){
+		_error(_e_null);
+		return NULL;
+	}
 	
-	case DS_heap:
-		// allocate the node
-		new_node = _new_node(root);
-		if (new_node.t == NULL) return NULL;
-		
-		// insert node and set root->current
-		
-		// relocate root->tail
-		
-		// copy data
-		
-		// relocate root->current
-		
-		// the next position is one of the children of root->tail
-		//if(!root->tail)
-		
-		
-		
-	case DS_hash: _error(_e_nimp); return NULL;
+	root = cursor->root;
+	if (!root->count) return NULL;
+	cursor->node.l = NULL;
+	cursor->index  = 0;
 	
-	default: _error(_e_invtype); return NULL;
+	switch (root->type){
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_heap         :
+	case DS_pairing      : cursor->node = root->head; break;
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        : cursor->node.t = _tree_min(root->head.t); break;
+	case DS_btree        : cursor->node.b = _btree_first(root); break;
+	case DS_hash         : cursor->node.h = _hash_scan(root, 0); break;
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return NULL;
+	default              : _error(_e_invtype); return NULL;
 	}
+	
+	return _cursor_data(cursor);
 }
 
-void * DS_insert_first(DS root, const void * data){
-	_node_pt new_node;
+void * DS_cursor_last(DS_cursor cursor){
+	DS root;
 	
-	if (!root){
+	if (!cursor){
 		_error(_e_null);
 		return NULL;
 	}
 	
+	root = cursor->root;
+	if (!root->count) return NULL;
+	cursor->node.l = NULL;
+	
 	switch (root->type){
-	case DS_list         : break;
-	case DS_hash         :
-	case DS_circular_list:
+	case DS_list         :
+	case DS_circular_list: cursor->node = root->tail; break;
+	case DS_unrolled     :
+		cursor->node  = root->tail;
+		cursor->index = root->tail.u->count-1;
+		break;
+	case DS_array        :
+		cursor->index  = root->count-1;
+		cursor->node.a = _aelem(root, cursor->index);
+		break;
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        : cursor->node.t = _tree_max(root->head.t); break;
+	case DS_btree        :
+		cursor->node.b = _btree_last(root);
+		cursor->index  = cursor->node.b->count-1;
+		break;
+	
 	case DS_heap         :
-	case DS_bst          : _error(_e_nsense ); return NULL;
+	case DS_hash         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return NULL;
 	default              : _error(_e_invtype); return NULL;
 	}
 	
-	// allocate the node
-	new_node = _new_node(root);
-	if (new_node.l == NULL) return NULL;
+	return _cursor_data(cursor);
+}
+
+void * DS_cursor_next(DS_cursor cursor){
+	DS       root;
+	_node_pt next;
+	
+	if (!cursor){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	// at the end the cursor stays at the last entry
+	root = cursor->root;
+	if (!cursor->node.l) return NULL;
+	
+	switch (root->type){
+	case DS_list         :
+	case DS_circular_list:
+		if (!cursor->node.l->next) return NULL;
+		cursor->node.l = cursor->node.l->next;
+		break;
+	
+	case DS_unrolled     :
+		if (cursor->index+1 < cursor->node.u->count) cursor->index++;
+		else if (cursor->node.u->next){
+			cursor->node.u = cursor->node.u->next;
+			cursor->index  = 0;
+		}
+		else return NULL;
+		break;
+	
+	case DS_array        :
+		if (cursor->index+1 >= root->count) return NULL;
+		cursor->node.a = _aelem(root, ++cursor->index);
+		break;
+	
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+		if (!( next.t = _tree_next(cursor->node.t) )) return NULL;
+		cursor->node = next;
+		break;
+	
+	case DS_btree        :
+		if (cursor->index+1 < cursor->node.b->count) cursor->index++;
+		else if (cursor->node.b->next){
+			cursor->node.b = cursor->node.b->next;
+			cursor->index  = 0;
+		}
+		else return NULL;
+		break;
+	
+	case DS_hash         :
+		next.h = _hash_scan(root, _hslot_idx(root, cursor->node.h)+1);
+		if (!next.h) return NULL;
+		cursor->node = next;
+		break;
 	
-	// if the structure is empty
-	if (root->head.l == NULL) root->tail=new_node;
-	else{
-		new_node.l->next = root->head.l;
-		root->head.l->prev = new_node.l;
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return NULL;
+	default              : _error(_e_invtype); return NULL;
 	}
-	root->current=new_node;
-	root->head   =new_node;
-	root->count++;
 	
-	// assign data
-	memcpy(new_node.l->data, data, root->data_size);
-	
-	return new_node.l->data;
+	return _cursor_data(cursor);
 }
 
-void * DS_insert_last (DS root, const void * data){
-	_node_pt new_node;
+void * DS_cursor_previous(DS_cursor cursor){
+	DS       root;
+	_node_pt prev;
 	
-	if (!root){
+	if (!cursor){
 		_error(_e_null);
 		return NULL;
 	}
 	
+	// at the beginning the cursor stays at the first entry
+	root = cursor->root;
+	if (!cursor->node.l) return NULL;
+	
 	switch (root->type){
-	case DS_list         : break;
-	case DS_hash         :
+	case DS_list         :
 	case DS_circular_list:
-	case DS_heap         :
-	case DS_bst          : _error(_e_nsense ); return NULL;
-	default              : _error(_e_invtype); return NULL;
-	}
+		if (!cursor->node.l->prev) return NULL;
+		cursor->node.l = cursor->node.l->prev;
+		break;
 	
-	// allocate the node
-	new_node = _new_node(root);
-	if (new_node.l == NULL) return NULL;
+	case DS_unrolled     :
+		if (cursor->index) cursor->index--;
+		else if (cursor->node.u->prev){
+			cursor->node.u = cursor->node.u->prev;
+			cursor->index  = cursor->node.u->count-1;
+		}
+		else return NULL;
+		break;
 	
-	// if the structure is empty
-	if (root->head.l == NULL) root->head=new_node;
-	else{
-		new_node.l->prev = root->tail.l;
-		root->tail.l->next = new_node.l;
-	}
+	case DS_array        :
+		if (!cursor->index) return NULL;
+		cursor->node.a = _aelem(root, --cursor->index);
+		break;
 	
-	root->current=new_node;
-	root->tail   =new_node;
-	root->count++;
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+		if (!( prev.t = _tree_prev(cursor->node.t) )) return NULL;
+		cursor->node = prev;
+		break;
+	
+	case DS_btree        :
+		if (cursor->index) cursor->index--;
+		else if (cursor->node.b->prev){
+			cursor->node.b = cursor->node.b->prev;
+			cursor->index  = cursor->node.b->count-1;
+		}
+		else return NULL;
+		break;
 	
-	// assign data
-	memcpy(new_node.l->data, data, root->data_size);
+	case DS_heap         :
+	case DS_hash         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return NULL;
+	default              : _error(_e_invtype); return NULL;
+	}
 	
-	return new_node.l->data;
+	return _cursor_data(cursor);
 }
 
-/*********************** REMOVE FROM DATA STRUCTURE ***************************/
+void * DS_cursor_current(DS_cursor cursor){
+	if (!cursor){
+		_error(_e_null);
+		return NULL;
+	}
+	
+	if (!cursor->node.l) return NULL;
+	return _cursor_data(cursor);
+}
 
-const void * DS_remove(DS root){
-	const void * data;
-	_tnode_pt swapnode=NULL;
-	_tnode_pt * parent_pt;
+void * DS_cursor_find(DS_cursor cursor, const void * key){
+	DS        root;
+	_tnode_pt node, last;
+	_hslot_pt slot;
+	_bnode_pt leaf;
+	uint      pos;
 	
-	if (!root){
+	if (!cursor){
 		_error(_e_null);
 		return NULL;
 	}
 	
-	if (root->current.l == NULL) return NULL;
-	
-	//data = root->current.l->data;
+	root = cursor->root;
+	if (!root->count) return NULL;
 	
 	switch (root->type){
-	case DS_bst:
-		// save the data
-		data = root->current.t->data;
-		
-		// get the parent's pointer pointer
-		if(!root->current.t->parent) parent_pt = &root->head.t;
-		else if(root->current.t->parent->left == root->current.t)
-			parent_pt = &root->current.t->parent->left;
-		else parent_pt = &root->current.t->parent->right;
-		
-		
-		// No Right Child
-		if(!root->current.t->right){
-			*parent_pt = root->current.t->left;
-			if(*parent_pt) (*parent_pt)->parent = root->current.t->parent;
-		}
-		// Only Right Child
-		else if(!root->current.t->left){
-			*parent_pt = root->current.t->right;
-			(*parent_pt)->parent = root->current.t->parent;
-		}
-		else{ //Two Children
-			swapnode = _remove_least_in_tree(&root->current.t->right);
-			
-			// set the swapnode
-			swapnode->left  = root->current.t->left;
-			swapnode->right = root->current.t->right;
-			swapnode->parent = root->current.t->parent;
-			
-			// insert the swapnode
-			*parent_pt = swapnode;
-			if(swapnode->right) swapnode->right->parent = swapnode;
-			swapnode->left->parent = swapnode;
-		}
-		
-		// return current to freelist
-		root->current.t->left = root->freelist.t;
-		root->freelist = root->current;
-		
-		// Reset current to the head
-		root->current = root->head;
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        : // a cursor never splays
+		if (!( node = _tree_search(root, key, &last) )) return NULL;
+		cursor->node.t = node;
 		break;
-		
-	case DS_list:
-		// save the data
-		data = root->current.l->data;
-		
-		// Check if we are at the beginning or end
-		if (root->current.l == root->head.l)
-			return DS_remove_first(root);
-		else if (root->current.l == root->tail.l)
-			return DS_remove_last (root);
 	
-	case DS_circular_list:
-		// save the data
-		data = root->current.l->data;
+	case DS_btree        :
+		leaf = _btree_descend(root, key, false);
+		pos  = _btree_bound(root, leaf, key, false);
 		
-		if (root->current.l->next == root->current.l){
-			// last node in a circular list
-			root->head.l = NULL;
-		}
-		else{
-			// Close the gap
-			root->current.l->prev->next = root->current.l->next;
-			root->current.l->next->prev = root->current.l->prev;
+		if (pos == leaf->count){
+			if (!( leaf = leaf->next )) return NULL;
+			pos = 0;
 		}
+		if (root->cmp_keys(key, _bkey(root, leaf, pos))) return NULL;
 		
-		// move to freelist
-		root->current.l->prev = root->freelist.l;
-		root->freelist = root->current;
-		
-		root->current.l = root->current.l->next;
+		cursor->node.b = leaf;
+		cursor->index  = pos;
 		break;
 	
-	case DS_heap:
-	case DS_hash: _error(_e_nimp); return NULL;
-	
-	default: _error(_e_invtype); return NULL;
-	}
+	case DS_hash         :
+		if (!( slot = _hash_lookup(root, root->keys.hash(key)) )) return NULL;
+		cursor->node.h = slot;
+		break;
 	
-	if (!root->head.l){
-		root->current.l = NULL;
-		root->tail.l    = NULL;
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_heap         :
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return NULL;
+	default              : _error(_e_invtype); return NULL;
 	}
 	
-	root->count--;
-	return data;
+	return _cursor_data(cursor);
 }
 
-
-const void * DS_remove_first(DS root){
-	const void * data;
-	_tnode_pt * parent_pt;
+void * DS_cursor_position(DS_cursor cursor, uint position){
+	DS     root;
+	size_t idx;
 	
-	if (!root){
+	if (!cursor){
 		_error(_e_null);
 		return NULL;
 	}
 	
-	if (root->current.l == NULL) return NULL;
+	root = cursor->root;
+	if (!position || position > root->count) return NULL;
+	idx = position-1;
 	
 	switch (root->type){
-	case DS_list:
-		root->current = root->head;
-		data = root->current.l->data;
-		
-		// remove from structure
-		root->head.l = root->head.l->next;
-		if (root->head.l) root->head.l->prev = NULL;
-		
-		// move to freelist
-		root->current.l->prev = root->freelist.l;
-		root->freelist = root->current;
-		
-		// set current
-		root->current = root->head;
-		if (!root->head.l) root->tail.l = NULL;
-		
+	case DS_list         :
+		for (cursor->node = root->head; idx; idx--)
+			cursor->node.l = cursor->node.l->next;
 		break;
 	
-	case DS_bst:
-		parent_pt = &root->head.t;
-		
-		while((*parent_pt)->left) parent_pt = &(*parent_pt)->left;
-		root->current.t = *parent_pt;
-		
-		data = root->current.t->data;
-		
-		// remove from tree
-		*parent_pt = root->current.t->right;
-		if (*parent_pt) (*parent_pt)->parent = root->current.t->parent;
-		
-		// move to freelist
-		root->current.t->left = root->freelist.t;
-		root->freelist = root->current;
-		
-		// set current to next in-order node
-		root->current = root->head;
-		if (root->current.t) // may have been the last node
-			while (root->current.t->left)
-				root->current.t = root->current.t->left;
-		
+	case DS_unrolled     : // skip whole blocks
+		for (cursor->node = root->head; idx >= cursor->node.u->count;
+			cursor->node.u = cursor->node.u->next)
+			idx -= cursor->node.u->count;
+		cursor->index = idx;
+		break;
+	
+	case DS_array        :
+		cursor->index  = idx;
+		cursor->node.a = _aelem(root, idx);
+		break;
+	
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+		cursor->node.t = _tree_select(root->head.t, idx);
 		break;
 	
+	case DS_circular_list:
+	case DS_btree        :
 	case DS_heap         :
 	case DS_hash         :
-	case DS_circular_list: _error(_e_nsense ); return NULL;
+	case DS_sync         :
+	case DS_pairing      :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return NULL;
 	default              : _error(_e_invtype); return NULL;
 	}
 	
-	root->count--;
-	return data;
+	return _cursor_data(cursor);
 }
 
 
-const void * DS_remove_last (DS root){
-	const void * data;
-	_tnode_pt * parent_pt;
+/********************************* SNAPSHOTS **********************************/
+
+return_t DS_save(const DS root, const char * path){
+	struct _snap_head head;
+	_node_pt          node;
+	FILE *            file;
+	bool              ok = true;
 	
-	if (!root){
+	if (!root || !path){
 		_error(_e_null);
-		return NULL;
+		return r_failure;
 	}
 	
-	if (root->current.l == NULL) return NULL;
+	switch (root->type){
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_btree        :
+	case DS_heap         :
+	case DS_pairing      :
+	case DS_hash         : break;
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return r_failure;
+	default              : _error(_e_invtype); return r_failure;
+	}
+	
+	// the records of an intrusive structure hold pointers
+	if (root->intrusive){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, _snap_magic, sizeof(head.magic));
+	head.version   = _SNAP_VERSION;
+	head.type      = (uint32_t)root->type;
+	head.data_size = root->data_size;
+	head.count     = root->count;
+	head.checksum  = _checksum(_SNAP_SEED, &head, sizeof(head));
+	
+	if (!( file = fopen(path, "wb") )){
+		_error(_e_file);
+		return r_failure;
+	}
 	
+	// the header is written again once the checksum is known
+	ok = fwrite(&head, sizeof(head), 1, file) == 1;
+	
+	node = root->head;
 	switch (root->type){
 	case DS_list:
-		root->current = root->tail;
-		data = root->current.l->data;
-		
-		// remove from structure
-		root->tail.l = root->tail.l->prev;
-		if (root->tail.l) root->tail.l->next = NULL;
-		
-		// move to freelist
-		root->current.l->prev = root->freelist.l;
-		root->freelist = root->current;
-		
-		// set current
-		root->current = root->tail;
-		if (!root->tail.l) root->head.l = NULL;
+		for(; ok && node.l; node.l = node.l->next)
+			ok = _snap_entry(file, root, node.l->data, &head.checksum);
 		break;
 	
-	case DS_bst:
-		parent_pt = &root->head.t;
-		
-		while((*parent_pt)->right) parent_pt = &(*parent_pt)->right;
-		root->current.t = *parent_pt;
-		
-		data = root->current.t->data;
-		
-		// remove from tree
-		*parent_pt = root->current.t->left;
-		if (*parent_pt) (*parent_pt)->parent = root->current.t->parent;
-		
-		// move to freelist
-		root->current.t->left = root->freelist.t;
-		root->freelist = root->current;
-		
-		// set current
-		root->current = root->head;
-		if (root->current.t) // may have been the last node
-			while (root->current.t->right)
-				root->current.t = root->current.t->right;
+	case DS_circular_list:
+		for(uint i=0; ok && i<root->count; i++, node.l = node.l->next)
+			ok = _snap_entry(file, root, node.l->data, &head.checksum);
+		break;
+	
+	case DS_unrolled:
+		for(; ok && node.u; node.u = node.u->next)
+			for(uint i=0; ok && i<node.u->count; i++)
+				ok = _snap_entry(file, root, _uelem(root, node.u, i),
+					&head.checksum);
+		break;
+	
+	case DS_array:
+		for(uint i=0; ok && i<root->count; i++)
+			ok = _snap_entry(file, root, _aelem(root, i), &head.checksum);
+		break;
+	
+	case DS_bst :
+	case DS_avl :
+	case DS_splay: // in order, ready for DS_bulk_load()
+		for(node.t = node.t? _tree_min(node.t) : NULL; ok && node.t;
+			node.t = _tree_next(node.t))
+			ok = _snap_entry(file, root, node.t->data, &head.checksum);
+		break;
+	
+	case DS_btree:
+		for(node.b = node.b? _btree_first(root) : NULL; ok && node.b;
+			node.b = node.b->next)
+			for(uint i=0; ok && i<node.b->count; i++)
+				ok = _snap_entry(file, root, _bdata(root, node.b, i),
+					&head.checksum);
 		break;
 	
+	case DS_heap: // array order, which is already a heap
+		for(uint i=0; ok && i<root->count; i++)
+			ok = _snap_entry(file, root, _edata(root, _hent_at(root, i)),
+				&head.checksum);
+		break;
+	
+	case DS_pairing: // preorder, the order of equal entries is not kept
+		for(; ok && node.t; node.t = _pair_next(node.t))
+			ok = _snap_entry(file, root, node.t->data, &head.checksum);
+		break;
+	
+	case DS_hash:
+		for(size_t i=0; ok && root->count && i<root->table_size; i++)
+			if((node.h = _hslot_at(root, i))->dist)
+				ok = _snap_entry(file, root, node.h->data, &head.checksum);
+		break;
+	
+	case DS_sync:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_radix:
+	case DS_mpmc:
+	default: break;
+	}
+	
+	if (ok) ok = !fseek(file, 0, SEEK_SET)
+		&& fwrite(&head, sizeof(head), 1, file) == 1;
+	if (fclose(file)) ok = false;
+	
+	if (!ok){
+		_error(_e_file);
+		return r_failure;
+	}
+	return r_success;
+}
+
+return_t DS_load(DS root, const char * path){
+	struct _snap_head head;
+	struct stat       info;
+	const int8_t *    map, * data;
+	size_t            count, size;
+	uint64_t          sum;
+	int               fd;
+	return_t          result = r_success;
+	
+	if (!root || !path){
+		_error(_e_null);
+		return r_failure;
+	}
+	
+	switch (root->type){
+	case DS_list         :
+	case DS_circular_list:
+	case DS_unrolled     :
+	case DS_array        :
+	case DS_bst          :
+	case DS_avl          :
+	case DS_splay        :
+	case DS_btree        :
 	case DS_heap         :
-	case DS_hash         :
-	case DS_circular_list: _error(_e_nsense ); return NULL;
-	default              : _error(_e_invtype); return NULL;
+	case DS_pairing      :
+	case DS_hash         : break;
+	case DS_sync         :
+	case DS_wsdeque      :
+	case DS_spsc         :
+	case DS_radix        :
+	case DS_mpmc         : _error(_e_nsense); return r_failure;
+	default              : _error(_e_invtype); return r_failure;
+	}
+	
+	if (root->count || root->intrusive){
+		_error(_e_nsense);
+		return r_failure;
+	}
+	
+	if ((fd = open(path, O_RDONLY)) < 0){
+		_error(_e_file);
+		return r_failure;
 	}
+	if (fstat(fd, &info) || (size_t)info.st_size < sizeof(head)){
+		close(fd);
+		_error(_e_snap);
+		return r_failure;
+	}
+	size = (size_t)info.st_size;
 	
+	map = (const int8_t*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED){
+		_error(_e_file);
+		return r_failure;
+	}
+	posix_madvise((void*)map, size, POSIX_MADV_SEQUENTIAL);
 	
-	root->count--;
-	return data;
+	// check everything before building anything
+	memcpy(&head, map, sizeof(head));
+	sum           = head.checksum;
+	head.checksum = 0;
+	head.checksum = _checksum(_SNAP_SEED, &head, sizeof(head));
+	
+	count = (size_t)head.count;
+	data  = map + sizeof(head);
+	if (memcmp(head.magic, _snap_magic, sizeof(head.magic))
+		|| head.version   != _SNAP_VERSION
+		|| head.type      != (uint32_t)root->type
+		|| head.data_size != root->data_size
+		|| head.count     >  UINT_MAX
+		|| (root->data_size? (size - sizeof(head))/root->data_size != count
+			|| (size - sizeof(head))%root->data_size : size != sizeof(head))
+	) result = r_failure;
+	
+	for(size_t i=0; result == r_success && i<count; i++)
+		head.checksum = _checksum(head.checksum,
+			data + i*root->data_size, root->data_size);
+	if (head.checksum != sum) result = r_failure;
+	
+	if (result == r_failure){
+		munmap((void*)map, size);
+		_error(_e_snap);
+		return r_failure;
+	}
+	
+	// then rebuild in one pass
+	switch (root->type){
+	case DS_bst  :
+	case DS_avl  :
+	case DS_splay:
+		result = DS_bulk_load(root, data, count);
+		break;
+	
+	case DS_array:
+		if (count) result = _snap_array(root, data, count);
+		break;
+	
+	case DS_list    :
+	case DS_unrolled:
+		for(size_t i=0; result == r_success && i<count; i++)
+			if (!DS_insert_last(root, data + i*root->data_size))
+				result = r_failure;
+		break;
+	
+	case DS_circular_list: // insert before the head to append
+		for(size_t i=0; result == r_success && i<count; i++){
+			root->current = root->head;
+			if (!DS_insert(root, data + i*root->data_size)) result = r_failure;
+		}
+		break;
+	
+	case DS_heap: // in heap order, so nothing sifts at the same arity
+	case DS_pairing:
+	case DS_btree:
+	case DS_hash:
+		for(size_t i=0; result == r_success && i<count; i++)
+			if (!DS_insert(root, data + i*root->data_size)) result = r_failure;
+		break;
+	
+	case DS_sync:
+	case DS_wsdeque:
+	case DS_spsc:
+	case DS_radix:
+	case DS_mpmc:
+	default: break;
+	}
+	
+	munmap((void*)map, size);
+	if (result == r_failure) DS_empty(root);
+	return result;
 }
 
-/********************** VIEW RECORD IN DATA STRUCTURE *************************/
 
-void * DS_find(const DS root, const void * key){
-	_tnode_pt node;
-	imax result;
+/******************************************************************************/
+//                              ARRAY UTILITIES
+/******************************************************************************/
+
+
+#define CACHE_SZ ((size_t)1<<15)
+
+void DS_memswap(void *a, void *b, size_t size){
+	uint8_t *x = (uint8_t*)a, *y = (uint8_t*)b;
+	uint64_t temp_x, temp_y;
+	uint8_t  temp;
 	
-	if (!root){
-		_error(_e_null);
-		return NULL;
+	// memcpy allows unaligned 8-byte moves without breaking alignment rules
+	while(size >= sizeof(uint64_t)){
+		memcpy(&temp_x, x, sizeof(uint64_t));
+		memcpy(&temp_y, y, sizeof(uint64_t));
+		memcpy(x, &temp_y, sizeof(uint64_t));
+		memcpy(y, &temp_x, sizeof(uint64_t));
+		x    += sizeof(uint64_t);
+		y    += sizeof(uint64_t);
+		size -= sizeof(uint64_t);
 	}
 	
-	if (root->current.l == NULL) return NULL;
-	
-	switch (root->type){
-	case DS_bst: break;
-	case DS_hash: _error(_e_nimp); return NULL;
-	
-	case DS_heap         :
-	case DS_list         :
-	case DS_circular_list: _error(_e_nsense); return NULL;
-	default: _error(_e_invtype); return NULL;
+	while(size--){
+		temp = *x;
+		*x++ = *y;
+		*y++ = temp;
 	}
+}
+
+/********************************** SORTING ***********************************/
+
+/*	DS_sort is a bottom-up merge sort. Short runs are first put in order with a
+ *	binary insertion sort. The runs in each CACHE_SZ block are then merged while
+ *	the block is still in the cache, and finally the blocks are merged with each
+ *	other. Adjacent runs that are already in order are never merged, so sorted
+ *	input is handled in linear time. Descending runs are reversed in place.
+ */
+
+#define _SORT_RUN ((size_t)32) // elements in an insertion sorted run
+
+// reverse the order of the elements in the array
+inline static void _reverse(void *buffer, size_t count, const size_t size){
+	for(size_t i=0; i < --count; i++) DS_memswap(_at(i), _at(count), size);
+}
+
+// length of the strictly descending run at the start of the array
+inline static size_t _descending(
+	const void *buffer,
+	const size_t count,
+	const size_t size,
+	int (*compare)(const void *left, const void *right)
+){
+	size_t i = 1;
+	while(i < count && compare(_at(i-1), _at(i)) > 0) i++;
+	return i;
+}
+
+// index of the first element ordered after data, in a sorted array
+static size_t _upper_bound(
+	const void *buffer,
+	      size_t count,
+	const size_t size,
+	const void *data,
+	int (*compare)(const void *left, const void *right)
+){
+	size_t lo = 0, mid;
 	
-	node = root->head.t;
-	while (node != NULL){
-		result=root->cmp_keys(key, root->keys.key(node->data));
-		
-		if      (result>0) node=node->right;
-		else if (result<0) node=node->left;
-		else { //strcmp returns 0
-			root->current.t=node;
-			return root->current.t->data;
+	while(count){
+		mid = lo + count/2;
+		if(compare(_at(mid), data) <= 0){
+			lo = mid+1;
+			count -= count/2 + 1;
 		}
+		else count /= 2;
 	}
-	
-	return NULL;
+	return lo;
 }
 
-
-// VISITING
-void * DS_first(const DS root){ // visit the first node
-	if (!root){
-		_error(_e_null);
-		return NULL;
-	}
-	
-	if (root->current.l == NULL) return NULL;
-	
-	switch (root->type){
-	case DS_bst:
-		root->current=root->head;
-		if (root->current.t == NULL) return NULL;
-		while(root->current.t->left != NULL)
-			root->current.t=root->current.t->left;
-		return root->current.t->data;
-	
-	case DS_heap:
-	case DS_list:
-		root->current=root->head;
-		return root->current.l->data;
-	
+// index of the first element not ordered before data, in a sorted array
+static size_t _lower_bound(
+	const void *buffer,
+	      size_t count,
+	const size_t size,
+	const void *data,
+	int (*compare)(const void *left, const void *right)
+){
+	size_t lo = 0, mid;
 	
-	case DS_hash         :
-	case DS_circular_list: _error(_e_nsense ); return NULL;
-	default              : _error(_e_invtype); return NULL;
+	while(count){
+		mid = lo + count/2;
+		if(compare(_at(mid), data) < 0){
+			lo = mid+1;
+			count -= count/2 + 1;
+		}
+		else count /= 2;
 	}
+	return lo;
 }
 
-void * DS_last(const DS root){ // visit the last node
-	if (!root){
-		_error(_e_null);
-		return NULL;
-	}
-	
-	if (root->current.l == NULL) return NULL;
-	
-	switch (root->type){
-	case DS_bst:
-		root->current=root->head;
-		while(root->current.t->right)
-			root->current.t=root->current.t->right;
-		return root->current.t->data;
+/*	efficient for small data sizes and nearly sorted lists. temp must have room
+ *	for one element.
+ */
+static void _insertion_sort(
+	void *buffer,
+	size_t count,
+	size_t size,
+	int (*compare)(const void *left, const void *right),
+	void *temp
+){
+	size_t i, pos;
 	
-	case DS_list:
-		root->current=root->tail;
-		return root->current.l->data;
+	// a descending start is cheaper to reverse than to insert
+	if((i = _descending(buffer, count, size, compare)) > 2)
+		_reverse(buffer, i, size);
 	
-	case DS_heap         :
-	case DS_hash         :
-	case DS_circular_list: _error(_e_nsense ); return NULL;
-	default              : _error(_e_invtype); return NULL;
+	for(i = 1; i<count; i++){
+		if(compare(_at(i-1), _at(i)) <= 0) continue; // already in place
+		
+		pos = _upper_bound(buffer, i-1, size, _at(i), compare);
+		memcpy(temp, _at(i), size);
+		memmove(_at(pos+1), _at(pos), (i-pos)*size);
+		memcpy(_at(pos), temp, size);
 	}
 }
 
-void * DS_next(const DS root){ // visit the next in-order node
-	if (!root){
-		_error(_e_null);
-		return NULL;
-	}
+/*	Merge the sorted runs [0,mid) and [mid,count) in place. The smaller run is
+ *	copied out to scratch, so scratch must have room for count/2 elements.
+ */
+static void _merge(
+	void *buffer,
+	size_t mid,
+	size_t count,
+	const size_t size,
+	int (*compare)(const void *left, const void *right),
+	void *scratch
+){
+	size_t i, j, k, skip;
 	
-	if (root->current.l == NULL) return NULL;
+	if(compare(_at(mid-1), _at(mid)) <= 0) return; // already in order
 	
-	switch (root->type){
-	case DS_bst: // this is an in-order traversal
-		
-		// We can assume the left children have already been visited
-		if (root->current.t->right){
-			root->current.t = root->current.t->right;
-			while(root->current.t->left)
-				root->current.t = root->current.t->left;
-		}
+	// leading elements of the left run that are already in place
+	skip    = _upper_bound(buffer, mid, size, _at(mid), compare);
+	buffer  = _at(skip);
+	mid    -= skip;
+	count  -= skip;
+	
+	// trailing elements of the right run that are already in place
+	count = mid + _lower_bound(_at(mid), count-mid, size, _at(mid-1), compare);
+	
+	if(mid <= count-mid){ // copy the left run out and merge forward
+		memcpy(scratch, buffer, mid*size);
+		i = 0; j = mid; k = 0;
 		
-		/* If there are no more right children then we must go up.
-		To prevent duplicate visits, we must go up until we approach a parent
-		from the left child
-		*/
-		else{
-			while(root->current.t->parent && root->current.t->parent->right == root->current.t)
-				root->current.t = root->current.t->parent;
-			if(!root->current.t->parent){ // we're at the last node
-				// leave current somewhere reasonable
-				while(root->current.t->right)
-					root->current.t=root->current.t->right;
-				return NULL;
+		while(i < mid && j < count){
+			if(compare(_at(j), (uint8_t*)scratch+i*size) < 0)
+				_elcpy(_at(k++), _at(j++), size);
+			else{
+				_elcpy(_at(k++), (uint8_t*)scratch+i*size, size);
+				i++;
 			}
-			else root->current.t = root->current.t->parent;
 		}
+		memcpy(_at(k), (uint8_t*)scratch+i*size, (mid-i)*size);
+	}
+	else{ // copy the right run out and merge backward
+		memcpy(scratch, _at(mid), (count-mid)*size);
+		i = mid; j = count-mid; k = count;
 		
-		return root->current.t->data;
-	
-	case DS_list:
-	case DS_circular_list:
-		root->current.l=root->current.l->next;
-		if(!root->current.l) {
-			root->current=root->tail;
-			return NULL;
+		while(i && j){
+			if(compare(_at(i-1), (uint8_t*)scratch+(j-1)*size) > 0)
+				_elcpy(_at(--k), _at(--i), size);
+			else{
+				j--;
+				_elcpy(_at(--k), (uint8_t*)scratch+j*size, size);
+			}
 		}
-		else return root->current.l->data;
-	
-	case DS_heap:
-	case DS_hash: _error(_e_nsense); return NULL;
-	default     : _error(_e_invtype); return NULL;
+		memcpy(buffer, scratch, j*size);
 	}
 }
 
-void * DS_previous(const DS root){ // visit the previous in-order node
-	if (!root){
-		_error(_e_null);
-		return NULL;
-	}
+// merge each pair of sorted runs of the given width
+static void _merge_pass(
+	void *buffer,
+	size_t count,
+	size_t size,
+	int (*compare)(const void *left, const void *right),
+	void *scratch,
+	size_t width
+){
+	for(size_t lo=0; lo+width < count; lo += width*2)
+		_merge(
+			_at(lo),
+			width,
+			(count-lo < width*2)? count-lo : width*2,
+			size, compare, scratch
+		);
+}
+
+/*	Sort the array using the given scratch space, which must have room for
+ *	count/2+1 elements.
+ */
+static void _sort(
+	void *buffer,
+	size_t count,
+	size_t size,
+	int (*compare)(const void *left, const void *right),
+	void *scratch
+){
+	size_t block, width, len;
 	
-	if (root->current.l == NULL) return NULL;
+	// cache sized blocks, a power of two multiple of the run length
+	for(block = _SORT_RUN; block*2*size <= CACHE_SZ; block *= 2);
 	
-	switch (root->type){
-	case DS_bst:
-		// We can assume the right children have already been visited
-		if (root->current.t->left){
-			root->current.t=root->current.t->left;
-			while(root->current.t->right)
-				root->current.t=root->current.t->right;
-		}
-		/* If there are no more right children then we must go up.
-		To prevent duplicate visits, we must go up until we approach a parent
-		from the right child
-		*/
-		else{
-			while(root->current.t->parent && root->current.t->parent->left == root->current.t)
-				root->current.t = root->current.t->parent;
-			if(!root->current.t->parent){
-				// leave current somewhere reasonable
-				while(root->current.t->left != NULL)
-					root->current.t=root->current.t->left;
-				return NULL; // we're at the first node
-			}
-			else root->current.t = root->current.t->parent;
-		}
+	// first sort each block while it is in the cache
+	for(size_t lo=0; lo<count; lo += block){
+		len = (count-lo < block)? count-lo : block;
 		
-		return root->current.t->data;
+		for(size_t run=0; run<len; run += _SORT_RUN)
+			_insertion_sort(
+				_at(lo+run),
+				(len-run < _SORT_RUN)? len-run : _SORT_RUN,
+				size, compare, scratch
+			);
 		
-	case DS_list:
-	case DS_circular_list:
-		root->current.l=root->current.l->prev;
-		if(!root->current.l){
-			root->current = root->tail;
-			return NULL;
-		}
-		else return root->current.l->data;
-	
-	case DS_heap:
-	case DS_hash: _error(_e_nsense); return NULL;
-	default     : _error(_e_invtype); return NULL;
+		for(width=_SORT_RUN; width<len; width *= 2)
+			_merge_pass(_at(lo), len, size, compare, scratch, width);
 	}
+	
+	// then merge the blocks
+	for(width=block; width<count; width *= 2)
+		_merge_pass(buffer, count, size, compare, scratch, width);
 }
 
-void * DS_current (DS root){ // visit the current node
-	if (!root){
-		_error(_e_null);
-		return NULL;
-	}
+void DS_sort(
+	void *buffer,
+	size_t count,
+	size_t size,
+	int (*compare)(const void *left, const void *right)
+){
+	void * scratch;
+	size_t run;
 	
-	if (root->current.l == NULL) return NULL;
+	if(count < 2) return;
 	
-	switch (root->type){
-	case DS_bst          : return root->current.t->data;
-	case DS_hash         :
-	case DS_list         :
-	case DS_circular_list: return root->current.l->data;
-	case DS_heap         : _error(_e_nsense); return NULL;
-	default              : _error(_e_invtype); return NULL;
+	// check for sorted and reverse sorted input
+	run = _descending(buffer, count, size, compare);
+	if(run == count){
+		_reverse(buffer, count, size);
+		return;
 	}
-}
-
-// set the current position to a specific count from the beginning
-void * DS_position(const DS root, const unsigned int position){
-	if (!root){
-		_error(_e_null);
-		return NULL;
+	else if(run == 1){
+		while(run < count && compare(_at(run-1), _at(run)) <= 0) run++;
+		if(run == count) return;
 	}
 	
-	if (root->current.l == NULL) return NULL;
-	
-	switch (root->type){
-	case DS_list         : break;
-	case DS_bst          :
-	case DS_heap         :
-	case DS_hash         :
-	case DS_circular_list: _error(_e_nsense); return NULL;
-	default              : _error(_e_invtype); return NULL;
+	scratch = malloc((count/2+1)*size);
+	if(!scratch){
+		_error(_e_mem);
+		return;
 	}
 	
-	root->current=root->head;
-	for (uint i=1; i != position; i++) root->current.l = root->current.l->next;
+	_sort(buffer, count, size, compare, scratch);
 	
-	return root->current.l->data;
+	free(scratch);
 }
 
+/***************************** PARALLEL SORTING *******************************/
 
-/******************************************************************************/
-//                              ARRAY UTILITIES
-/******************************************************************************/
+/*	DS_sort_parallel first sorts one chunk of the array per thread, then merges
+ *	pairs of runs until one run is left. Each merge is split into independent
+ *	pieces along its merge path so that every thread has work even in the last
+ *	rounds. The runs move back and forth between the array and a scratch
+ *	buffer of the same size.
+ */
 
+#define _PSORT_MIN ((size_t)1<<12) // minimum elements per thread
 
-#define _at(A) ((uint8_t*)buffer+(A*size))
+struct _psort;
 
-#define CACHE_SZ ((size_t)1<<15)
+typedef struct _psort_task {
+	void (*run)(const struct _psort * job, const struct _psort_task * task);
+	const uint8_t * a; // the left run, or the chunk to sort
+	const uint8_t * b; // the right run
+	uint8_t *       out; // merge output, or the scratch space for a sort
+	size_t          na;
+	size_t          nb;
+} _psort_task;
 
-void DS_memswap(void *a, void *b, size_t size){
-	uint64_t temp;
-	
-	if(size & 1){
-		temp = ((uint8_t*)a)[size-1];
-		((uint8_t*)a)[size-1] = ((uint8_t*)b)[size-1];
-		((uint8_t*)b)[size-1] = (uint8_t)temp;
-	}
-	size>>=1;
-	
-	if(size & 1){
-		temp = ((uint16_t*)a)[size-1];
-		((uint16_t*)a)[size-1] = ((uint16_t*)b)[size-1];
-		((uint16_t*)b)[size-1] = (uint16_t)temp;
-	}
-	size>>=1;
-	
-	if(size & 1){
-		temp = ((uint32_t*)a)[size-1];
-		((uint32_t*)a)[size-1] = ((uint32_t*)b)[size-1];
-		((uint32_t*)b)[size-1] = (uint32_t)temp;
-	}
-	size>>=1;
-	
-	while(size){
-		size--;
-		temp = ((uint64_t*)a)[size-1];
-		((uint64_t*)a)[size-1] = ((uint64_t*)b)[size-1];
-		((uint64_t*)b)[size-1] = temp;
-	}
-	
-}
-
-/*static inline void _merge(*/
-/*	void *buffer,*/
-/*	size_t idx_l,*/
-/*	size_t idx_r,*/
-/*	size_t idx_end,*/
-/*	size_t size,*/
-/*	int (*compare)(const void *left, const void *right)*/
-/*){*/
-/*	while(){*/
-/*		int r=compare(_at(idx_l), _at(idx_r));*/
-/*		*/
-/*		if(r<=0) idx_l++;*/
-/*		else */
-/*	}*/
-/*}*/
-
-/*static inline void _insertion_sort(*/
-/*	void *buffer,*/
-/*	size_t count,*/
-/*	size_t size,*/
-/*	int (*compare)(const void *left, const void *right)*/
-/*){*/
-/*	size_t i, j;*/
-/*	*/
-/*	// efficient for small data sizes and nearly sorted lists*/
-/*	for(i = 1; i<count; i++){*/
-/*		if(compare(_at(i-1), _at(i))>0){*/
-/*			j=i-1;*/
-/*			do DS_memswap(_at(j), _at(j+1), size);*/
-/*			while(j-- && compare(_at(j), _at(j+1))>0);*/
-/*		}*/
-/*	}*/
-/*}*/
-
-
-/*void DS_sort(*/
-/*	void *buffer,*/
-/*	size_t count,*/
-/*	size_t size,*/
-/*	int (*compare)(const void *left, const void *right)*/
-/*){*/
-/*	size_t total_sz = count*size;*/
-/*	size_t run_count = CACHE_SZ / size;*/
-/*	size_t full_runs = count / run_count;*/
-/*	size_t i;*/
-/*	*/
-/*	*/
-/*	// first sort cache sized runs. I could multithread this part*/
-/*	for(i=0; i<full_runs; i++)*/
-/*		_insertion_sort(_at(i*run_count), run_count, size, compare);*/
-/*	*/
-/*	// sort the stragglers*/
-/*	_insertion_sort(_at(i*run_count), count-i*run_count, size, compare);*/
-/*	*/
-/*	while(run_count < count){*/
-/*		_merge*/
-/*	}*/
-/*	*/
-/*}*/
+struct _psort {
+	_psort_task * tasks;
+	size_t        task_cnt;
+	atomic_size_t next;
+	size_t        size;
+	int (*compare)(const void *left, const void *right);
+};
 
-/***************************** ARRAY BASED HEAPS ******************************/
+static void _psort_sort(const struct _psort * job, const _psort_task * task){
+	_sort((void*)task->a, task->na, job->size, job->compare, task->out);
+}
+
+// stable merge of two runs into a separate output
+static void _psort_merge(const struct _psort * job, const _psort_task * task){
+	const size_t size = job->size;
+	const uint8_t *a = task->a, *a_end = task->a + task->na*size;
+	const uint8_t *b = task->b, *b_end = task->b + task->nb*size;
+	uint8_t *out = task->out;
+	
+	while(a < a_end && b < b_end){
+		if(job->compare(b, a) < 0){
+			_elcpy(out, b, size);
+			b += size;
+		}
+		else{
+			_elcpy(out, a, size);
+			a += size;
+		}
+		out += size;
+	}
+	
+	memcpy(out, a, (size_t)(a_end-a));
+	memcpy(out + (a_end-a), b, (size_t)(b_end-b));
+}
 
-#define _heap_left(A) (A*2+1)
-#define _heap_right(A) (A*2+2)
-#define _heap_parent(A) ((A-1)/2)
+static void * _psort_worker(void * arg){
+	struct _psort * job = (struct _psort*) arg;
+	size_t i;
+	
+	while((i = atomic_fetch_add(&job->next, 1)) < job->task_cnt)
+		job->tasks[i].run(job, &job->tasks[i]);
+	
+	return NULL;
+}
 
-inline static void _sift_down(
-	const void   *buffer,
-	      size_t start, // index of the element to sift down, <stop
-	const size_t stop,  // how far to sift down
-	const size_t size,
-	int    (*compare)(const void *left, const void *right)
+// run all the tasks in the job on up to the given number of threads
+static void _psort_run(struct _psort * job, uint threads){
+	pthread_t * tid;
+	uint        started = 0;
+	
+	atomic_store(&job->next, 0);
+	
+	tid = (pthread_t*) malloc(threads*sizeof(pthread_t));
+	if(tid)
+		while(started < threads-1 &&
+			!pthread_create(&tid[started], NULL, &_psort_worker, job)
+		)
+			started++;
+	
+	// this thread works too, and finishes the job if no threads started
+	_psort_worker(job);
+	
+	while(started) pthread_join(tid[--started], NULL);
+	free(tid);
+}
+
+/*	Find how many of the first k merged elements come from run a. Ties are taken
+ *	from a first to keep the merge stable.
+ */
+static size_t _merge_path(
+	const uint8_t *a, size_t na,
+	const uint8_t *b, size_t nb,
+	size_t k,
+	size_t size,
+	int (*compare)(const void *left, const void *right)
 ){
-	size_t smallest, left;
+	size_t lo = k > nb? k-nb : 0;
+	size_t hi = k < na? k    : na;
+	size_t i;
 	
-	while(_heap_left(start) <= stop){
-		left = _heap_left(start);
-		smallest = start;
-		
-		if( compare(_at(smallest),_at(left)) > 0 ) // if left child is smaller
-			smallest = left;
-		
-		if(left+1 <= stop && compare(_at(smallest),_at(left+1))>0)
-			smallest=left+1;
-		
-		if(smallest == start) return; // both children are in order
-		else DS_memswap(_at(start), _at(smallest), size);
-		start = smallest;
+	while(lo < hi){
+		i = lo + (hi-lo)/2;
+		if(compare(a + i*size, b + (k-i-1)*size) <= 0) lo = i+1;
+		else hi = i;
 	}
 	
+	return lo;
 }
 
-inline static void _sift_up(
-	const void   *buffer,
-	const size_t stop,    // how far to sift up, <element
-	      size_t element, // index of the element to sift up
-	const size_t size,
-	int    (*compare)(const void *left, const void *right)
+void DS_sort_parallel(
+	void *buffer,
+	size_t count,
+	size_t size,
+	int (*compare)(const void *left, const void *right),
+	uint threads
 ){
-	size_t parent;
+	struct _psort job;
+	size_t   *bound, runs, parts, len, i0, i1, k0, k1;
+	uint8_t  *scratch, *src, *dst, *swap;
+	const uint8_t *a, *b;
+	
+	if(count/_PSORT_MIN < threads) threads = (uint)(count/_PSORT_MIN);
+	if(threads < 2){
+		DS_sort(buffer, count, size, compare);
+		return;
+	}
+	
+	scratch   = (uint8_t*) malloc(count*size);
+	bound     = (size_t*) malloc((threads+1)*sizeof(size_t));
+	job.tasks = (_psort_task*) malloc((threads*2+1)*sizeof(_psort_task));
+	if(!scratch || !bound || !job.tasks){
+		free(scratch);
+		free(bound);
+		free(job.tasks);
+		DS_sort(buffer, count, size, compare);
+		return;
+	}
+	job.size    = size;
+	job.compare = compare;
+	
+	// sort one chunk per thread
+	runs = threads;
+	for(size_t r=0; r<=runs; r++) bound[r] = count*r/runs;
+	for(size_t r=0; r<runs; r++){
+		job.tasks[r].run = &_psort_sort;
+		job.tasks[r].a   = _at(bound[r]);
+		job.tasks[r].na  = bound[r+1]-bound[r];
+		job.tasks[r].out = scratch + bound[r]*size;
+	}
+	job.task_cnt = runs;
+	_psort_run(&job, threads);
 	
-	parent = _heap_parent(element);
-	while(element >= stop && compare(_at(parent), _at(element)) >0){
-		DS_memswap(_at(parent), _at(element), size);
-		element = parent;
-		parent = _heap_parent(element);
+	// merge pairs of runs, splitting each merge along its merge path
+	src = (uint8_t*) buffer;
+	dst = scratch;
+	while(runs > 1){
+		job.task_cnt = 0;
+		
+		for(size_t r=0; r<runs; r+=2){
+			a   = src + bound[r]*size;
+			b   = src + bound[r+1]*size;
+			len = bound[r+2 < runs? r+2 : runs] - bound[r];
+			
+			// a share of the threads proportional to the merge's length
+			parts = (threads*len + count-1) / count;
+			for(size_t p=0; p<parts; p++){
+				k0 = len* p   /parts;
+				k1 = len*(p+1)/parts;
+				i0 = _merge_path(a, bound[r+1]-bound[r], b,
+					len-(bound[r+1]-bound[r]), k0, size, compare);
+				i1 = _merge_path(a, bound[r+1]-bound[r], b,
+					len-(bound[r+1]-bound[r]), k1, size, compare);
+				
+				job.tasks[job.task_cnt].run = &_psort_merge;
+				job.tasks[job.task_cnt].a   = a + i0*size;
+				job.tasks[job.task_cnt].na  = i1-i0;
+				job.tasks[job.task_cnt].b   = b + (k0-i0)*size;
+				job.tasks[job.task_cnt].nb  = (k1-i1)-(k0-i0);
+				job.tasks[job.task_cnt].out = dst + (bound[r]+k0)*size;
+				job.task_cnt++;
+			}
+		}
+		_psort_run(&job, threads);
+		
+		for(size_t r=0; r<runs; r+=2) bound[r/2] = bound[r];
+		runs = (runs+1)/2;
+		bound[runs] = count;
+		
+		swap = src;
+		src  = dst;
+		dst  = swap;
+	}
+	
+	// the result may have finished in the scratch buffer
+	if(src != buffer){
+		for(uint t=0; t<threads; t++){
+			job.tasks[t].run = &_psort_merge;
+			job.tasks[t].a   = src + count*t/threads*size;
+			job.tasks[t].na  = count*(t+1)/threads - count*t/threads;
+			job.tasks[t].b   = job.tasks[t].a + job.tasks[t].na*size;
+			job.tasks[t].nb  = 0;
+			job.tasks[t].out = _at(count*t/threads);
+		}
+		job.task_cnt = threads;
+		_psort_run(&job, threads);
 	}
+	
+	free(scratch);
+	free(bound);
+	free(job.tasks);
+}
+
+/***************************** ARRAY BASED HEAPS ******************************/
+
+struct _array_cmp {
+	int (*compare)(const void *left, const void *right);
+};
+
+// adapt the caller's comparison to the sifting functions
+inline static imax _array_cmp(const void * ctx, const void * left, const void * right){
+	return ((const struct _array_cmp*)ctx)->compare(left, right);
 }
 
 
@@ -1261,12 +6008,43 @@ void DS_heapify(
 	size_t size,
 	int    (*compare)(const void *left, const void *right)
 ){
-	size_t start = _heap_parent(count-1);
+	DS_heapify_arity(buffer, count, size, compare, 2);
+}
+
+void DS_heapify_arity(
+	void   *buffer,
+	size_t count,
+	size_t size,
+	int    (*compare)(const void *left, const void *right),
+	uint   arity
+){
+	struct _array_cmp ctx;
+	uint64_t small[32]; // most elements are sifted through here
+	void *   temp;
+	size_t   start;
+	
+	if(count < 2) return;
+	
+	if(arity < 2){
+		_error(_e_nsense);
+		return;
+	}
+	
+	if(size <= sizeof(small)) temp = small;
+	else if(!( temp = malloc(size) )){
+		_error(_e_mem);
+		return;
+	}
+	
+	ctx.compare = compare;
+	start = _heap_parent(count-1, arity);
 	
 	do{
-		_sift_down(buffer, start, count-1, size, compare);
+		memcpy(temp, _at(start), size);
+		_sift_down(buffer, start, count-1, size, arity, &_array_cmp, &ctx, temp);
 	} while(start-- != 0);
 	
+	if(temp != small) free(temp);
 }
 
 
@@ -0,0 +1,200 @@
+
+
+
+#include <util/data.hpp>
+#include <util/msg.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+
+#define TREE_CNT 10000
+#define HEAP_CNT 10000
+
+// count live elements to check that the wrappers destroy what they own
+static int live = 0;
+
+struct item {
+	unsigned                  key;
+	std::unique_ptr<unsigned> payload;
+	
+	item(unsigned k): key(k), payload(new unsigned(k * 3)){ live++; }
+	item(item && other): key(other.key), payload(std::move(other.payload)){
+		live++;
+	}
+	item & operator=(item && other){
+		key     = other.key;
+		payload = std::move(other.payload);
+		return *this;
+	}
+	~item(){ live--; }
+	
+	bool operator<(const item & other) const { return key < other.key; }
+};
+
+struct by_key {
+	const unsigned & operator()(const item & i) const { return i.key; }
+};
+
+struct greater {
+	bool operator()(const item & left, const item & right) const {
+		return right.key < left.key;
+	}
+};
+
+// a permutation of 0 .. TREE_CNT-1
+static unsigned scatter(unsigned i){ return (i * 7919u) % TREE_CNT; }
+
+
+static void bst_tests(void){
+	util::bst<item, by_key> tree;
+	item     out(0);
+	unsigned i, prev;
+	bool     first;
+	
+	for (i = 0; i < TREE_CNT; i++)
+		if (!tree.emplace(scatter(i))) puts("ERROR: bst: emplace failed");
+	
+	if (tree.size() != TREE_CNT) puts("ERROR: bst: wrong size");
+	if (tree.emplace(5u)) puts("ERROR: bst: accepted a duplicate");
+	if (tree.size() != TREE_CNT) puts("ERROR: bst: duplicate changed size");
+	
+	for (i = 0; i < TREE_CNT; i++){
+		const item * found = tree.find(i);
+		if (!found || found->key != i || *found->payload != i * 3){
+			printf("ERROR: bst: failed to find %u\n", i);
+			break;
+		}
+	}
+	if (tree.find(TREE_CNT)) puts("ERROR: bst: found a missing key");
+	
+	// in order
+	i = 0;
+	first = true;
+	prev  = 0;
+	for (util::bst<item, by_key>::iterator it = tree.begin(); it != tree.end();
+		++it
+	){
+		if (!first && it->key <= prev) puts("ERROR: bst: out of order");
+		prev  = it->key;
+		first = false;
+		i++;
+	}
+	if (i != TREE_CNT) puts("ERROR: bst: iteration missed elements");
+	
+	// remove the even keys
+	for (i = 0; i < TREE_CNT; i += 2)
+		if (!tree.erase(i)) printf("ERROR: bst: failed to erase %u\n", i);
+	if (tree.erase(0)) puts("ERROR: bst: erased a missing key");
+	if (tree.size() != TREE_CNT/2) puts("ERROR: bst: wrong size after erase");
+	if (tree.find(4) || !tree.find(5)) puts("ERROR: bst: erased the wrong key");
+	
+	if (!tree.extract(7, out) || out.key != 7 || *out.payload != 21)
+		puts("ERROR: bst: extract failed");
+	if (tree.find(7)) puts("ERROR: bst: extracted key still present");
+	
+	if (!tree.insert(std::move(out))) puts("ERROR: bst: reinsert failed");
+	if (!tree.find(7)) puts("ERROR: bst: reinserted key missing");
+	
+	// moving the tree leaves the old one empty
+	util::bst<item, by_key> moved(std::move(tree));
+	if (!tree.empty() || tree.find(5)) puts("ERROR: bst: moved from not empty");
+	if (moved.size() != TREE_CNT/2) puts("ERROR: bst: move lost elements");
+	
+	moved.clear();
+	if (!moved.empty()) puts("ERROR: bst: clear failed");
+	
+	// plain keys and the default functors
+	util::bst<std::string> words;
+	words.insert(std::string("beta"));
+	words.insert(std::string("alpha"));
+	words.emplace("gamma");
+	if (words.insert(std::string("alpha"))) puts("ERROR: bst: duplicate string");
+	if (!words.find("beta") || words.find("delta"))
+		puts("ERROR: bst: string find failed");
+	if (*words.begin() != "alpha") puts("ERROR: bst: string order");
+}
+
+static void list_tests(void){
+	util::list<item> list;
+	item     out(0);
+	unsigned i;
+	
+	for (i = 0; i < 10; i++) list.emplace_back(i);
+	list.emplace_front(100u);
+	list.push_back(item(200u));
+	
+	if (list.size() != 12) puts("ERROR: list: wrong size");
+	if (list.front().key != 100 || list.back().key != 200)
+		puts("ERROR: list: wrong ends");
+	
+	i = 0;
+	for (util::list<item>::iterator it = list.begin(); it != list.end(); ++it){
+		if (i >= 1 && i <= 10 && it->key != i-1)
+			puts("ERROR: list: wrong order");
+		i++;
+	}
+	if (i != 12) puts("ERROR: list: iteration missed elements");
+	
+	if (!list.pop_front(out) || out.key != 100) puts("ERROR: list: pop_front");
+	if (!list.pop_back (out) || out.key != 200) puts("ERROR: list: pop_back");
+	if (!out.payload || *out.payload != 600) puts("ERROR: list: lost payload");
+	
+	util::list<item> moved;
+	moved = std::move(list);
+	if (moved.size() != 10 || !list.empty()) puts("ERROR: list: move failed");
+	
+	while (moved.pop_front(out));
+	if (!moved.empty()) puts("ERROR: list: not empty after popping");
+	if (moved.pop_back(out)) puts("ERROR: list: popped an empty list");
+}
+
+static void heap_tests(void){
+	util::heap<item>          min;
+	util::heap<item, greater> max;
+	item     out(0);
+	unsigned i, prev;
+	
+	for (i = 0; i < HEAP_CNT; i++){
+		min.emplace(scatter(i));
+		max.push(item(scatter(i)));
+	}
+	
+	if (min.size() != HEAP_CNT) puts("ERROR: heap: wrong size");
+	if (min.top().key != 0) puts("ERROR: heap: wrong top");
+	if (max.top().key != HEAP_CNT-1) puts("ERROR: heap: wrong max top");
+	
+	prev = 0;
+	for (i = 0; min.pop(out); i++){
+		if (out.key < prev) puts("ERROR: heap: out of order");
+		if (!out.payload || *out.payload != out.key * 3)
+			puts("ERROR: heap: lost payload");
+		prev = out.key;
+	}
+	if (i != HEAP_CNT) puts("ERROR: heap: lost elements");
+	
+	// leave the rest of max to the destructor
+	for (i = 0; i < HEAP_CNT/2; i++)
+		if (!max.pop(out) || out.key != HEAP_CNT-1-i)
+			puts("ERROR: heap: max out of order");
+}
+
+
+int main(void){
+	msg_set_verbosity(V_ERROR);
+	
+	puts("Testing the C++ wrappers");
+	
+	bst_tests();
+	list_tests();
+	heap_tests();
+	
+	if (live) printf("ERROR: %d elements were not destroyed\n", live);
+	
+	puts("C++ wrapper tests done");
+	return EXIT_SUCCESS;
+}
+
+
@@ -7,6 +7,36 @@
 #include <util/io.h>
 
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+
+#define HEAPIFY_CNT 1001
+#define SORT_CNT    200000
+#define TREE_CNT    100000
+#define BTREE_CNT   20000
+#define RANK_CNT    10000
+#define QUEUE_CNT   200000 // entries per producer
+#define QUEUE_THR   4      // producers and consumers each
+#define RING_CNT    1000000
+#define RING_BATCH  37
+#define DEQUE_CNT   500000
+#define DEQUE_THIEF 4
+#define SYNC_CNT    4096 // keys per writer
+#define SYNC_ROUND  8
+#define SYNC_THR    4    // readers and writers each
+#define ARRAY_CNT   10000
+#define CURSOR_CNT  5000
+#define CURSOR_THR  4
+#define LINKED_CNT  10000
+#define PREFIX_CNT  5000
+#define SNAP_CNT    10000
+#define SNAP_PATH   "test-data.snap"
+#define PAIRING_CNT 20000
+#define ARITY_CNT   10000
+#define FAT_SZ      300 // too big to sift through the stack
+#define KEYED_CNT   10000
+#define RADIX_CNT   20000
 
 static inline imax cmp(const void * left, const void * right){
 	return strcmp((char*) left, (char*) right);
@@ -17,6 +47,1519 @@ static inline const void * key(const void * data) {
 	return data;
 }
 
+static imax cmp_int(const void * left, const void * right){
+	return (imax)(*(const uint64_t*)left >> 20) - (imax)(*(const uint64_t*)right >> 20);
+}
+
+static int cmp_bytes(const void * left, const void * right){
+	return *(const uint8_t*)left - *(const uint8_t*)right;
+}
+
+static int cmp_array(const void * left, const void * right){
+	return (*(const int*)left > *(const int*)right) - (*(const int*)left < *(const int*)right);
+}
+
+// sort records by key only, idx records the original order
+typedef struct {
+	uint32_t key;
+	uint32_t idx;
+} record;
+
+static int cmp_record(const void * left, const void * right){
+	return (((const record*)left)->key > ((const record*)right)->key) -
+	       (((const record*)left)->key < ((const record*)right)->key);
+}
+
+static imax cmp_u64(const void * left, const void * right){
+	return (*(const uint64_t*)left > *(const uint64_t*)right) -
+	       (*(const uint64_t*)left < *(const uint64_t*)right);
+}
+
+static int cmp_array_u64(const void * left, const void * right){
+	return (int)cmp_u64(left, right);
+}
+
+// a 64-bit mixer for integer data
+static inline uint64_t hash_int(const void * data){
+	uint64_t h = *(const uint64_t*)data;
+	
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+// check that records are in order and that equal keys kept their order
+static bool sorted(const record * array, uint count){
+	for(uint i=1; i<count; i++){
+		if(array[i-1].key > array[i].key) return false;
+		if(array[i-1].key == array[i].key && array[i-1].idx > array[i].idx)
+			return false;
+	}
+	return true;
+}
+
+static void sort_tests(void){
+	record * array    = (record*) malloc(SORT_CNT*sizeof(record));
+	record * copy     = (record*) malloc(SORT_CNT*sizeof(record));
+	record * parallel = (record*) malloc(SORT_CNT*sizeof(record));
+	uint8_t  bytes[999];
+	
+	// random with many duplicates
+	for(uint64_t i=0; i<SORT_CNT; i++){
+		array[i].key = (uint32_t)(hash_int(&i)%5000);
+		array[i].idx = (uint32_t)i;
+	}
+	DS_sort(array, SORT_CNT, sizeof(record), &cmp_record);
+	if(!sorted(array, SORT_CNT)) puts("ERROR: random sort failed");
+	
+	// already sorted
+	DS_sort(array, SORT_CNT, sizeof(record), &cmp_record);
+	if(!sorted(array, SORT_CNT)) puts("ERROR: sorted sort failed");
+	
+	// reverse sorted
+	for(uint i=0; i<SORT_CNT; i++){
+		array[i].key = SORT_CNT-i;
+		array[i].idx = i;
+	}
+	DS_sort(array, SORT_CNT, sizeof(record), &cmp_record);
+	if(!sorted(array, SORT_CNT)) puts("ERROR: reverse sort failed");
+	
+	// sawtooth of reversed runs with duplicates
+	for(uint i=0; i<SORT_CNT; i++){
+		array[i].key = (1000 - i%1000)/2;
+		array[i].idx = i;
+	}
+	DS_sort(array, SORT_CNT, sizeof(record), &cmp_record);
+	if(!sorted(array, SORT_CNT)) puts("ERROR: sawtooth sort failed");
+	
+	// small and odd sizes
+	for(uint i=0; i<SORT_CNT; i++){
+		array[i].key = i%3;
+		array[i].idx = i;
+	}
+	for(uint n=0; n<70; n++){
+		DS_sort(array, n, sizeof(record), &cmp_record);
+		if(!sorted(array, n)) puts("ERROR: small sort failed");
+	}
+	
+	for(uint64_t i=0; i<sizeof(bytes); i++) bytes[i] = (uint8_t)hash_int(&i);
+	DS_sort(bytes, sizeof(bytes)/3, 3, &cmp_bytes);
+	for(uint i=3; i<sizeof(bytes); i+=3)
+		if(bytes[i-3] > bytes[i]) puts("ERROR: odd size sort failed");
+	
+	// the parallel sort must give the same result
+	for(uint64_t i=0; i<SORT_CNT; i++){
+		array[i].key = (uint32_t)(hash_int(&i)%5000);
+		array[i].idx = (uint32_t)i;
+	}
+	memcpy(copy, array, SORT_CNT*sizeof(record));
+	DS_sort(copy, SORT_CNT, sizeof(record), &cmp_record);
+	
+	for(uint threads=1; threads<9; threads++){
+		memcpy(parallel, array, SORT_CNT*sizeof(record));
+		DS_sort_parallel(parallel, SORT_CNT, sizeof(record), &cmp_record, threads);
+		if(memcmp(parallel, copy, SORT_CNT*sizeof(record)))
+			printf("ERROR: parallel sort differs with %u threads\n", threads);
+	}
+	
+	free(array);
+	free(copy);
+	free(parallel);
+}
+
+// check that a tree holds exactly the given odd or even numbers in order
+static bool tree_ordered(DS tree, uint64_t first, uint64_t last, uint64_t step){
+	uint64_t * num = (uint64_t*) DS_first(tree);
+	
+	for(uint64_t i=first; i<=last; i+=step){
+		if(!num || *num != i) return false;
+		num = (uint64_t*) DS_next(tree);
+	}
+	return !num;
+}
+
+// exercise a balanced tree, name is used in error messages
+static void tree_tests(DS tree, const char * name){
+	uint64_t * num;
+	
+	// sorted input would make an unbalanced tree into a list
+	for(uint64_t i=0; i<TREE_CNT; i++)
+		if(!DS_insert(tree, &i)) printf("ERROR: failed %s insert\n", name);
+	for(uint64_t i=TREE_CNT*2; i-- > TREE_CNT;)
+		if(!DS_insert(tree, &i)) printf("ERROR: failed %s insert\n", name);
+	
+	if(DS_count(tree) != TREE_CNT*2) printf("ERROR: %s insert miscount\n", name);
+	if(!tree_ordered(tree, 0, TREE_CNT*2-1, 1)) printf("ERROR: %s out of order\n", name);
+	
+	for(uint64_t i=0; i<TREE_CNT*2; i++){
+		num = (uint64_t*) DS_find(tree, &i);
+		if(!num || *num != i) printf("ERROR: %s find failed\n", name);
+	}
+	
+	// remove the odd entries
+	for(uint64_t i=1; i<TREE_CNT*2; i+=2){
+		if(!DS_find(tree, &i)) continue;
+		num = (uint64_t*) DS_remove(tree);
+		if(!num || *num != i) printf("ERROR: %s removed the wrong entry\n", name);
+	}
+	
+	if(DS_count(tree) != TREE_CNT) printf("ERROR: %s remove miscount\n", name);
+	if(!tree_ordered(tree, 0, TREE_CNT*2-2, 2)) printf("ERROR: %s out of order\n", name);
+	
+	num = (uint64_t*) DS_remove_first(tree);
+	if(!num || *num != 0) printf("ERROR: %s remove first failed\n", name);
+	num = (uint64_t*) DS_remove_last(tree);
+	if(!num || *num != TREE_CNT*2-2) printf("ERROR: %s remove last failed\n", name);
+	if(!tree_ordered(tree, 2, TREE_CNT*2-4, 2)) printf("ERROR: %s out of order\n", name);
+	
+	DS_delete(tree);
+}
+
+// DS_bulk_load() the even keys, then insert the odd ones normally
+static void bulk_tests(DS tree, const char * name){
+	uint64_t * array = (uint64_t*) malloc(TREE_CNT*sizeof(uint64_t));
+	uint64_t * num;
+	
+	for(uint64_t i=0; i<TREE_CNT; i++) array[i] = i*2;
+	
+	if(DS_bulk_load(tree, array, TREE_CNT) != r_success)
+		printf("ERROR: %s bulk load failed\n", name);
+	if(DS_count(tree) != TREE_CNT) printf("ERROR: %s bulk load miscount\n", name);
+	num = (uint64_t*) DS_current(tree);
+	if(!num || *num != array[TREE_CNT-1])
+		printf("ERROR: %s bulk load current\n", name);
+	if(!tree_ordered(tree, 0, TREE_CNT*2-2, 2))
+		printf("ERROR: %s bulk load out of order\n", name);
+	
+	// the subtree sizes must be right too
+	for(uint i=0; i<TREE_CNT; i+=97){
+		num = (uint64_t*) DS_position(tree, i+1);
+		if(!num || *num != array[i]) printf("ERROR: %s bulk position\n", name);
+		if(DS_rank(tree, array+i) != i) printf("ERROR: %s bulk rank\n", name);
+	}
+	
+	for(uint64_t i=1; i<TREE_CNT*2; i+=2)
+		if(!DS_insert(tree, &i)) printf("ERROR: failed %s insert\n", name);
+	if(!tree_ordered(tree, 0, TREE_CNT*2-1, 1))
+		printf("ERROR: %s out of order after bulk load\n", name);
+	
+	// again with the nodes that were just released
+	DS_empty(tree);
+	if(DS_bulk_load(tree, array, TREE_CNT) != r_success
+		|| !tree_ordered(tree, 0, TREE_CNT*2-2, 2))
+		printf("ERROR: %s bulk reload failed\n", name);
+	
+	DS_empty(tree);
+	if(DS_bulk_load(tree, array, 0) != r_success || !DS_isempty(tree))
+		printf("ERROR: %s empty bulk load\n", name);
+	
+	free(array);
+	DS_delete(tree);
+}
+
+// turn on DS_key_prefix() for integer keys
+static DS prefixed(DS tree){
+	if(DS_key_prefix(tree, &DS_prefix_u64))
+		puts("ERROR: could not set the key prefix");
+	return tree;
+}
+
+// string keys, most of which share their first eight bytes
+static void prefix_tests(void){
+	DS    tree = DS_new_avl(24, false, &key, &cmp);
+	char  str[24] = {0};
+	char  prev[24];
+	char *found;
+	uint  i;
+	
+	if(DS_key_prefix(tree, &DS_prefix_string))
+		puts("ERROR: could not set the string prefix");
+	
+	for(i=0; i<PREFIX_CNT; i++){
+		snprintf(str, sizeof(str), i%2? "common prefix %05u" : "%05u",
+			i*7919 % PREFIX_CNT);
+		if(!DS_insert(tree, str)) puts("ERROR: failed prefix insert");
+	}
+	if(DS_insert(tree, str)) puts("ERROR: prefix tree accepted a duplicate");
+	str[0] = '\0';
+	if(!DS_insert(tree, str)) puts("ERROR: failed empty string insert");
+	
+	for(i=0; i<PREFIX_CNT; i++){
+		snprintf(str, sizeof(str), i%2? "common prefix %05u" : "%05u",
+			i*7919 % PREFIX_CNT);
+		found = (char*) DS_find(tree, str);
+		if(!found || strcmp(found, str)) puts("ERROR: prefix find failed");
+	}
+	if(DS_find(tree, "common prefix")) puts("ERROR: prefix found a missing key");
+	if(DS_find(tree, "0000")) puts("ERROR: prefix found a missing short key");
+	
+	found = (char*) DS_first(tree);
+	if(!found || found[0]) puts("ERROR: empty string is not first");
+	memcpy(prev, found? found : str, sizeof(prev));
+	for(i=1; (found = (char*) DS_next(tree)); i++){
+		if(strcmp(prev, found) >= 0) puts("ERROR: prefix tree out of order");
+		memcpy(prev, found, sizeof(prev));
+	}
+	if(i != PREFIX_CNT+1) puts("ERROR: prefix tree miscount");
+	
+	// only empty trees, and the refusals would be logged as errors
+	msg_set_verbosity(V_QUIET);
+	if(DS_key_prefix(tree, &DS_prefix_string) == r_success)
+		puts("ERROR: set the prefix of a full tree");
+	DS_delete(tree);
+	
+	tree = DS_new_list(sizeof(uint64_t));
+	if(DS_key_prefix(tree, &DS_prefix_u64) == r_success)
+		puts("ERROR: set the prefix of a list");
+	DS_delete(tree);
+	msg_set_verbosity(V_TRACE);
+}
+
+// a large key and data so that B-tree nodes hold few entries
+typedef struct {
+	uint64_t key[32];
+	uint64_t idx;
+} wide;
+
+// DS_position() and DS_rank() against the even keys 0 to 2*(RANK_CNT-1)
+static void rank_tests(DS tree, const char * name){
+	uint64_t * num, k;
+	uint       i;
+	
+	// a scattered order keeps an unbalanced tree shallow
+	for(i=0; i<RANK_CNT; i++){
+		k = (uint64_t)(i*7919 % RANK_CNT)*2;
+		if(!DS_insert(tree, &k)) printf("ERROR: failed %s insert\n", name);
+	}
+	
+	for(i=0; i<RANK_CNT; i++){
+		num = (uint64_t*) DS_position(tree, i+1);
+		if(!num || *num != (uint64_t)i*2) printf("ERROR: %s position %u\n", name, i+1);
+		if(DS_current(tree) != num) printf("ERROR: %s position current\n", name);
+		
+		k = (uint64_t)i*2;
+		if(DS_rank(tree, &k) != i) printf("ERROR: %s rank of %u\n", name, i*2);
+		k++;
+		if(DS_rank(tree, &k) != i+1) printf("ERROR: %s rank of %u\n", name, i*2+1);
+	}
+	if(DS_position(tree, 0) || DS_position(tree, RANK_CNT+1))
+		printf("ERROR: %s position out of range\n", name);
+	
+	// remove every third key, leaving 2(3m+1) and 2(3m+2)
+	for(i=0; i<RANK_CNT; i+=3){
+		k = (uint64_t)i*2;
+		if(DS_find(tree, &k)) DS_remove(tree);
+		else printf("ERROR: %s find failed\n", name);
+	}
+	
+	for(i=0; i<DS_count(tree); i++){
+		k = (uint64_t)(3*(i/2) + 1 + i%2)*2;
+		num = (uint64_t*) DS_position(tree, i+1);
+		if(!num || *num != k) printf("ERROR: %s position %u after remove\n", name, i+1);
+		if(DS_rank(tree, &k) != i) printf("ERROR: %s rank after remove\n", name);
+	}
+	
+	DS_delete(tree);
+}
+
+static imax cmp_wide(const void * left, const void * right){
+	return (*(const uint64_t*)left > *(const uint64_t*)right) -
+	       (*(const uint64_t*)left < *(const uint64_t*)right);
+}
+
+// check that duplicates stay in insertion order
+static bool wide_ordered(DS tree, uint count){
+	wide * w    = (wide*) DS_first(tree);
+	wide   prev;
+	
+	for(uint i=0; i<count; i++){
+		if(!w) return false;
+		if(i && (prev.key[0] > w->key[0] ||
+			(prev.key[0] == w->key[0] && prev.idx > w->idx)))
+			return false;
+		prev = *w;
+		w = (wide*) DS_next(tree);
+	}
+	return !w;
+}
+
+static void btree_tests(void){
+	DS       tree = DS_new_btree(sizeof(wide), sizeof(uint64_t)*32, true, &key, &cmp_wide);
+	wide     w, *found;
+	uint     count = 0;
+	uint64_t idx;
+	
+	memset(&w, 0, sizeof(wide));
+	
+	// many duplicates, deep enough to split and merge internal nodes
+	for(uint64_t i=0; i<BTREE_CNT; i++){
+		w.key[0] = hash_int(&i)%(BTREE_CNT/4);
+		w.idx    = i;
+		if(!DS_insert(tree, &w)) puts("ERROR: failed btree insert");
+	}
+	
+	if(DS_count(tree) != BTREE_CNT) puts("ERROR: btree insert miscount");
+	if(!wide_ordered(tree, BTREE_CNT)) puts("ERROR: btree out of order");
+	
+	// find returns the first of the duplicates
+	for(uint64_t i=0; i<BTREE_CNT/4; i++){
+		w.key[0] = i;
+		found = (wide*) DS_find(tree, &w);
+		if(found && found->key[0] != i) puts("ERROR: btree found the wrong key");
+		if(found && (found = (wide*) DS_previous(tree)) && found->key[0] == i)
+			puts("ERROR: btree find missed a duplicate");
+	}
+	
+	// walk backwards
+	found = (wide*) DS_last(tree);
+	while(found){
+		count++;
+		found = (wide*) DS_previous(tree);
+	}
+	if(count != BTREE_CNT) puts("ERROR: btree reverse traversal miscount");
+	
+	// remove every other entry while walking forward
+	DS_first(tree);
+	for(uint i=0; i<BTREE_CNT; i++){
+		found = (wide*) DS_current(tree);
+		if(i&1){
+			idx = found->idx;
+			if(((const wide*)DS_remove(tree))->idx != idx)
+				puts("ERROR: btree removed the wrong entry");
+		}
+		else DS_next(tree);
+	}
+	
+	if(DS_count(tree) != BTREE_CNT/2) puts("ERROR: btree remove miscount");
+	if(!wide_ordered(tree, BTREE_CNT/2)) puts("ERROR: btree out of order");
+	
+	// remove the rest by key
+	for(uint64_t i=0; i<BTREE_CNT; i++){
+		w.key[0] = hash_int(&i)%(BTREE_CNT/4);
+		if(!DS_find(tree, &w)) continue;
+		found = (wide*) DS_remove(tree);
+		if(!found || found->key[0] != w.key[0])
+			puts("ERROR: btree removed the wrong key");
+	}
+	
+	if(!DS_isempty(tree)) puts("ERROR: empty btree is not empty");
+	if(DS_first(tree)) puts("ERROR: empty btree has a first entry");
+	
+	DS_delete(tree);
+}
+
+// exercise a list type, name is used in error messages
+static void sequence_tests(DS seq, const char * name){
+	int * num;
+	int   val;
+	
+	if(!DS_isempty(seq)) printf("ERROR: empty %s reports entries\n", name);
+	if(DS_pop(seq)) printf("ERROR: popped an empty %s\n", name);
+	
+	// stack
+	for(int i=0; i<ARRAY_CNT; i++)
+		if(!DS_push(seq, &i)) printf("ERROR: failed %s push\n", name);
+	for(int i=ARRAY_CNT; i--;){
+		num = (int*) DS_pop(seq);
+		if(!num || *num != i) printf("ERROR: %s pop out of order\n", name);
+	}
+	if(!DS_isempty(seq)) printf("ERROR: popped %s is not empty\n", name);
+	
+	// queue
+	for(int i=0; i<ARRAY_CNT; i++)
+		if(!DS_nq(seq, &i)) printf("ERROR: failed %s enqueue\n", name);
+	for(int i=0; i<ARRAY_CNT/2; i++){
+		num = (int*) DS_dq(seq);
+		if(!num || *num != i) printf("ERROR: %s dequeue out of order\n", name);
+		val = i+ARRAY_CNT;
+		DS_nq(seq, &val);
+	}
+	
+	// random access
+	for(uint i=1; i<=ARRAY_CNT; i++){
+		num = (int*) DS_position(seq, i);
+		if(!num || *num != (int)i-1+ARRAY_CNT/2)
+			printf("ERROR: %s position failed\n", name);
+	}
+	if(DS_position(seq, ARRAY_CNT+1)) printf("ERROR: %s position past the end\n", name);
+	
+	// insert and remove in the middle
+	val = -1;
+	DS_position(seq, ARRAY_CNT/4);
+	if(!DS_insert(seq, &val)) printf("ERROR: failed %s insert\n", name);
+	num = (int*) DS_next(seq);
+	if(!num || *num != ARRAY_CNT/4-1+ARRAY_CNT/2)
+		printf("ERROR: %s insert did not shift\n", name);
+	DS_position(seq, ARRAY_CNT/4);
+	num = (int*) DS_remove(seq);
+	if(!num || *num != -1) printf("ERROR: %s removed the wrong entry\n", name);
+	num = (int*) DS_current(seq);
+	if(!num || *num != ARRAY_CNT/4-1+ARRAY_CNT/2)
+		printf("ERROR: %s remove left current in the wrong place\n", name);
+	if(DS_count(seq) != ARRAY_CNT) printf("ERROR: %s miscount\n", name);
+	
+	num = (int*) DS_first(seq);
+	for(int i=ARRAY_CNT/2; num; i++){
+		if(*num != i) printf("ERROR: %s traversal out of order\n", name);
+		num = (int*) DS_next(seq);
+	}
+}
+
+// remove every other entry from the back, then twice more from the front
+static void thin_tests(DS seq, const char * name){
+	int * num;
+	int   val;
+	
+	for(uint i=ARRAY_CNT; i>1; i-=2){
+		DS_position(seq, i);
+		DS_remove(seq);
+	}
+	for(uint round=0; round<2; round++)
+		for(uint i=2; i<=DS_count(seq); i++){
+			num = (int*) DS_position(seq, i+1);
+			val = num? *num : -1;
+			DS_position(seq, i);
+			DS_remove(seq);
+			num = (int*) DS_current(seq);
+			if(val >= 0 && (!num || *num != val))
+				printf("ERROR: %s remove lost the current position\n", name);
+		}
+	if(DS_count(seq) != ARRAY_CNT/8)
+		printf("ERROR: %s thinned miscount\n", name);
+	
+	num = (int*) DS_first(seq);
+	for(int i=ARRAY_CNT/2; num; i+=8){
+		if(*num != i) printf("ERROR: %s thinned out of order\n", name);
+		num = (int*) DS_next(seq);
+	}
+}
+
+// a large record that is linked into two structures at once
+typedef struct {
+	uint64_t key;
+	DS_hook  by_order;
+	DS_hook  by_key;
+	char     payload[200];
+} linked;
+
+static const void * linked_key(const void * data){
+	return &((const linked*)data)->key;
+}
+
+static imax cmp_linked(const void * left, const void * right){
+	return cmp_u64(linked_key(left), linked_key(right));
+}
+
+// intrusive structures must hand back the caller's records themselves
+static void intrusive_tests(void){
+	linked * recs = (linked*) calloc(LINKED_CNT, sizeof(linked));
+	linked * rec;
+	DS       list = DS_new_list(sizeof(linked));
+	DS       tree = DS_new_avl(sizeof(linked), false, &linked_key, &cmp_u64);
+	DS       heap = DS_new_heap(sizeof(linked), &cmp_linked);
+	uint64_t k;
+	
+	if(DS_intrusive(list, offsetof(linked, by_order))
+		|| DS_intrusive(tree, offsetof(linked, by_key))
+		|| DS_intrusive(heap, 0))
+		puts("ERROR: failed to make structures intrusive");
+	
+	for(uint64_t i=0; i<LINKED_CNT; i++){
+		recs[i].key = i*7919 % LINKED_CNT;
+		if(DS_insert_last(list, recs+i) != recs+i
+			|| DS_insert(tree, recs+i) != recs+i
+			|| DS_insert(heap, recs+i) != recs+i)
+			puts("ERROR: intrusive insert did not link the record");
+	}
+	if(DS_insert(tree, recs)) puts("ERROR: intrusive tree inserted a dup");
+	
+	rec = (linked*) DS_first(list);
+	for(uint i=0; i<LINKED_CNT; i++){
+		if(rec != recs+i) puts("ERROR: intrusive list out of order");
+		rec = (linked*) DS_next(list);
+	}
+	
+	for(k=0; k<LINKED_CNT; k++){
+		rec = (linked*) DS_find(tree, &k);
+		if(!rec || rec->key != k || rec != DS_position(tree, (uint)k+1))
+			puts("ERROR: intrusive tree find failed");
+	}
+	
+	// take the even keys out of the tree, the list keeps every record
+	for(k=0; k<LINKED_CNT; k+=2)
+		if(!DS_find(tree, &k) || ((const linked*)DS_remove(tree))->key != k)
+			puts("ERROR: intrusive tree removed the wrong record");
+	rec = (linked*) DS_first(tree);
+	for(k=1; k<LINKED_CNT; k+=2){
+		if(!rec || rec->key != k) puts("ERROR: intrusive tree out of order");
+		rec = (linked*) DS_next(tree);
+	}
+	if(DS_count(list) != LINKED_CNT) puts("ERROR: intrusive list miscount");
+	
+	for(k=0; k<LINKED_CNT; k++){
+		rec = (linked*) DS_remove(heap);
+		if(!rec || rec->key != k) puts("ERROR: intrusive heap out of order");
+	}
+	
+	if(DS_remove_first(list) != recs || DS_remove_last(list) != recs+LINKED_CNT-1)
+		puts("ERROR: intrusive list removed the wrong record");
+	
+	// the records belong to the caller, so this must not free them
+	DS_delete(list);
+	DS_delete(tree);
+	DS_delete(heap);
+	
+	list = DS_new_circular(sizeof(linked));
+	if(DS_intrusive(list, offsetof(linked, by_order)))
+		puts("ERROR: failed to make a circular list intrusive");
+	for(uint i=0; i<3; i++) DS_insert(list, recs+i);
+	rec = (linked*) DS_current(list);
+	for(uint i=0; i<6; i++) rec = (linked*) DS_next(list);
+	if(rec != recs+2) puts("ERROR: intrusive circular list lost its way");
+	DS_delete(list);
+	
+	free(recs);
+}
+
+// check a pairing heap against the values it should still hold
+static void pairing_drain(DS heap, const uint64_t * vals, const bool * gone){
+	uint64_t * num;
+	uint64_t   prev = 0;
+	uint       left = 0;
+	
+	for(uint i=0; i<PAIRING_CNT; i++) if(!gone[i]) left++;
+	if(DS_count(heap) != left) puts("ERROR: pairing heap miscount");
+	
+	// the low bits are the insertion order, so equal keys make it strictly rise
+	for(uint i=0; i<left; i++){
+		num = (uint64_t*) DS_first(heap);
+		if(!num || num != DS_remove(heap)){
+			puts("ERROR: pairing heap top is not removed");
+			break;
+		}
+		if((i && *num <= prev) || vals[*num & 0xfffff] != *num)
+			puts("ERROR: pairing heap out of order");
+		prev = *num;
+	}
+	if(!DS_isempty(heap) || DS_first(heap))
+		puts("ERROR: drained pairing heap is not empty");
+}
+
+static void pairing_tests(void){
+	DS         heap    = DS_new_pairing_heap(sizeof(uint64_t), &cmp_int);
+	uint64_t * handles[PAIRING_CNT];
+	uint64_t   vals   [PAIRING_CNT];
+	bool       gone   [PAIRING_CNT];
+	linked *   recs    = (linked*) calloc(PAIRING_CNT, sizeof(linked));
+	linked *   rec;
+	
+	for(uint64_t i=0; i<PAIRING_CNT; i++){
+		vals[i] = (hash_int(&i) % 1000)<<20 | i;
+		gone[i] = false;
+		if(!( handles[i] = (uint64_t*) DS_insert(heap, vals+i) )
+			|| *handles[i] != vals[i])
+			puts("ERROR: failed pairing heap insert");
+	}
+	
+	// move some entries up and some down, and take others out of the middle
+	for(uint64_t i=0; i<PAIRING_CNT; i++){
+		if(i%3 == 0){
+			vals[i] = *handles[i] = (i*7 % 2000)<<20 | i;
+			if(DS_heap_update(heap, handles[i]))
+				puts("ERROR: pairing heap update failed");
+		}
+		else if(i%5 == 0){
+			if(DS_heap_remove(heap, handles[i]) != handles[i]
+				|| *handles[i] != vals[i])
+				puts("ERROR: pairing heap removed the wrong entry");
+			gone[i] = true;
+		}
+	}
+	pairing_drain(heap, vals, gone);
+	
+	// emptying must release the nodes, and the heap must still work after
+	for(uint64_t i=0; i<PAIRING_CNT; i++) DS_insert(heap, &i);
+	DS_empty(heap);
+	for(uint64_t i=0; i<PAIRING_CNT; i++){
+		gone[i] = false;
+		handles[i] = (uint64_t*) DS_insert(heap, vals+i);
+	}
+	for(uint i=0; i<PAIRING_CNT; i+=2){
+		DS_heap_remove(heap, handles[i]);
+		gone[i] = true;
+	}
+	pairing_drain(heap, vals, gone);
+	for(uint64_t i=0; i<PAIRING_CNT; i++) DS_insert(heap, &i);
+	DS_delete(heap);
+	
+	// the handle of an intrusive entry is the record
+	heap = DS_new_pairing_heap(sizeof(linked), &cmp_linked);
+	if(DS_intrusive(heap, offsetof(linked, by_key)))
+		puts("ERROR: failed to make a pairing heap intrusive");
+	for(uint64_t i=0; i<PAIRING_CNT; i++){
+		recs[i].key = i*7919 % PAIRING_CNT + PAIRING_CNT;
+		if(DS_insert(heap, recs+i) != recs+i)
+			puts("ERROR: intrusive pairing heap did not link the record");
+	}
+	for(uint64_t i=0; i<PAIRING_CNT; i+=2){
+		recs[i].key -= PAIRING_CNT;
+		if(DS_heap_update(heap, recs+i))
+			puts("ERROR: intrusive pairing heap update failed");
+	}
+	for(uint64_t i=1; i<PAIRING_CNT; i+=4)
+		if(DS_heap_remove(heap, recs+i) != recs+i)
+			puts("ERROR: intrusive pairing heap removed the wrong record");
+	
+	for(uint64_t i=0; i<PAIRING_CNT/2; i++){
+		rec = (linked*) DS_remove(heap);
+		if(!rec || rec->key != i*2 || (rec-recs) % 2)
+			puts("ERROR: intrusive pairing heap out of order");
+	}
+	if(DS_count(heap) != PAIRING_CNT/4)
+		puts("ERROR: intrusive pairing heap miscount");
+	
+	// the records belong to the caller, so this must not free them
+	DS_delete(heap);
+	free(recs);
+	
+	heap = DS_new_heap(sizeof(uint64_t), &cmp_int);
+	msg_set_verbosity(V_QUIET);
+	if(DS_heap_update(heap, vals) == r_success || DS_heap_remove(heap, vals))
+		puts("ERROR: array heap accepted a handle");
+	msg_set_verbosity(V_TRACE);
+	DS_delete(heap);
+}
+
+// heaps of every arity must come out in order, and equal keys first-in-first-out
+static void arity_tests(void){
+	static const uint arities[] = {2, 3, 4, 8};
+	uint64_t  array[ARITY_CNT], val, prev;
+	uint8_t * fat = (uint8_t*) malloc(ARITY_CNT*FAT_SZ);
+	DS        heap;
+	
+	for(uint a=0; a<sizeof(arities)/sizeof(uint); a++){
+		for(uint64_t i=0; i<ARITY_CNT; i++){
+			array[i]     = hash_int(&i);
+			fat[i*FAT_SZ] = (uint8_t)array[i];
+		}
+		DS_heapify_arity(array, ARITY_CNT, sizeof(uint64_t), &cmp_array_u64,
+			arities[a]);
+		DS_heapify_arity(fat, ARITY_CNT, FAT_SZ, &cmp_bytes, arities[a]);
+		for(uint i=1; i<ARITY_CNT; i++)
+			if(array[(i-1)/arities[a]] > array[i]
+				|| fat[(i-1)/arities[a]*FAT_SZ] > fat[i*FAT_SZ])
+				printf("ERROR: %u-ary heapify failed\n", arities[a]);
+		
+		heap = DS_new_heap(sizeof(uint64_t), &cmp_int);
+		if(DS_heap_arity(heap, arities[a]))
+			printf("ERROR: failed to set a heap arity of %u\n", arities[a]);
+		
+		// the low bits are not compared, they record the insertion order
+		for(uint64_t i=0; i<ARITY_CNT; i++){
+			val = (hash_int(&i) % 100)<<20 | i;
+			if(!DS_insert(heap, &val))
+				printf("ERROR: failed %u-ary heap insert\n", arities[a]);
+		}
+		for(uint64_t i=0; i<ARITY_CNT/2; i++)
+			DS_swap(heap, &(uint64_t){(hash_int(&i) % 100 + 50)<<20
+				| (ARITY_CNT+i)});
+		
+		prev = 0;
+		for(uint i=0; i<ARITY_CNT; i++){
+			val = *(const uint64_t*) DS_remove(heap);
+			if(val>>20 < prev>>20 || (val>>20 == prev>>20 && val <= prev && i))
+				printf("ERROR: %u-ary heap out of order\n", arities[a]);
+			prev = val;
+		}
+		if(!DS_isempty(heap)) printf("ERROR: %u-ary heap not empty\n", arities[a]);
+		DS_delete(heap);
+	}
+	
+	heap = DS_new_heap(sizeof(uint64_t), &cmp_int);
+	DS_insert(heap, array);
+	msg_set_verbosity(V_QUIET);
+	if(DS_heap_arity(heap, 8) == r_success) puts("ERROR: reshaped a full heap");
+	DS_empty(heap);
+	if(DS_heap_arity(heap, 1) == r_success) puts("ERROR: accepted an arity of 1");
+	msg_set_verbosity(V_TRACE);
+	DS_delete(heap);
+	free(fat);
+}
+
+// a record much larger than its key, the payload repeats the low key bits
+typedef struct {
+	uint64_t key;
+	uint8_t  payload[120];
+} bulky;
+
+static bool bulky_intact(const bulky * rec){
+	for(uint i=0; i<sizeof(rec->payload); i++)
+		if(rec->payload[i] != (uint8_t)rec->key) return false;
+	return true;
+}
+
+// keyed heaps sift copies of the keys, the records themselves must stay put
+static void keyed_tests(void){
+	const bulky * handles[KEYED_CNT], * rec, * last;
+	bulky         data;
+	uint64_t      prev;
+	DS            heap = DS_new_keyed_heap(sizeof(bulky), sizeof(uint64_t), &key,
+		&cmp_int);
+	
+	for(uint round=0; round<2; round++){
+		for(uint64_t i=0; i<KEYED_CNT; i++){
+			data.key = (hash_int(&i) % 100)<<20 | i;
+			memset(data.payload, (uint8_t)data.key, sizeof(data.payload));
+			if(!( handles[i] = (const bulky*) DS_insert(heap, &data) ))
+				puts("ERROR: failed keyed heap insert");
+		}
+		for(uint i=0; i<KEYED_CNT; i++)
+			if((handles[i]->key & 0xfffff) != i || !bulky_intact(handles[i])){
+				puts("ERROR: keyed heap moved a record");
+				break;
+			}
+		
+		// replace half with later keys, the old top survives the swap
+		for(uint64_t i=0; i<KEYED_CNT/2; i++){
+			data.key = (hash_int(&i) % 100 + 50)<<20 | (KEYED_CNT+i);
+			memset(data.payload, (uint8_t)data.key, sizeof(data.payload));
+			rec = (const bulky*) DS_swap(heap, &data);
+			if(!rec || !bulky_intact(rec) || ((rec->key & 0xfffff) < KEYED_CNT
+				&& rec != handles[rec->key & 0xfffff]))
+				puts("ERROR: keyed heap swap lost a record");
+		}
+		
+		// a removed record stays intact until the next insertion
+		prev = 0;
+		last = NULL;
+		for(uint i=0; i<KEYED_CNT; i++){
+			rec = (const bulky*) DS_remove(heap);
+			if(!rec || !bulky_intact(rec) || (last && !bulky_intact(last))
+				|| rec->key>>20 < prev>>20
+				|| (i && rec->key>>20 == prev>>20 && rec->key <= prev)
+			){
+				puts("ERROR: keyed heap out of order");
+				break;
+			}
+			prev = rec->key;
+			last = rec;
+		}
+		if(!DS_isempty(heap)) puts("ERROR: keyed heap not empty");
+		
+		// the second round reuses every payload of the first
+		DS_empty(heap);
+	}
+	
+	if(DS_heap_arity(heap, 2)) puts("ERROR: failed to reshape a keyed heap");
+	for(uint64_t i=0; i<KEYED_CNT; i++) DS_insert(heap, &data);
+	DS_empty(heap);
+	DS_flush(heap);
+	for(uint64_t i=0; i<KEYED_CNT; i++) DS_insert(heap, &data);
+	
+	msg_set_verbosity(V_QUIET);
+	if(DS_intrusive(heap, 0) == r_success) puts("ERROR: keyed heap intrusive");
+	if(DS_new_keyed_heap(sizeof(bulky), 0, &key, &cmp_int))
+		puts("ERROR: accepted an empty key");
+	msg_set_verbosity(V_TRACE);
+	DS_delete(heap);
+}
+
+// how to compare a reloaded structure with the original
+typedef enum {SNAP_WALK, SNAP_FIND, SNAP_POP} snap_check;
+
+// DS_save() orig and DS_load() it into the empty copy, then delete both
+static void snap_tests(DS orig, DS copy, snap_check check, const char * name){
+	DS_cursor mine, theirs;
+	uint64_t  k, *num, *other;
+	
+	for(uint64_t i=0; i<SNAP_CNT; i++){
+		k = i*7919 % SNAP_CNT;
+		if(!DS_insert(orig, &k)) printf("ERROR: failed %s insert\n", name);
+	}
+	
+	if(DS_save(orig, SNAP_PATH)) printf("ERROR: %s save failed\n", name);
+	if(DS_load(copy, SNAP_PATH)) printf("ERROR: %s load failed\n", name);
+	if(DS_count(copy) != SNAP_CNT) printf("ERROR: %s load miscount\n", name);
+	
+	switch(check){
+	case SNAP_WALK: // the same entries in the same order
+		mine   = DS_cursor_new(orig);
+		theirs = DS_cursor_new(copy);
+		for(uint i=0; i<SNAP_CNT; i++){
+			num   = (uint64_t*)(i? DS_cursor_next(mine) : DS_cursor_first(mine));
+			other = (uint64_t*)(i? DS_cursor_next(theirs) :
+				DS_cursor_first(theirs));
+			if(!num || !other || *num != *other){
+				printf("ERROR: %s reloaded out of order\n", name);
+				break;
+			}
+		}
+		DS_cursor_delete(mine);
+		DS_cursor_delete(theirs);
+		break;
+	
+	case SNAP_FIND:
+		for(uint64_t i=0; i<SNAP_CNT; i++){
+			num = (uint64_t*) DS_find(copy, &i);
+			if(!num || *num != i) printf("ERROR: %s reload lost %lu\n", name, i);
+		}
+		break;
+	
+	case SNAP_POP:
+		for(uint64_t i=0; i<SNAP_CNT; i++){
+			num = (uint64_t*) DS_first(copy);
+			if(!num || *num != i) printf("ERROR: %s reloaded out of order\n", name);
+			DS_remove(copy);
+		}
+		break;
+	
+	default: puts("ERROR: bad snapshot check");
+	}
+	
+	DS_delete(orig);
+	DS_delete(copy);
+}
+
+// snapshots that must be refused, with the errors they log silenced
+static void snap_fail_tests(void){
+	DS       tree = DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64);
+	DS       copy = DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64);
+	DS       list = DS_new_list(sizeof(uint64_t));
+	DS       narrow = DS_new_avl(sizeof(uint32_t), false, &key, &cmp_u64);
+	FILE *   file;
+	uint64_t k;
+	
+	for(k=0; k<SNAP_CNT; k++) DS_insert(tree, &k);
+	if(DS_save(tree, SNAP_PATH)) puts("ERROR: avl save failed");
+	
+	msg_set_verbosity(V_QUIET);
+	if(DS_load(list, SNAP_PATH) == r_success) puts("ERROR: loaded the wrong type");
+	if(DS_load(narrow, SNAP_PATH) == r_success) puts("ERROR: loaded the wrong size");
+	if(DS_load(tree, SNAP_PATH) == r_success) puts("ERROR: loaded a full tree");
+	
+	// damage the last entry
+	file = fopen(SNAP_PATH, "r+b");
+	if(!file || fseek(file, -1, SEEK_END) || fputc(0x40, file) == EOF
+		|| fclose(file))
+		puts("ERROR: could not damage the snapshot");
+	if(DS_load(copy, SNAP_PATH) == r_success)
+		puts("ERROR: loaded a damaged snapshot");
+	if(!DS_isempty(copy)) puts("ERROR: failed load left entries");
+	
+	if(DS_load(copy, "no such file") == r_success)
+		puts("ERROR: loaded a missing file");
+	msg_set_verbosity(V_TRACE);
+	
+	remove(SNAP_PATH);
+	DS_delete(tree);
+	DS_delete(copy);
+	DS_delete(list);
+	DS_delete(narrow);
+}
+
+// nodes from an arena must survive emptying and refilling the structure
+static void arena_tests(void){
+	DS tree = DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64);
+	DS list = DS_new_unrolled(sizeof(int));
+	
+	if(DS_arena(tree, 0) || DS_arena(list, 4096))
+		puts("ERROR: failed to set an arena");
+	
+	for(uint64_t i=0; i<TREE_CNT; i++) DS_insert(tree, &i);
+	DS_empty(tree);
+	if(!DS_isempty(tree) || DS_first(tree)) puts("ERROR: arena tree not empty");
+	
+	DS_flush(tree);
+	if(DS_arena(tree, 1<<20)) puts("ERROR: failed to reset an arena");
+	
+	tree_tests(tree, "arena avl");
+	sequence_tests(list, "arena unrolled");
+	
+	DS_empty(list);
+	sequence_tests(list, "refilled arena unrolled");
+	DS_delete(list);
+}
+
+static void array_tests(void){
+	DS    array = DS_new_array(sizeof(int));
+	int * buffer;
+	
+	sequence_tests(array, "array");
+	
+	// the buffer can be used directly
+	buffer = (int*) DS_buffer(array);
+	for(int i=0; i<ARRAY_CNT; i++)
+		if(buffer[i] != i+ARRAY_CNT/2) puts("ERROR: array buffer out of order");
+	
+	for(uint64_t i=0; i<ARRAY_CNT; i++) buffer[i] = (int)(hash_int(&i)%1000);
+	DS_heapify(buffer, DS_count(array), sizeof(int), &cmp_array);
+	for(int i=1; i<ARRAY_CNT; i++)
+		if(buffer[(i-1)/2] > buffer[i]) puts("ERROR: array heapify failed");
+	DS_sort(buffer, DS_count(array), sizeof(int), &cmp_array);
+	for(int i=1; i<ARRAY_CNT; i++)
+		if(buffer[i-1] > buffer[i]) puts("ERROR: array sort failed");
+	
+	DS_flush(array);
+	if(DS_count(array) != ARRAY_CNT || !DS_last(array))
+		puts("ERROR: array flush lost entries");
+	
+	DS_empty(array);
+	if(DS_buffer(array)) puts("ERROR: empty array has a buffer");
+	
+	DS_delete(array);
+}
+struct queue_job{
+	DS            queue;
+	uint8_t *     seen;
+	atomic_size_t done;
+	atomic_size_t failed;
+};
+
+static void * producer(void * arg){
+	struct queue_job * job = (struct queue_job*) arg;
+	static atomic_uint next_id;
+	uint64_t           num, id = atomic_fetch_add(&next_id, 1);
+	
+	for(uint64_t i=0; i<QUEUE_CNT; i++){
+		num = id*QUEUE_CNT + i;
+		while(!DS_try_nq(job->queue, &num)) sched_yield();
+	}
+	return NULL;
+}
+
+static void * consumer(void * arg){
+	struct queue_job * job = (struct queue_job*) arg;
+	uint64_t           num, last[QUEUE_THR];
+	
+	for(uint i=0; i<QUEUE_THR; i++) last[i] = UINT64_MAX;
+	
+	while(atomic_load(&job->done) < QUEUE_THR*QUEUE_CNT){
+		if(!DS_try_dq(job->queue, &num)){
+			sched_yield();
+			continue;
+		}
+		atomic_fetch_add(&job->done, 1);
+		
+		// each producer's entries must come out in order
+		if(last[num/QUEUE_CNT] != UINT64_MAX && last[num/QUEUE_CNT] >= num)
+			atomic_fetch_add(&job->failed, 1);
+		last[num/QUEUE_CNT] = num;
+		job->seen[num]++;
+	}
+	return NULL;
+}
+
+static void queue_tests(void){
+	struct queue_job job;
+	pthread_t        tid[QUEUE_THR*2];
+	uint64_t         num, cnt;
+	
+	job.queue = DS_new_mpmc_queue(sizeof(uint64_t), 100);
+	
+	// single threaded, the capacity rounds up to 128
+	for(cnt=0; DS_try_nq(job.queue, &cnt); cnt++);
+	if(cnt != 128 || DS_count(job.queue) != 128) puts("ERROR: queue capacity");
+	for(uint64_t i=0; i<cnt; i++)
+		if(!DS_try_dq(job.queue, &num) || num != i) puts("ERROR: queue order");
+	if(!DS_isempty(job.queue) || DS_try_dq(job.queue, &num))
+		puts("ERROR: queue not empty");
+	
+	num = 7;
+	DS_try_nq(job.queue, &num);
+	DS_empty(job.queue);
+	if(DS_count(job.queue) || DS_try_dq(job.queue, &num))
+		puts("ERROR: queue empty failed");
+	
+	// several producers and consumers through a small ring
+	job.seen = (uint8_t*) calloc(QUEUE_THR*QUEUE_CNT, 1);
+	atomic_init(&job.done, 0);
+	atomic_init(&job.failed, 0);
+	
+	for(uint i=0; i<QUEUE_THR; i++){
+		pthread_create(tid+i, NULL, &producer, &job);
+		pthread_create(tid+QUEUE_THR+i, NULL, &consumer, &job);
+	}
+	for(uint i=0; i<QUEUE_THR*2; i++) pthread_join(tid[i], NULL);
+	
+	if(atomic_load(&job.failed)) puts("ERROR: queue reordered a producer");
+	for(size_t i=0; i<QUEUE_THR*QUEUE_CNT; i++)
+		if(job.seen[i] != 1){
+			puts("ERROR: queue lost or duplicated an entry");
+			break;
+		}
+	if(!DS_isempty(job.queue)) puts("ERROR: queue not empty");
+	
+	free(job.seen);
+	DS_delete(job.queue);
+	
+	// sizes that can not be allocated fail instead of wrapping around
+	msg_set_verbosity(V_QUIET);
+	if(DS_new_mpmc_queue(sizeof(uint64_t), SIZE_MAX)
+		|| DS_new_mpmc_queue(sizeof(uint64_t), SIZE_MAX/8)
+		|| DS_new_spsc_queue(sizeof(uint64_t), SIZE_MAX/4)
+		|| DS_new_sync_hash(sizeof(uint64_t), SIZE_MAX, &hash_int)
+		|| DS_new_hash(sizeof(uint64_t), SIZE_MAX, false, &hash_int))
+		puts("ERROR: accepted an impossible capacity");
+	msg_set_verbosity(V_TRACE);
+}
+
+static void * ring_producer(void * arg){
+	uint64_t batch[RING_BATCH];
+	uint64_t next = 0, done;
+	
+	while(next < RING_CNT){
+		// vary the batch size so that runs wrap the ring at every offset
+		done = next%RING_BATCH + 1;
+		if(done > RING_CNT-next) done = RING_CNT-next;
+		for(uint64_t i=0; i<done; i++) batch[i] = next+i;
+		
+		done = DS_nq_batch((DS)arg, batch, done);
+		if(!done) sched_yield();
+		next += done;
+	}
+	return NULL;
+}
+
+static void ring_tests(void){
+	DS        ring = DS_new_spsc_queue(sizeof(uint64_t), 60);
+	pthread_t tid;
+	uint64_t  batch[RING_BATCH], next = 0, got;
+	
+	// single threaded, the capacity rounds up to 64
+	for(uint64_t i=0; i<RING_BATCH; i++) batch[i] = i;
+	if(DS_nq_batch(ring, batch, RING_BATCH) != RING_BATCH)
+		puts("ERROR: ring batch enqueue");
+	if(DS_nq_batch(ring, batch, RING_BATCH) != 64-RING_BATCH)
+		puts("ERROR: ring overfilled");
+	if(DS_try_nq(ring, batch)) puts("ERROR: ring overfilled");
+	if(DS_count(ring) != 64) puts("ERROR: ring miscount");
+	
+	if(DS_dq_batch(ring, batch, RING_BATCH) != RING_BATCH)
+		puts("ERROR: ring batch dequeue");
+	for(uint64_t i=0; i<RING_BATCH; i++)
+		if(batch[i] != i) puts("ERROR: ring out of order");
+	if(!DS_try_dq(ring, &got) || got != 0) puts("ERROR: ring out of order");
+	
+	DS_empty(ring);
+	if(!DS_isempty(ring) || DS_dq_batch(ring, batch, RING_BATCH))
+		puts("ERROR: ring empty failed");
+	
+	// one producer and one consumer
+	pthread_create(&tid, NULL, &ring_producer, ring);
+	while(next < RING_CNT){
+		got = DS_dq_batch(ring, batch, next%RING_BATCH + 1);
+		if(!got) sched_yield();
+		for(uint64_t i=0; i<got; i++)
+			if(batch[i] != next+i){
+				puts("ERROR: ring out of order");
+				break;
+			}
+		next += got;
+	}
+	pthread_join(tid, NULL);
+	
+	if(!DS_isempty(ring)) puts("ERROR: ring not empty");
+	DS_delete(ring);
+}
+
+struct deque_job{
+	DS          deque;
+	uint8_t *   seen;
+	atomic_bool finished;
+	int8_t      pad[sizeof(void*)-sizeof(atomic_bool)];
+};
+
+static void * thief(void * arg){
+	struct deque_job * job = (struct deque_job*) arg;
+	uint64_t           num;
+	
+	while(!atomic_load(&job->finished) || !DS_isempty(job->deque)){
+		if(DS_steal(job->deque, &num)) job->seen[num]++;
+		else sched_yield();
+	}
+	return NULL;
+}
+
+static void deque_tests(void){
+	struct deque_job job;
+	pthread_t        tid[DEQUE_THIEF];
+	uint64_t         num;
+	
+	job.deque = DS_new_ws_deque(sizeof(uint64_t));
+	
+	// the owner sees a stack, thieves see a queue
+	for(uint64_t i=0; i<1000; i++)
+		if(!DS_push_bottom(job.deque, &i)) puts("ERROR: deque push failed");
+	if(DS_count(job.deque) != 1000) puts("ERROR: deque miscount");
+	for(uint64_t i=0; i<500; i++)
+		if(!DS_steal(job.deque, &num) || num != i) puts("ERROR: deque steal order");
+	for(uint64_t i=1000; i-- > 500;)
+		if(!DS_pop_bottom(job.deque, &num) || num != i) puts("ERROR: deque pop order");
+	if(DS_pop_bottom(job.deque, &num) || DS_steal(job.deque, &num))
+		puts("ERROR: deque not empty");
+	
+	DS_flush(job.deque);
+	num = 5;
+	if(!DS_push_bottom(job.deque, &num) || !DS_pop_bottom(job.deque, &num)
+		|| num != 5)
+		puts("ERROR: deque push after flush");
+	
+	// the owner works through its tasks while thieves take from the top
+	job.seen = (uint8_t*) calloc(DEQUE_CNT, 1);
+	atomic_init(&job.finished, false);
+	for(uint i=0; i<DEQUE_THIEF; i++)
+		pthread_create(tid+i, NULL, &thief, &job);
+	
+	for(uint64_t i=0; i<DEQUE_CNT; i++){
+		if(!DS_push_bottom(job.deque, &i)) puts("ERROR: deque push failed");
+		if(i%3 == 0 && DS_pop_bottom(job.deque, &num)) job.seen[num]++;
+	}
+	while(DS_pop_bottom(job.deque, &num)) job.seen[num]++;
+	
+	atomic_store(&job.finished, true);
+	for(uint i=0; i<DEQUE_THIEF; i++) pthread_join(tid[i], NULL);
+	
+	for(size_t i=0; i<DEQUE_CNT; i++)
+		if(job.seen[i] != 1){
+			puts("ERROR: deque lost or duplicated an entry");
+			break;
+		}
+	
+	free(job.seen);
+	DS_delete(job.deque);
+}
+
+struct sync_entry{
+	uint64_t key;
+	uint64_t round;
+	uint64_t check; // key^round, a torn copy would not match
+};
+
+struct sync_job{
+	DS          map;
+	atomic_uint failed;
+	atomic_bool finished;
+	int8_t      pad[sizeof(void*)-sizeof(atomic_uint)-sizeof(atomic_bool)];
+};
+
+static void * sync_writer(void * arg){
+	struct sync_job * job = (struct sync_job*) arg;
+	static atomic_uint next_id;
+	struct sync_entry e;
+	uint64_t          first = atomic_fetch_add(&next_id, 1)*SYNC_CNT;
+	
+	// odd keys come and go, even keys stay
+	for(e.round=1; e.round<=SYNC_ROUND; e.round++)
+		for(e.key=first; e.key<first+SYNC_CNT; e.key++){
+			e.check = e.key^e.round;
+			if(e.key&1 && e.round&1) DS_sync_remove(job->map, &e, NULL);
+			else if(!DS_sync_insert(job->map, &e))
+				atomic_fetch_add(&job->failed, 1);
+		}
+	return NULL;
+}
+
+static void * sync_reader(void * arg){
+	struct sync_job * job = (struct sync_job*) arg;
+	struct sync_entry e;
+	uint64_t          key;
+	
+	for(uint64_t i=0; !atomic_load(&job->finished); i++){
+		key = hash_int(&i) % (SYNC_THR*SYNC_CNT);
+		if(DS_sync_find(job->map, &key, &e)
+			&& (e.key != key || e.check != (e.key^e.round)))
+			atomic_fetch_add(&job->failed, 1);
+	}
+	return NULL;
+}
+
+static void sync_tests(void){
+	struct sync_job   job;
+	struct sync_entry e;
+	pthread_t         tid[SYNC_THR*2];
+	
+	job.map = DS_new_sync_hash(sizeof(struct sync_entry), 4, &hash_int);
+	
+	// single threaded, inserting an existing key replaces the entry
+	for(e.key=0; e.key<SYNC_CNT; e.key++){
+		e.round = 0;
+		if(!DS_sync_insert(job.map, &e)) puts("ERROR: sync insert failed");
+		e.round = 1;
+		if(!DS_sync_insert(job.map, &e)) puts("ERROR: sync replace failed");
+	}
+	if(DS_count(job.map) != SYNC_CNT) puts("ERROR: sync insert miscount");
+	
+	for(uint64_t i=0; i<SYNC_CNT; i++)
+		if(!DS_sync_find(job.map, &i, &e) || e.key != i || e.round != 1)
+			puts("ERROR: sync find failed");
+	for(uint64_t i=0; i<SYNC_CNT; i+=2)
+		if(!DS_sync_remove(job.map, &i, &e) || e.key != i)
+			puts("ERROR: sync remove failed");
+	for(uint64_t i=0; i<SYNC_CNT; i++)
+		if(DS_sync_find(job.map, &i, &e) != (i&1))
+			puts("ERROR: sync find after remove failed");
+	if(DS_count(job.map) != SYNC_CNT/2) puts("ERROR: sync remove miscount");
+	
+	DS_flush(job.map);
+	DS_empty(job.map);
+	if(!DS_isempty(job.map)) puts("ERROR: empty sync map is not empty");
+	
+	// readers check every copy they get while writers grow and shrink the map
+	atomic_init(&job.finished, false);
+	atomic_init(&job.failed, 0);
+	for(uint i=0; i<SYNC_THR; i++){
+		pthread_create(tid+i, NULL, &sync_writer, &job);
+		pthread_create(tid+SYNC_THR+i, NULL, &sync_reader, &job);
+	}
+	for(uint i=0; i<SYNC_THR; i++) pthread_join(tid[i], NULL);
+	atomic_store(&job.finished, true);
+	for(uint i=SYNC_THR; i<SYNC_THR*2; i++) pthread_join(tid[i], NULL);
+	
+	if(atomic_load(&job.failed)) puts("ERROR: sync map gave a torn entry");
+	if(DS_count(job.map) != SYNC_THR*SYNC_CNT) puts("ERROR: sync map miscount");
+	for(uint64_t i=0; i<SYNC_THR*SYNC_CNT; i++)
+		if(!DS_sync_find(job.map, &i, &e) || e.round != SYNC_ROUND)
+			puts("ERROR: sync map lost an update");
+	
+	DS_delete(job.map);
+}
+
+/*	Fill a structure with 0 to CURSOR_CNT-1 and walk it with two nested cursors.
+ *	Neither may disturb the other or the current position. Sorted structures
+ *	are filled with DS_insert() and searched with DS_cursor_find().
+ */
+static void cursor_walk(
+	DS           seq,
+	const char * name,
+	void *       (*insert)(DS root, const void * data)
+){
+	DS_cursor  outer, inner;
+	uint64_t * num, k, expect = 0;
+	void *     current;
+	
+	for(k=0; k<CURSOR_CNT; k++)
+		if(!insert(seq, &k)) printf("ERROR: failed %s insert\n", name);
+	current = DS_first(seq);
+	
+	outer = DS_cursor_new(seq);
+	inner = DS_cursor_new(seq);
+	if(DS_cursor_next(outer) || DS_cursor_current(outer))
+		printf("ERROR: %s unplaced cursor moved\n", name);
+	
+	for(num = (uint64_t*) DS_cursor_first(outer); num;
+		num = (uint64_t*) DS_cursor_next(outer), expect++){
+		if(*num != expect) printf("ERROR: %s cursor out of order\n", name);
+		
+		// a short walk backward from the same entry
+		if(insert == &DS_insert) DS_cursor_find(inner, &expect);
+		else DS_cursor_position(inner, (uint)expect+1);
+		if(DS_cursor_current(inner) != num)
+			printf("ERROR: %s cursor position\n", name);
+		for(k=0; k<3 && DS_cursor_previous(inner); k++);
+		if(*(uint64_t*)DS_cursor_current(inner) != expect-k)
+			printf("ERROR: %s cursor previous\n", name);
+	}
+	if(expect != CURSOR_CNT) printf("ERROR: %s cursor miscount\n", name);
+	if(*(uint64_t*)DS_cursor_current(outer) != CURSOR_CNT-1)
+		printf("ERROR: %s cursor left the end\n", name);
+	
+	num = (uint64_t*) DS_cursor_last(inner);
+	if(!num || *num != CURSOR_CNT-1) printf("ERROR: %s cursor last\n", name);
+	k = CURSOR_CNT;
+	if(insert == &DS_insert
+		&& (DS_cursor_find(inner, &k) || DS_cursor_current(inner) != num))
+		printf("ERROR: %s cursor moved on a failed find\n", name);
+	if(DS_current(seq) != current) printf("ERROR: %s cursor moved current\n", name);
+	
+	DS_cursor_delete(inner);
+	DS_cursor_delete(outer);
+	DS_delete(seq);
+}
+
+struct cursor_job{
+	DS       tree;
+	uint64_t sum;
+};
+
+static void * cursor_reader(void * arg){
+	struct cursor_job * job    = (struct cursor_job*) arg;
+	DS_cursor           cursor = DS_cursor_new(job->tree);
+	uint64_t *          num;
+	
+	job->sum = 0;
+	for(uint64_t i=0; i<CURSOR_CNT; i++){
+		num = (uint64_t*) DS_cursor_find(cursor, &i);
+		if(num) job->sum += *num;
+		if(DS_cursor_next(cursor)) job->sum++;
+	}
+	
+	DS_cursor_delete(cursor);
+	return NULL;
+}
+
+static void cursor_tests(void){
+	struct cursor_job job[CURSOR_THR];
+	pthread_t         tid[CURSOR_THR];
+	DS                tree;
+	uint64_t          num;
+	
+	cursor_walk(DS_new_list(sizeof(uint64_t)), "list", &DS_insert_last);
+	cursor_walk(DS_new_unrolled(sizeof(uint64_t)), "unrolled", &DS_insert_last);
+	cursor_walk(DS_new_array(sizeof(uint64_t)), "array", &DS_insert_last);
+	cursor_walk(DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64), "avl",
+		&DS_insert);
+	cursor_walk(DS_new_btree(sizeof(uint64_t), sizeof(uint64_t), false, &key,
+		&cmp_u64), "btree", &DS_insert);
+	
+	tree = DS_new_splay(sizeof(uint64_t), false, &key, &cmp_u64);
+	for(uint64_t k=0; k<CURSOR_CNT; k++){
+		num = k*7919%CURSOR_CNT;
+		DS_insert(tree, &num);
+	}
+	
+	// several threads read the splay tree at once without splaying it
+	for(uint i=0; i<CURSOR_THR; i++){
+		job[i].tree = tree;
+		pthread_create(tid+i, NULL, &cursor_reader, job+i);
+	}
+	for(uint i=0; i<CURSOR_THR; i++){
+		pthread_join(tid[i], NULL);
+		if(job[i].sum != (uint64_t)CURSOR_CNT*(CURSOR_CNT-1)/2 + CURSOR_CNT-1)
+			puts("ERROR: concurrent cursors disagree");
+	}
+	DS_delete(tree);
+	
+	tree = DS_new_hash(sizeof(uint64_t), 0, false, &hash_int);
+	for(num=0; num<CURSOR_CNT; num++) DS_insert(tree, &num);
+	job[0].tree = tree;
+	cursor_reader(job);
+	if(job[0].sum < (uint64_t)CURSOR_CNT*(CURSOR_CNT-1)/2)
+		puts("ERROR: hash cursor find failed");
+	DS_delete(tree);
+}
+
+
+// every integer hashes to its own slot
+static uint64_t hash_id(const void * data){
+	return *(const uint64_t*)data;
+}
+
+/*	Remove the even entries while walking a table whose last cluster wraps
+ *	around to slot 0, so the removals shift visited entries past the end.
+ */
+static void hash_walk_tests(void){
+	const uint64_t keys[] = {14, 15, 30, 31, 46, 3, 5, 7, 9};
+	DS             hash   = DS_new_hash(sizeof(uint64_t), 16, false, &hash_id);
+	uint64_t *     num;
+	uint           visits[47] = {0};
+	
+	for(uint i=0; i<sizeof(keys)/sizeof(keys[0]); i++)
+		if(!DS_insert(hash, &keys[i])) puts("ERROR: failed hash insert");
+	
+	num = (uint64_t*) DS_first(hash);
+	while(num){
+		visits[*num]++;
+		if(*num & 1) num = (uint64_t*) DS_next(hash);
+		else{
+			DS_remove(hash);
+			num = (uint64_t*) DS_current(hash);
+		}
+	}
+	
+	for(uint i=0; i<sizeof(keys)/sizeof(keys[0]); i++){
+		if(visits[keys[i]] != 1)
+			puts("ERROR: hash walk did not visit each entry once");
+		if((keys[i] & 1) != (DS_find(hash, &keys[i]) != NULL))
+			puts("ERROR: hash walk removed the wrong entries");
+	}
+	if(DS_count(hash) != 6) puts("ERROR: hash walk remove miscount");
+	
+	DS_delete(hash);
+}
+
+static void radix_tests(void){
+	DS               heap = DS_new_radix_heap(sizeof(uint64_t));
+	uint64_t         keys[RADIX_CNT];
+	const uint64_t * out;
+	uint64_t         key, prev, seq, base;
+	uint             popped;
+	
+	// a timer wheel: every pop schedules later events, some at the same time
+	for(seq=0; seq<RADIX_CNT/4; seq++){
+		keys[seq] = hash_int(&seq) % 1000;
+		if(!DS_radix_push(heap, keys[seq], &seq))
+			puts("ERROR: failed radix heap push");
+	}
+	
+	prev = 0;
+	for(popped=0; (out = (const uint64_t*) DS_radix_pop(heap, &key)); popped++){
+		if(key < prev || *out >= RADIX_CNT || keys[*out] != key){
+			puts("ERROR: radix heap out of order");
+			break;
+		}
+		prev = key;
+		
+		for(uint i=0; seq<RADIX_CNT && i<2; i++, seq++){
+			keys[seq] = key + (seq & 1? 0 : hash_int(&seq) % 5000);
+			DS_radix_push(heap, keys[seq], &seq);
+		}
+	}
+	if(popped != RADIX_CNT) puts("ERROR: radix heap lost entries");
+	if(!DS_isempty(heap)) puts("ERROR: drained radix heap is not empty");
+	
+	// keys spanning all 64 bits, in runs of three that must stay in order
+	base = prev;
+	for(seq=0; seq<RADIX_CNT; seq++){
+		keys[seq] = base + ((hash_int(&(uint64_t){seq/3})>>1) >> (seq/3 % 64));
+		DS_radix_push(heap, keys[seq], &seq);
+	}
+	if(DS_count(heap) != RADIX_CNT) puts("ERROR: radix heap miscount");
+	
+	for(popped=0; popped<=RADIX_CNT/2; popped++){
+		if(DS_first(heap) != DS_current(heap))
+			puts("ERROR: radix heap first and current differ");
+		
+		out = (const uint64_t*) DS_radix_pop(heap, &key);
+		if(!out || key < prev || keys[*out] != key
+			|| (popped && key == prev && *out <= seq)
+		){
+			puts("ERROR: radix heap out of order");
+			break;
+		}
+		prev = key;
+		seq  = *out;
+	}
+	
+	msg_set_verbosity(V_QUIET);
+	if(DS_radix_push(heap, prev-1, &seq)) puts("ERROR: radix heap went back");
+	if(DS_insert(heap, &seq)) puts("ERROR: radix heap took an insert");
+	msg_set_verbosity(V_TRACE);
+	
+	// DS_remove pops as well
+	if(!DS_remove(heap) || DS_count(heap) != RADIX_CNT/2-2)
+		puts("ERROR: radix heap remove failed");
+	DS_flush(heap);
+	DS_empty(heap);
+	if(!DS_isempty(heap) || DS_first(heap) || DS_radix_pop(heap, NULL))
+		puts("ERROR: empty radix heap is not empty");
+	
+	// emptying starts the keys over
+	if(!DS_radix_push(heap, 0, &seq)) puts("ERROR: emptied radix heap refused");
+	DS_flush(heap);
+	DS_delete(heap);
+	
+	// the keys alone
+	heap = DS_new_radix_heap(0);
+	for(uint64_t i=0; i<RADIX_CNT; i++)
+		if(!DS_radix_push(heap, RADIX_CNT-i/2, NULL))
+			puts("ERROR: failed keyless radix heap push");
+	for(uint64_t i=0; i<RADIX_CNT; i++)
+		if(!DS_radix_pop(heap, &key) || key != RADIX_CNT/2+1+i/2)
+			puts("ERROR: keyless radix heap out of order");
+	DS_delete(heap);
+}
+
 int main(void){
 	char * temp;
 	const char
@@ -30,6 +1573,10 @@ int main(void){
 	DS dup_bst = DS_new_bst     (sizeof(char*), true , &key, &cmp);
 	DS ex_bst  = DS_new_bst     (sizeof(char*), false, &key, &cmp);
 	DS heap    = DS_new_heap    (sizeof(char*),              &cmp);
+	DS hash    = DS_new_hash    (sizeof(uint64_t), 0, false, &hash_int);
+	uint64_t * num;
+	uint64_t   val;
+	int        array[HEAPIFY_CNT];
 	
 	typedef enum {DS_list, DS_circular_list, DS_bst, DS_hash} DS_type;
 	
@@ -159,6 +1706,45 @@ int main(void){
 	
 	printf("\nEND DUP_BST TESTS\n\n");
 	
+	/***************************** AVL TESTS **********************************/
+	
+	tree_tests(DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64), "avl");
+	rank_tests(DS_new_bst(sizeof(uint64_t), false, &key, &cmp_u64), "bst");
+	rank_tests(DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64), "avl");
+	
+	ex_bst = DS_new_bst(sizeof(uint64_t), false, &key, &cmp_u64);
+	if(DS_arena(ex_bst, 0)) puts("ERROR: could not set the arena");
+	bulk_tests(ex_bst, "arena bst");
+	bulk_tests(DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64), "avl");
+	
+	tree_tests(prefixed(DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64)),
+		"prefix avl");
+	rank_tests(prefixed(DS_new_bst(sizeof(uint64_t), false, &key, &cmp_u64)),
+		"prefix bst");
+	bulk_tests(prefixed(DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64)),
+		"prefix avl");
+	prefix_tests();
+	
+	printf("\nEND AVL TESTS\n\n");
+	
+	/**************************** SPLAY TESTS *********************************/
+	
+	tree_tests(DS_new_splay(sizeof(uint64_t), false, &key, &cmp_u64), "splay");
+	rank_tests(DS_new_splay(sizeof(uint64_t), false, &key, &cmp_u64), "splay");
+	bulk_tests(DS_new_splay(sizeof(uint64_t), false, &key, &cmp_u64), "splay");
+	tree_tests(prefixed(DS_new_splay(sizeof(uint64_t), false, &key, &cmp_u64)),
+		"prefix splay");
+	
+	printf("\nEND SPLAY TESTS\n\n");
+	
+	/**************************** B-TREE TESTS ********************************/
+	
+	tree_tests(DS_new_btree(sizeof(uint64_t), sizeof(uint64_t), false, &key, &cmp_u64),
+		"btree");
+	btree_tests();
+	
+	printf("\nEND B-TREE TESTS\n\n");
+	
 	/***************************** LIST TESTS *********************************/
 	
 	if(!DS_push(list, first)) puts("ERROR: failed push first");
@@ -186,6 +1772,122 @@ int main(void){
 	
 	printf("\nEND LIST TESTS\n\n");
 	
+	/**************************** ARRAY TESTS *********************************/
+	
+	array_tests();
+	
+	printf("\nEND ARRAY TESTS\n\n");
+	
+	/*************************** UNROLLED TESTS *******************************/
+	
+	list = DS_new_unrolled(sizeof(int));
+	sequence_tests(list, "unrolled");
+	thin_tests(list, "unrolled");
+	DS_delete(list);
+	
+	printf("\nEND UNROLLED TESTS\n\n");
+	
+	/**************************** CURSOR TESTS ********************************/
+	
+	cursor_tests();
+	
+	printf("\nEND CURSOR TESTS\n\n");
+	
+	/**************************** ARENA TESTS *********************************/
+	
+	arena_tests();
+	
+	printf("\nEND ARENA TESTS\n\n");
+	
+	/************************** INTRUSIVE TESTS *******************************/
+	
+	intrusive_tests();
+	
+	printf("\nEND INTRUSIVE TESTS\n\n");
+	
+	/**************************** SNAPSHOT TESTS ******************************/
+	
+	snap_tests(DS_new_list(sizeof(uint64_t)), DS_new_list(sizeof(uint64_t)),
+		SNAP_WALK, "list");
+	snap_tests(DS_new_circular(sizeof(uint64_t)),
+		DS_new_circular(sizeof(uint64_t)), SNAP_WALK, "circular");
+	snap_tests(DS_new_unrolled(sizeof(uint64_t)),
+		DS_new_unrolled(sizeof(uint64_t)), SNAP_WALK, "unrolled");
+	snap_tests(DS_new_array(sizeof(uint64_t)), DS_new_array(sizeof(uint64_t)),
+		SNAP_WALK, "array");
+	snap_tests(DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64),
+		DS_new_avl(sizeof(uint64_t), false, &key, &cmp_u64), SNAP_WALK, "avl");
+	snap_tests(DS_new_btree(sizeof(uint64_t), sizeof(uint64_t), false, &key,
+		&cmp_u64), DS_new_btree(sizeof(uint64_t), sizeof(uint64_t), false, &key,
+		&cmp_u64), SNAP_WALK, "btree");
+	snap_tests(DS_new_hash(sizeof(uint64_t), 0, false, &hash_int),
+		DS_new_hash(sizeof(uint64_t), 0, false, &hash_int), SNAP_FIND, "hash");
+	snap_tests(DS_new_heap(sizeof(uint64_t), &cmp_u64),
+		DS_new_heap(sizeof(uint64_t), &cmp_u64), SNAP_POP, "heap");
+	snap_tests(DS_new_keyed_heap(sizeof(uint64_t), sizeof(uint64_t), &key,
+		&cmp_u64), DS_new_keyed_heap(sizeof(uint64_t), sizeof(uint64_t), &key,
+		&cmp_u64), SNAP_POP, "keyed heap");
+	snap_tests(DS_new_pairing_heap(sizeof(uint64_t), &cmp_u64),
+		DS_new_pairing_heap(sizeof(uint64_t), &cmp_u64), SNAP_POP,
+		"pairing heap");
+	snap_fail_tests();
+	
+	printf("\nEND SNAPSHOT TESTS\n\n");
+	
+	/***************************** HASH TESTS *********************************/
+	
+	#define HASH_CNT 100000
+	
+	if(!DS_isempty(hash)) puts("ERROR: empty hash reports nodes");
+	
+	for(uint64_t i=0; i<HASH_CNT; i++)
+		if(!DS_insert(hash, &i)) puts("ERROR: failed hash insert");
+	for(uint64_t i=0; i<HASH_CNT; i+=1000)
+		if(DS_insert(hash, &i)) puts("ERROR: inserted dup into hash");
+	
+	if(DS_count(hash) != HASH_CNT) puts("ERROR: hash insert miscount");
+	
+	for(uint64_t i=0; i<HASH_CNT; i++){
+		num = (uint64_t*) DS_find(hash, &i);
+		if(!num || *num != i) puts("ERROR: hash find failed");
+	}
+	
+	// remove the even entries
+	for(uint64_t i=0; i<HASH_CNT; i+=2){
+		if(!DS_find(hash, &i)) continue;
+		num = (uint64_t*) DS_remove(hash);
+		if(!num || *num != i) puts("ERROR: hash removed the wrong entry");
+	}
+	
+	if(DS_count(hash) != HASH_CNT/2) puts("ERROR: hash remove miscount");
+	num = (uint64_t*) DS_current(hash);
+	if(num && !(*num & 1)) puts("ERROR: hash current is a removed entry");
+	
+	for(uint64_t i=0; i<HASH_CNT; i++){
+		if((i&1) != (DS_find(hash, &i) != NULL))
+			puts("ERROR: hash find after remove failed");
+	}
+	
+	// visit everything in table order
+	num = (uint64_t*) DS_first(hash);
+	for(uint i=0; num; i++){
+		if(!(*num & 1)) puts("ERROR: hash visited a removed entry");
+		num = (uint64_t*) DS_next(hash);
+		if(!num && i+1 != HASH_CNT/2) puts("ERROR: hash traversal miscount");
+	}
+	
+	DS_flush(hash);
+	for(uint64_t i=1; i<HASH_CNT; i+=2)
+		if(!DS_find(hash, &i)) puts("ERROR: hash find after flush failed");
+	
+	DS_empty(hash);
+	if(!DS_isempty(hash)) puts("ERROR: empty hash is not empty");
+	
+	DS_delete(hash);
+	hash_walk_tests();
+	
+	printf("\nEND HASH TESTS\n\n");
+	
 	/***************************** HEAP TESTS *********************************/
 	
 	msg_print(NULL, V_NOTE, "START HEAP TESTS\n\n");
@@ -218,9 +1920,67 @@ int main(void){
 	
 	DS_delete(heap);
 	
+	// the low bits are not compared, they record the insertion order
+	heap = DS_new_heap(sizeof(uint64_t), &cmp_int);
+	
+	for(uint64_t i=0; i<HASH_CNT; i++){
+		val = (hash_int(&i) % 1000)<<20 | i;
+		if(!DS_insert(heap, &val))
+			msg_print(NULL, V_ERROR, "failed heap insert\n");
+	}
+	
+	// replace everything with entries that sort last
+	val = 0;
+	for(uint64_t i=0; i<HASH_CNT; i++){
+		num = (uint64_t*) DS_swap(heap, &(uint64_t){(uint64_t)1000<<20 | i});
+		if(!num || *num < val) // also checks first-in-first-out
+			msg_print(NULL, V_ERROR, "heap swap is out of order\n");
+		if(num) val = *num;
+	}
+	
+	for(uint64_t i=0; i<HASH_CNT; i++){
+		num = (uint64_t*) DS_remove(heap);
+		if(!num || *num != ((uint64_t)1000<<20 | i))
+			msg_print(NULL, V_ERROR, "heap removal is out of order\n");
+	}
+	
+	if(!DS_isempty(heap)) msg_print(NULL, V_ERROR, "empty heap is not empty\n");
+	
+	DS_delete(heap);
+	
+	pairing_tests();
+	arity_tests();
+	keyed_tests();
+	radix_tests();
+	
+	for(uint64_t i=0; i<HEAPIFY_CNT; i++) array[i] = (int)(hash_int(&i)%1000);
+	DS_heapify(array, HEAPIFY_CNT, sizeof(int), &cmp_array);
+	for(int i=1; i<HEAPIFY_CNT; i++)
+		if(array[(i-1)/2] > array[i])
+			msg_print(NULL, V_ERROR, "DS_heapify broke the heap invariant\n");
 	
 	msg_print(NULL, V_NOTE, "END HEAP TESTS\n\n");
 	
+	/***************************** SORT TESTS *********************************/
+	
+	sort_tests();
+	
+	printf("\nEND SORT TESTS\n\n");
+	
+	/*********************** CONCURRENT QUEUE TESTS ***************************/
+	
+	queue_tests();
+	ring_tests();
+	deque_tests();
+	
+	printf("\nEND CONCURRENT QUEUE TESTS\n\n");
+	
+	/*********************** CONCURRENT HASH MAP TESTS ************************/
+	
+	sync_tests();
+	
+	printf("\nEND CONCURRENT HASH MAP TESTS\n\n");
+	
 	msg_print(NULL, V_NOTE,"\t*** END OF TESTS ***\n\n");
 	
 	return EXIT_SUCCESS;
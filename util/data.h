@@ -17,13 +17,28 @@
  *	Data structure types include:
  *	*	list: a general list that is also used to implement stacks and queues
  *	*	circular list
+ *	*	unrolled list: a list that stores many entries in each node
+ *	*	dynamic array: a list stored in one contiguous buffer
  *	*	binary search tree
+ *	*	AVL tree: a self-balancing binary search tree
+ *	*	splay tree: a binary search tree that keeps recently used entries near
+ *		the root
+ *	*	B-tree: an ordered map with many entries per node
+ *	*	hash table
+ *	*	concurrent hash map: a hash table for many readers and writers
+ *	*	heap
+ *	*	pairing heap: a heap whose entries can be changed or removed in place
+ *	*	radix heap: a priority queue for integer keys that never decrease
+ *	*	MPMC queue: a bounded lock free queue for passing data between threads
+ *	*	SPSC queue: a ring buffer for passing data from one thread to another
+ *	*	work stealing deque: a task deque for one owner and many thieves
  *
  *	##Function Documentation
  *	* @ref new    "Creating new Data Structures"
  *	* @ref insert "Inserting Entries in Structure"
  *	* @ref remove "Removing Entries from Structure"
  *	* @ref visit  "Traversing Entries in Structure"
+ *	* @ref cursor "Traversing with a Cursor"
  *
  *	##The Current Position
  *	An important concept for each of these structures is the **current
@@ -42,6 +57,15 @@
  *	be used to view the next-out member, and DS_last() may be used to view the
  *	last-out member.
  *
+ *	###Cursors
+ *	The current position belongs to the structure, so even the traversal
+ *	functions that take a `const DS` change it. A cursor from DS_cursor_new()
+ *	holds a position of its own instead. The DS_cursor_XXX() functions never
+ *	change the structure, not even by splaying a splay tree, so a structure that
+ *	is not being modified may be read through any number of cursors at once,
+ *	from any number of threads. Any insertion or removal invalidates every
+ *	cursor on the structure until it is placed again.
+ *
  *	## Data Storage Method
  *	The caller's data is stored in a generic fixed length byte array. The
  *	size of the arrays is set by the caller in DS_new_XXX() when the data
@@ -63,11 +87,25 @@
  *	### Make a New Structure
  *	*	DS_new_list()
  *	*	DS_new_circular()
+ *	*	DS_new_unrolled()
+ *	*	DS_new_array()
  *	*	DS_new_bst()
+ *	*	DS_new_avl()
+ *	*	DS_new_splay()
+ *	*	DS_new_btree()
  *	*	DS_new_hash()
+ *	*	DS_new_sync_hash()
  *	*	DS_new_heap()
+ *	*	DS_new_keyed_heap()
+ *	*	DS_new_pairing_heap()
+ *	*	DS_new_radix_heap()
+ *	*	DS_new_mpmc_queue()
+ *	*	DS_new_spsc_queue()
+ *	*	DS_new_ws_deque()
  *
  *	### All Structures
+ *	*	DS_arena() : Lists, trees, and keyed heaps only
+ *	*	DS_intrusive() : Lists, circular lists, binary trees, and heaps only
  *	*	DS_flush()
  *	*	DS_delete()
  *	*	DS_empty()
@@ -75,7 +113,7 @@
  *	*	DS_isempty()
  *	*	DS_dump()
  *
- *	### Lists
+ *	### Lists and Unrolled Lists
  *	*	DS_insert()
  *	*	DS_insert_first()
  *	*	DS_insert_last()
@@ -95,6 +133,22 @@
  *	*	DS_nq()
  *	*	DS_dq()
  *
+ *	### Dynamic Arrays
+ *	*	DS_insert()
+ *	*	DS_insert_first()
+ *	*	DS_insert_last()
+ *	*	DS_remove()
+ *	*	DS_remove_first()
+ *	*	DS_remove_last()
+ *	*	DS_first()
+ *	*	DS_last()
+ *	*	DS_next()
+ *	*	DS_previous()
+ *	*	DS_current()
+ *	*	DS_position()
+ *	*	DS_buffer()
+ *	*	DS_push(), DS_pop(), DS_nq(), and DS_dq() as for lists
+ *
  *	### Circular Lists
  *	*	DS_insert()
  *	*	DS_remove()
@@ -102,9 +156,10 @@
  *	*	DS_previous()
  *	*	DS_current()
  *
- *	### Binary Search Trees
- *	*	DS_isleaf()
+ *	### Binary Search Trees, AVL Trees, Splay Trees, and B-trees
+ *	*	DS_isleaf() : Not B-trees
  *	*	DS_insert()
+ *	*	DS_bulk_load() : Not B-trees
  *	*	DS_remove()
  *	*	DS_remove_first()
  *	*	DS_remove_last()
@@ -114,6 +169,9 @@
  *	*	DS_next()
  *	*	DS_previous()
  *	*	DS_current()
+ *	*	DS_position() : Not B-trees
+ *	*	DS_rank() : Not B-trees
+ *	*	DS_tree_top() : Intrusive binary trees only
  *
  *	### General Trees
  *	*	DS_isleaf()
@@ -134,13 +192,70 @@
  *	*	DS_insert()
  *	*	DS_remove()
  *	*	DS_find()
+ *	*	DS_first() : Visit the first entry in table order
+ *	*	DS_next() : Visit the next entry in table order
  *	*	DS_current()
  *
  *	### Heaps
  *	*	DS_insert()
  *	*	DS_remove() : Remove the entry at the top of the heap
  *	*	DS_first() : View the entry at the top of the heap
+ *	*	DS_current() : View the entry at the top of the heap
  *	*	DS_swap() : Remove the entry at the top of the heap and add a new one
+ *	*	DS_heap_arity() : Set the number of children of each node
+ *
+ *	### Pairing Heaps
+ *	*	DS_insert() : Returns a handle that stays valid until it is removed
+ *	*	DS_remove() : Remove the entry at the top of the heap
+ *	*	DS_first() : View the entry at the top of the heap
+ *	*	DS_current() : View the entry at the top of the heap
+ *	*	DS_heap_update() : Restore the order after an entry's priority changed
+ *	*	DS_heap_remove() : Remove any entry by its handle
+ *
+ *	### Radix Heaps
+ *	*	DS_radix_push()
+ *	*	DS_radix_pop()
+ *	*	DS_remove() : As DS_radix_pop() without the key
+ *	*	DS_first() : View the entry with the smallest key
+ *	*	DS_current() : As DS_first()
+ *
+ *	### Cursors
+ *	*	DS_cursor_new() : Not concurrent structures
+ *	*	DS_cursor_delete()
+ *	*	DS_cursor_first()
+ *	*	DS_cursor_last() : As DS_last()
+ *	*	DS_cursor_next() : As DS_next(), and circular lists
+ *	*	DS_cursor_previous() : As DS_previous()
+ *	*	DS_cursor_current()
+ *	*	DS_cursor_find() : As DS_find()
+ *	*	DS_cursor_position() : As DS_position()
+ *
+ *	### MPMC and SPSC Queues
+ *	*	DS_try_nq()
+ *	*	DS_try_dq()
+ *	*	DS_nq_batch()
+ *	*	DS_dq_batch()
+ *	*	DS_count() : A snapshot while other threads are using the queue
+ *	*	DS_isempty() : As DS_count()
+ *	*	DS_empty() : Only while no other thread is using the queue
+ *	*	DS_delete() : As DS_empty()
+ *
+ *	### Work Stealing Deques
+ *	*	DS_push_bottom() : Owner only
+ *	*	DS_pop_bottom() : Owner only
+ *	*	DS_steal()
+ *	*	DS_count(), DS_isempty(), DS_empty(), and DS_delete() as for queues
+ *	*	DS_flush() : Only while no other thread is using the deque
+ *
+ *	### Concurrent Hash Maps
+ *	*	DS_sync_insert()
+ *	*	DS_sync_remove()
+ *	*	DS_sync_find()
+ *	*	DS_count() : Each shard is counted under its lock
+ *	*	DS_isempty() : As DS_count()
+ *	*	DS_empty() : Safe while other threads are using the map
+ *	*	DS_flush() : Only while no other thread is using the map
+ *	*	DS_delete() : As DS_flush()
  *
  ******************************************************************************/
 
@@ -153,6 +268,21 @@
 /// All data structures are represented in the caller's code as type DS
 typedef struct _root* DS;
 
+/// A position in a data structure that is independent of its current position
+typedef struct _cursor* DS_cursor;
+
+/**	The link fields of a record that is linked into a structure in place.
+ *	Embed one in each record of an intrusive structure, see DS_intrusive().
+ *	Lists keep the hook of the next and previous records in link[0] and
+ *	link[1]. Binary trees keep the hook of the parent, left, and right records
+ *	in link[0], link[1], and link[2]. The rest is private to the library.
+ */
+typedef struct {
+	void *   link[3];
+	size_t   rank[2];
+	uint64_t prefix;
+} DS_hook;
+
 #ifdef __cplusplus
 	extern "C" {
 #endif
@@ -181,6 +311,31 @@ DS DS_new_list(size_t data_size);
 /// Create a new circular list.
 DS DS_new_circular(size_t data_size);
 
+/**	Create a new unrolled list.
+ *
+ *	An unrolled list supports the same operations as DS_new_list(), but it
+ *	stores its entries in blocks of many entries each. Traversal touches far
+ *	fewer cache lines, there is no per entry pointer overhead, and
+ *	DS_position() skips whole blocks at a time. Stack and queue operations take
+ *	constant time. Inserting or removing in the middle moves the other entries
+ *	of the same block, so pointers returned by an unrolled list are only valid
+ *	until the next insertion or removal.
+ */
+DS DS_new_unrolled(size_t data_size);
+
+/**	Create a new dynamic array.
+ *
+ *	A dynamic array supports the same operations as a list, but its entries are
+ *	kept in order in one contiguous buffer that grows geometrically. Adding or
+ *	removing entries at either end takes amortized constant time, and
+ *	DS_position() takes constant time. Inserting or removing in the middle
+ *	moves the entries on the shorter side. Because entries move, pointers
+ *	returned by a dynamic array are only valid until the next insertion or
+ *	removal. DS_buffer() gives direct access to the entries, for example to pass
+ *	them to DS_sort() or DS_heapify().
+ */
+DS DS_new_array(size_t data_size);
+
 
 /**	Create a new binary search tree.
  *
@@ -209,13 +364,96 @@ DS DS_new_bst(
 );
 
 
+/**	Create a new AVL tree.
+ *
+ *	An AVL tree is a binary search tree that rebalances itself on every
+ *	insertion and removal. Its height stays within about 1.44 log2(n) even
+ *	when the keys arrive in sorted order, so it is a safe replacement for
+ *	DS_new_bst() at a small cost per insertion and removal. It accepts the same
+ *	parameters and supports the same operations as DS_new_bst().
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_avl(
+	size_t        data_size,
+	bool          duplicates_allowed,
+	const void *  (*key)(const void * data),
+	imax          (*cmp_keys)(const void * left , const void * right)
+);
+
+
+/**	Create a new splay tree.
+ *
+ *	A splay tree is a binary search tree that moves each entry to the root of
+ *	the tree when it is inserted or found. Entries that are used often stay near
+ *	the root, so skewed lookups touch only a few nodes. Any sequence of
+ *	operations takes amortized O(log n) time per operation, but a single
+ *	operation may take O(n). DS_find() changes the shape of a splay tree. It
+ *	accepts the same parameters and supports the same operations as
+ *	DS_new_bst().
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_splay(
+	size_t        data_size,
+	bool          duplicates_allowed,
+	const void *  (*key)(const void * data),
+	imax          (*cmp_keys)(const void * left , const void * right)
+);
+
+
+/**	Create a new B-tree.
+ *
+ *	The B-tree keeps many entries in each node, with the keys of a node stored
+ *	together. A lookup touches a handful of nodes instead of one node per
+ *	comparison, and there is no per entry allocation, so it is both faster and
+ *	smaller than DS_new_bst() for large sets. Entries are moved between nodes as
+ *	the tree changes, so pointers returned by a B-tree are only valid until the
+ *	next insertion or removal. DS_remove() leaves the *current position* at the
+ *	following entry. It supports the same operations as DS_new_bst() except
+ *	DS_isleaf(), DS_position(), DS_rank(), DS_cursor_position(), DS_bulk_load(),
+ *	DS_key_prefix(), DS_intrusive(), and DS_tree_top(). A B-tree does not count
+ *	the entries below each node, so it can not find an entry by its position.
+ *
+ *	@param data_size The size in bytes of the data being stored in this
+ *	structure. If you need to store variable length data you should store
+ *	pointers in the data structure.
+ *	@param key_size The size in bytes of the key returned by key(). Keys are
+ *	copied into the tree, so the key must be entirely contained in those bytes.
+ *	@param duplicates_allowed Non-zero if duplicate keys are allowed, zero
+ *	otherwise. Duplicates are kept in the order they were inserted.
+ *	@param key As in DS_new_bst().
+ *	@param cmp_keys As in DS_new_bst().
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_btree(
+	size_t        data_size,
+	size_t        key_size,
+	bool          duplicates_allowed,
+	const void *  (*key)(const void * data),
+	imax          (*cmp_keys)(const void * left , const void * right)
+);
+
+
 /**	Create a new hash table.
+ *
+ *	The table uses open addressing with Robin Hood displacement, and the data is
+ *	stored directly in the table. Entries are identified by their 64-bit hash,
+ *	so two entries that hash to the same value are considered to have the same
+ *	key. Because entries move within the table, pointers returned by a hash
+ *	table are only valid until the next insertion or removal.
+ *
+ *	DS_first() and DS_next() visit the entries in table order. Entries may be
+ *	removed during such a walk; DS_current() then returns the entry that
+ *	followed, or `NULL` when none did, and each entry is still visited once.
  *
  *	@param data_size The size in bytes of the data being stored in this
  *	structure.  If you need to store variable length data you should store
  *	pointers in the data structure.
- *	@param table_size 0 indicates the default size. Otherwise indicates the size
- *	of the hash table.
+ *	@param table_size 0 indicates the default size. Otherwise indicates the
+ *	initial number of slots in the hash table. It is rounded up to a power of
+ *	two, and the table grows automatically as it fills.
  *	@param duplicates_allowed Non-zero if duplicate keys are allowed, zero
  *	otherwise.
  *	@param hash_func A function that takes your data as a parameter, and returns
@@ -231,7 +469,41 @@ DS DS_new_hash(
 );
 
 
+/**	Create a new concurrent hash map
+ *
+ *	The map is split into shards by hash, and each shard is a hash table like
+ *	DS_new_hash() makes. Writers take a lock on their shard only, so writers on
+ *	different shards never wait for each other. Readers never lock at all. They
+ *	copy the entry out of the table and try again if a writer changed the shard
+ *	meanwhile, so a lookup never blocks a writer and costs no more than a plain
+ *	lookup while no writer is busy on its shard. Duplicate keys are not
+ *	allowed.
+ *	Tables that a shard has outgrown are kept until DS_flush() because a reader
+ *	may still be probing them.
+ *
+ *	@param data_size The size in bytes of the data being stored in this
+ *	structure.
+ *	@param shards 0 indicates the default number of shards. It is rounded up to
+ *	a power of two. More shards let more writers work at once.
+ *	@param hash_func A function that takes your data as a parameter, and returns
+ *	the hash of that data. Both the low and the high 32 bits of the hash should
+ *	be well mixed.
+ *
+ *	@return NULL on failure
+ */
+DS DS_new_sync_hash(
+	size_t   data_size,
+	size_t   shards,
+	uint64_t (*hash_func)(const void * data)
+);
+
+
 /**	Create a new heap
+ *
+ *	The heap is stored in a contiguous array that grows as needed. The entry
+ *	that is ordered first is always at the top of the heap. Because entries move
+ *	within the array, pointers returned by a heap are only valid until the next
+ *	insertion or removal.
  *
  *	@param data_size The size in bytes of the data being stored in this
  *	structure. If you need to store variable length data you should store
@@ -249,6 +521,131 @@ DS DS_new_heap(
 	imax   (*cmp_data)(const void * left , const void * right)
 );
 
+/**	Create a new pairing heap
+ *
+ *	Each entry has its own node that never moves, so the pointer returned by
+ *	DS_insert() is a handle that stays valid until the entry is removed. The
+ *	caller may change the priority of an entry through its handle and then call
+ *	DS_heap_update(), or take an entry out from anywhere with DS_heap_remove().
+ *	Both take amortized O(log n) time, as does DS_remove(). DS_insert() takes
+ *	O(1) time. Use DS_new_heap() when entries are only ever added and removed
+ *	from the top.
+ *
+ *	@param data_size The size in bytes of the data being stored in this
+ *	structure.
+ *	@param cmp_data As for DS_new_heap(). Equal entries follow
+ *	first-in-first-out.
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_pairing_heap(
+	size_t data_size,
+	imax   (*cmp_data)(const void * left , const void * right)
+);
+
+/**	Create a new heap that sifts keys instead of records
+ *
+ *	A keyed heap supports the same operations as DS_new_heap(). Each record is
+ *	copied once into a payload slot that never moves, and the heap array only
+ *	holds a copy of the record's key with a pointer to its payload. Sifting
+ *	moves those small entries and never touches the payloads, which pays off
+ *	when the records are much larger than their keys. The payloads are packed
+ *	into the slabs of an arena, see DS_arena(). A pointer returned by
+ *	DS_insert() stays valid until the record is removed, and one returned by
+ *	DS_remove() or DS_swap() until the next insertion. A keyed heap can not be
+ *	made intrusive.
+ *
+ *	@param data_size The size in bytes of each record.
+ *	@param key_size The size in bytes of the key copied out of each record.
+ *	@param key A function that returns a pointer to the key of a record. The
+ *	key_size bytes it points to must be all that cmp_keys() looks at.
+ *	@param cmp_keys Compares two keys as `cmp_data` does for DS_new_heap().
+ *	Records with equal keys follow first-in-first-out.
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_keyed_heap(
+	size_t data_size,
+	size_t key_size,
+	const void * (*key)(const void * data),
+	imax         (*cmp_keys)(const void * left, const void * right)
+);
+
+/**	Create a new radix heap
+ *
+ *	A monotone priority queue for 64 bit integer keys. No key pushed may be
+ *	smaller than the last key popped, as is the case for event times in a
+ *	simulation or distances in Dijkstra's algorithm. Entries are sorted into 65
+ *	buckets by the highest bit in which their key differs from the last key
+ *	popped. A push takes O(1) time and a pop amortized O(log C) time, where C is
+ *	the largest difference between keys in the heap. No comparisons are made,
+ *	so there is no comparison function. Entries with equal keys follow
+ *	first-in-first-out. Add and remove entries with DS_radix_push() and
+ *	DS_radix_pop(). DS_insert() is not supported.
+ *
+ *	@param data_size The size in bytes of the payload of each entry. It may be
+ *	zero if the keys are all that is needed.
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_radix_heap(size_t data_size);
+
+
+/**	Create a new bounded multi-producer multi-consumer queue.
+ *
+ *	Entries are copied into and out of a ring of cells that is allocated once,
+ *	so DS_try_nq() and DS_try_dq() never allocate and never take a lock. Any
+ *	number of threads may enqueue and dequeue at the same time. Producers only
+ *	contend with producers, and consumers with consumers. Without contention
+ *	each call completes in a fixed number of steps. Entries come out in the
+ *	order they went in. None of the other insertion, removal, or traversal
+ *	functions may be used on an MPMC queue.
+ *
+ *	@param data_size The size in bytes of the data being stored in this
+ *	structure.
+ *	@param capacity The maximum number of entries. It is rounded up to a power
+ *	of two.
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_mpmc_queue(size_t data_size, size_t capacity);
+
+
+/**	Create a new bounded single-producer single-consumer queue.
+ *
+ *	This is a ring buffer for handing entries from exactly one producer thread
+ *	to exactly one consumer thread. It supports the same operations as
+ *	DS_new_mpmc_queue() but needs no atomic read-modify-write at all, and
+ *	DS_nq_batch() and DS_dq_batch() copy whole runs of entries at once. Only
+ *	one thread may enqueue and only one thread may dequeue.
+ *
+ *	@param data_size The size in bytes of the data being stored in this
+ *	structure.
+ *	@param capacity The maximum number of entries. It is rounded up to a power
+ *	of two.
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_spsc_queue(size_t data_size, size_t capacity);
+
+
+/**	Create a new work stealing deque.
+ *
+ *	The deque belongs to one owner thread, which adds and removes entries at the
+ *	bottom with DS_push_bottom() and DS_pop_bottom() without locks. Any number
+ *	of other threads may take entries from the top with DS_steal(), each
+ *	attempt costing a single CAS. The owner sees its most recent entries first,
+ *	while thieves take the oldest. The deque grows as needed. Arrays it has
+ *	outgrown are kept until DS_flush() because a thief may still be reading
+ *	them.
+ *
+ *	@param data_size The size in bytes of the data being stored in this
+ *	structure.
+ *
+ *	@return `NULL` on failure
+ */
+DS DS_new_ws_deque(size_t data_size);
+
 
 //DS DS_new_tree(
 //	unsigned int children,
@@ -269,7 +666,8 @@ void DS_delete(DS root);
 /**	Flushes cached memory.
  *	Removing nodes from the structure does not immediately release the occupied
  *	memory. This memory is cached for quick reuse. This command frees that
- *	cached memory.
+ *	cached memory. A structure using DS_arena() only frees its memory when it is
+ *	empty.
  *	@param root a data structure
  */
 void DS_flush (DS root);
@@ -277,6 +675,87 @@ void DS_flush (DS root);
 /// Remove all items from a data structure
 void DS_empty (DS root);
 
+/**	Allocate the nodes of a structure from a slab arena.
+ *	Instead of allocating each node separately, nodes are carved out of large
+ *	slabs. Nodes of the same structure stay close together in memory, and
+ *	DS_empty() and DS_delete() release whole slabs at once instead of visiting
+ *	every node. Memory in the slabs is reused by later insertions, but it is
+ *	only returned to the system by DS_flush() when the structure is empty.
+ *
+ *	This may only be called on an empty list, circular list, unrolled list,
+ *	tree, or keyed heap. Keyed heaps always use an arena, so this only changes
+ *	the slab size.
+ *	@param root a data structure
+ *	@param slab_size the size in bytes of each slab, 0 for the default
+ *	@return r_failure if the structure type has no nodes or is not empty.
+ */
+RETURN DS_arena(DS root, size_t slab_size);
+
+/**	Link the caller's records into a structure in place.
+ *	An intrusive structure never allocates nodes and never copies data. Each
+ *	record embeds a DS_hook, and the structure links the records through their
+ *	hooks. Insertion functions take a pointer to the record and return the same
+ *	pointer. Removal, traversal, and the key and comparison callbacks all deal
+ *	in pointers to records too. A record must stay where it is and may be in
+ *	only one structure per hook until it is removed. The records still belong
+ *	to the caller, and DS_empty() and DS_delete() do not free them.
+ *
+ *	An intrusive heap keeps a pointer to each record in its array instead, so
+ *	sifting moves pointers rather than records, and no hook is needed. A
+ *	pairing heap does link its records through a hook, and the handle of each
+ *	entry is the record itself.
+ *
+ *	This may only be called on an empty list, circular list, tree, heap, or
+ *	pairing heap that is not using DS_arena(). B-trees are not supported.
+ *	@param root a data structure
+ *	@param hook_offset the `offsetof()` the DS_hook in the caller's record, 0
+ *	for a heap
+ *	@return r_failure if the structure type is not supported or is not empty.
+ */
+RETURN DS_intrusive(DS root, size_t hook_offset);
+
+/**	Keep a prefix of each key in its tree node.
+ *	The prefix of a key is computed once when it is inserted or searched for.
+ *	Keys whose prefixes differ are then ordered by their prefixes alone,
+ *	without calling key() or touching the data, and cmp_keys() is only called
+ *	when the prefixes are equal. This saves a cache miss on every level of a
+ *	search when the keys live behind pointers, such as strings.
+ *
+ *	The prefix must agree with cmp_keys(): whenever prefix(left) is less than
+ *	prefix(right), cmp_keys(left, right) must be <0. DS_prefix_string() and
+ *	DS_prefix_u64() are suitable for common keys.
+ *
+ *	This may only be called on an empty BST, AVL tree, or splay tree.
+ *	@param root a binary tree
+ *	@param prefix takes a key as returned by key() and returns its prefix
+ *	@return r_failure if the structure is not an empty binary tree.
+ */
+RETURN DS_key_prefix(DS root, uint64_t (*prefix)(const void * key));
+
+/// The first eight bytes of a string key, for cmp_keys() using strcmp()
+uint64_t DS_prefix_string(const void * key);
+
+/// The whole of a `uint64_t` key, for cmp_keys() comparing them as integers
+uint64_t DS_prefix_u64(const void * key);
+
+/**	Set the number of children of each node in a heap.
+ *	A wider heap is shallower, so removals compare more entries but touch fewer
+ *	cache lines. The children of each node are kept together. They start on a
+ *	cache line boundary when arity times the entry size is a multiple of 64
+ *	bytes. Each entry takes the data size plus an 8 byte serial number, rounded
+ *	up to 8 bytes. A keyed heap stores a pointer plus the key in place of the
+ *	data. For example, 4-ary heaps of 8 byte data and 8-ary heaps of 24 byte
+ *	data line up, while binary heaps of 8 byte data and 4-ary heaps of 16 byte
+ *	data do not. New heaps have an arity of 4. With small entries 4 or 8 are
+ *	usually faster than 2, and with large entries the difference is small.
+ *
+ *	This may only be called on an empty heap.
+ *	@param root a heap made with DS_new_heap()
+ *	@param arity the number of children of each node, at least 2
+ *	@return r_failure if the structure is not an empty heap.
+ */
+RETURN DS_heap_arity(DS root, uint arity);
+
 /// Return the number of nodes in the structure.
 unsigned int DS_count  (const DS root);
 bool         DS_isempty(const DS root); ///< is the structure empty
@@ -344,6 +823,34 @@ void * DS_insert_first(DS root, const void * data);
 /// Insert data at the end of a DS_list
 void * DS_insert_last (DS root, const void * data);
 
+/**	Add an entry to a radix heap
+ *	@param root is the root of a radix heap
+ *	@param key is the priority of the entry. It may not be less than the last
+ *	key popped.
+ *	@param data is a pointer to the payload. It may be `NULL` if the payload
+ *	size is zero.
+ *	@return a pointer to the payload in the heap, or `NULL` on failure. It is
+ *	only valid until the next push or pop.
+ */
+void * DS_radix_push(DS root, uint64_t key, const void * data);
+
+/**	Fill an empty binary tree from an array that is already in sort order
+ *
+ *	The tree is built perfectly balanced in time proportional to count. No keys
+ *	are compared, so the array must really be sorted, and must not hold
+ *	duplicate keys unless the tree allows them. The nodes come from the arena
+ *	or the freelist when the tree has them. The *current position* will be at
+ *	the last entry.
+ *
+ *	@param root is the root of an empty BST, AVL tree, or splay tree
+ *	@param data is an array of count entries in sort order
+ *	@param count is the number of entries in data
+ *
+ *	@return `r_failure` if the tree is not empty or on failure, in which case
+ *	the tree is left empty.
+ */
+RETURN DS_bulk_load(DS root, const void * data, size_t count);
+
 /**@}*/
 
 
@@ -384,6 +891,39 @@ const void * DS_remove_first(DS root);
 /// Remove the last entry in the structure
 const void * DS_remove_last (DS root);
 
+/**	Remove the entry at the top of a heap and insert new data in one step.
+ *	This is cheaper than a DS_remove() followed by a DS_insert(). It will fail
+ *	on an empty heap.
+ *	@param root is the root of a heap
+ *	@param data is a pointer to the data being inserted
+ *	@return a pointer to the removed data on success, `NULL` on failure.
+ */
+const void * DS_swap(DS root, const void * data);
+
+/**	Restore the order of a pairing heap after the priority of an entry was
+ *	changed through its handle. The priority may move either way.
+ *	@param root is the root of a pairing heap
+ *	@param handle is a pointer returned by DS_insert() on this heap
+ *	@return r_failure if the structure is not a pairing heap
+ */
+RETURN DS_heap_update(DS root, void * handle);
+
+/**	Remove any entry from a pairing heap.
+ *	@param root is the root of a pairing heap
+ *	@param handle is a pointer returned by DS_insert() on this heap
+ *	@return a pointer to the removed data on success, `NULL` on failure. It is
+ *	only valid until the next insertion.
+ */
+const void * DS_heap_remove(DS root, void * handle);
+
+/**	Remove the entry with the smallest key from a radix heap.
+ *	@param root is the root of a radix heap
+ *	@param key if not `NULL`, receives the key of the removed entry
+ *	@return a pointer to the removed payload on success, `NULL` on failure or
+ *	if the heap is empty. It is only valid until the next push or pop.
+ */
+const void * DS_radix_pop(DS root, uint64_t * key);
+
 /**@}*/
 
 
@@ -414,7 +954,8 @@ const void * DS_remove_last (DS root);
  *	does not change contents of data structure
  *	@param root a data structure
  *	@param key the search/sort key. It must be the same data type as returned by
- *	key() and accepted by cmp_keys().
+ *	key() and accepted by cmp_keys(). For hash tables it is passed to
+ *	hash_func() and must hash to the same value as the stored data.
  *	@return a pointer to the stored data on success, `NULL` on failure.
  */
 void * DS_find(const DS root, const void * key);
@@ -427,39 +968,288 @@ void * DS_previous (DS root); ///< visit the previous in-order node
 void * DS_current  (DS root); ///< visit the current node
 
 /**	Visit the entry that is a specific count from the beginning of the structure
+ *	Binary search trees keep the size of every subtree, so they find the entry
+ *	in time proportional to the height of the tree.
  *
  *	@param root is the root of a data structure
- *	@param count is the position in the structure to be returned
+ *	@param count is the position in the structure to be returned. The first
+ *	entry is at position 1.
  *
  *	@return a pointer to the stored data on success, `NULL` on failure.
  */
 void * DS_position (const DS root, const uint count);
 
+/**	Count the entries of a binary search tree whose keys are ordered before key.
+ *	Together with DS_position() this answers rank and percentile queries in
+ *	time proportional to the height of the tree. When key is present its first
+ *	entry is at position DS_rank()+1. The *current position* is not changed,
+ *	but a splay tree is splayed as by DS_find().
+ *
+ *	@param root is the root of a binary search tree
+ *	@param key the search key, as for DS_find()
+ *
+ *	@return the number of entries with keys less than key, 0 on failure.
+ */
+uint DS_rank(const DS root, const void * key);
+
+/**	Get the record at the top of an intrusive binary search tree.
+ *	From here the tree may be searched through the links of the DS_hooks
+ *	without calling back into the library. The *current position* is not
+ *	changed.
+ *
+ *	@param root is the root of an intrusive binary search tree
+ *
+ *	@return the top record, `NULL` if the tree is empty or on failure.
+ */
+void * DS_tree_top(const DS root);
+
+/**	Get the entries of a dynamic array as an ordinary C array.
+ *	The entries are contiguous and in order, DS_count() of them. They may be
+ *	read, modified, or reordered in place, for instance by DS_sort(). The
+ *	pointer is valid until the next insertion or removal. The *current
+ *	position* is not changed.
+ *
+ *	@param root is the root of a dynamic array
+ *
+ *	@return a pointer to the first entry, `NULL` if the array is empty or on
+ *	failure.
+ */
+void * DS_buffer(const DS root);
+
+/**@}*/
+
+
+/******************************************************************************/
+//                                  CURSORS
+/******************************************************************************/
+
+
+/**	@defgroup cursor Traverse with a Cursor
+ *
+ *	These work like the functions of the same name in @ref visit "View a Data
+ *	Entry", but they move the cursor instead of the *current position*. A
+ *	cursor on a circular list is placed with DS_cursor_first() at the head. If
+ *	an entry can not be reached the cursor does not move.
+ *
+ *	@param cursor a cursor from DS_cursor_new()
+ *
+ *	@return a pointer to the stored data on success, `NULL` on failure.
+ *
+ *	@{
+ */
+
+/**	Create a cursor on a structure.
+ *	The cursor starts out unplaced. Place it with DS_cursor_first(),
+ *	DS_cursor_last(), DS_cursor_find(), or DS_cursor_position().
+ *	@param root is the root of a data structure
+ *	@return `NULL` on failure
+ */
+DS_cursor DS_cursor_new(const DS root);
+
+/// Free a cursor. This does not change its structure.
+void DS_cursor_delete(DS_cursor cursor);
+
+void * DS_cursor_first   (DS_cursor cursor); ///< visit the first entry
+void * DS_cursor_last    (DS_cursor cursor); ///< visit the last entry
+void * DS_cursor_next    (DS_cursor cursor); ///< visit the next entry
+void * DS_cursor_previous(DS_cursor cursor); ///< visit the previous entry
+void * DS_cursor_current (DS_cursor cursor); ///< visit the cursor's entry
+
+/// search for data by its key, as DS_find()
+void * DS_cursor_find(DS_cursor cursor, const void * key);
+
+/// visit the entry at a position from 1, as DS_position()
+void * DS_cursor_position(DS_cursor cursor, uint position);
+
 /**@}*/
 
 
+/******************************************************************************/
+//                             CONCURRENT QUEUES
+/******************************************************************************/
+
+
+/**	Add an entry to the back of an MPMC or SPSC queue.
+ *	The data is copied into the queue. On an MPMC queue it is safe to call from
+ *	any number of threads at once.
+ *	@param root is the root of an MPMC or SPSC queue
+ *	@param data is a pointer to the data being inserted
+ *	@return `false` if the queue is full or on failure.
+ */
+bool DS_try_nq(DS root, const void * data);
+
+/**	Remove the entry at the front of an MPMC or SPSC queue.
+ *	The entry is copied out of the queue. On an MPMC queue it is safe to call
+ *	from any number of threads at once.
+ *	@param root is the root of an MPMC or SPSC queue
+ *	@param data is where the removed data is copied
+ *	@return `false` if the queue is empty or on failure.
+ */
+bool DS_try_dq(DS root, void * data);
+
+/**	Add as many as count entries to the back of a queue.
+ *	An SPSC queue publishes the whole run at once. An MPMC queue adds the
+ *	entries one at a time, so entries from other producers may come between
+ *	them.
+ *	@param root is the root of an MPMC or SPSC queue
+ *	@param data is an array of count entries
+ *	@param count is the number of entries in data
+ *	@return the number of entries added from the front of data, which is less
+ *	than count if the queue filled up.
+ */
+size_t DS_nq_batch(DS root, const void * data, size_t count);
+
+/**	Remove as many as count entries from the front of a queue.
+ *	@param root is the root of an MPMC or SPSC queue
+ *	@param data is an array with room for count entries
+ *	@param count is the most entries to remove
+ *	@return the number of entries copied into data, which is less than count
+ *	if the queue ran empty.
+ */
+size_t DS_dq_batch(DS root, void * data, size_t count);
+
+/**	Add an entry to the bottom of a work stealing deque.
+ *	Only the owner of the deque may call this.
+ *	@param root is the root of a work stealing deque
+ *	@param data is a pointer to the data being inserted
+ *	@return `false` if the deque could not grow or on failure.
+ */
+bool DS_push_bottom(DS root, const void * data);
+
+/**	Remove the entry at the bottom of a work stealing deque.
+ *	Only the owner of the deque may call this.
+ *	@param root is the root of a work stealing deque
+ *	@param data is where the removed data is copied
+ *	@return `false` if the deque is empty or on failure.
+ */
+bool DS_pop_bottom(DS root, void * data);
+
+/**	Take the entry at the top of a work stealing deque.
+ *	Any thread may call this. A thief that loses a race for an entry tries
+ *	again until it succeeds or the deque is empty.
+ *	@param root is the root of a work stealing deque
+ *	@param data is where the removed data is copied. It may be overwritten
+ *	even when the steal fails.
+ *	@return `false` if the deque is empty or on failure.
+ */
+bool DS_steal(DS root, void * data);
+
+
+/******************************************************************************/
+//                            CONCURRENT HASH MAPS
+/******************************************************************************/
+
+
+/**	Add an entry to a concurrent hash map, replacing any entry with the same
+ *	hash. Safe to call from any number of threads at once.
+ *	@param root is the root of a concurrent hash map
+ *	@param data is a pointer to the data being inserted
+ *	@return `false` on failure.
+ */
+bool DS_sync_insert(DS root, const void * data);
+
+/**	Remove an entry from a concurrent hash map.
+ *	Safe to call from any number of threads at once.
+ *	@param root is the root of a concurrent hash map
+ *	@param key is passed to hash_func() and must hash to the same value as the
+ *	stored data
+ *	@param data is where the removed data is copied, or `NULL`
+ *	@return `false` if there was no such entry or on failure.
+ */
+bool DS_sync_remove(DS root, const void * key, void * data);
+
+/**	Look up an entry in a concurrent hash map without taking a lock.
+ *	Safe to call from any number of threads at once. Since no pointer into the
+ *	table would stay valid, the entry is copied out.
+ *	@param root is the root of a concurrent hash map
+ *	@param key is passed to hash_func() and must hash to the same value as the
+ *	stored data
+ *	@param data is where the entry is copied. It may be overwritten even when
+ *	the lookup fails.
+ *	@return `false` if there is no such entry or on failure.
+ */
+bool DS_sync_find(const DS root, const void * key, void * data);
+
+
+/******************************************************************************/
+//                                 SNAPSHOTS
+/******************************************************************************/
+
+
+/**	Save the entries of a structure to a binary file.
+ *	The file holds the structure type, `data_size`, the entries packed together
+ *	in order, and a checksum. It is read back with DS_load(). It is not portable
+ *	between machines with different byte orders. Concurrent structures and
+ *	intrusive structures can not be saved.
+ *	@param root is the root of a data structure
+ *	@param path is the file to create or replace
+ *	@return r_failure if the structure can not be saved or the file can not be
+ *	written.
+ */
+RETURN DS_save(const DS root, const char * path);
+
+/**	Fill an empty structure from a file written by DS_save().
+ *	The file is mapped into memory and checked in full before anything is
+ *	built. The entries are then added in one pass. Binary trees are rebuilt
+ *	with DS_bulk_load(), and arrays are filled with a single copy. Heaps are
+ *	saved in heap order, so no entry is sifted when reloaded, but equal entries
+ *	may not come out in the order they went in. The *current position* will be
+ *	at the last entry.
+ *	@param root is the root of an empty structure of the same type and
+ *	`data_size` as the one that was saved. Its other parameters, such as key()
+ *	and cmp_keys(), should also be the same.
+ *	@param path is a file written by DS_save()
+ *	@return r_failure if the file can not be read, does not match the
+ *	structure, or fails its checksum, or if the structure is not empty. The
+ *	structure is left empty on failure.
+ */
+RETURN DS_load(DS root, const char * path);
+
+
 /******************************************************************************/
 //                               ARRAY UTILITIES
 /******************************************************************************/
 
 
-///* sort an array
-// *	adaptive, stable
-// *
-// *	@param buffer the array to be sorted
-// *	@param count the number of elements in the array
-// *	@param size the size in bytes of each array element
-// *	@param compare a function for comparing array elements. It returns a signed
-// *	integer indicating in what order the keys should be sorted. It must return
-// *	<0 if left is ordered before right, >0 if left is ordered after right, and 0
-// *	if they are the same.
-// */
-//void DS_sort(
-//	void *buffer,
-//	size_t count,
-//	size_t size,
-//	int (*compare)(const void *left, const void *right)
-//);
+/**	Sort an array.
+ *	The sort is stable and adaptive. Runs that are already sorted or reverse
+ *	sorted are detected in linear time. It requires a scratch buffer of half
+ *	the size of the array.
+ *
+ *	@param buffer the array to be sorted
+ *	@param count the number of elements in the array
+ *	@param size the size in bytes of each array element
+ *	@param compare a function for comparing array elements. It returns a signed
+ *	integer indicating in what order the keys should be sorted. It must return
+ *	<0 if left is ordered before right, >0 if left is ordered after right, and 0
+ *	if they are the same.
+ */
+void DS_sort(
+	void *buffer,
+	size_t count,
+	size_t size,
+	int (*compare)(const void *left, const void *right)
+);
+
+/**	Sort an array using multiple threads.
+ *	The result is identical to DS_sort(). Each thread sorts a part of the array,
+ *	and the parts are then merged in parallel. Small arrays use fewer threads.
+ *	It requires a scratch buffer of the same size as the array.
+ *
+ *	@param buffer the array to be sorted
+ *	@param count the number of elements in the array
+ *	@param size the size in bytes of each array element
+ *	@param compare a function for comparing array elements as in DS_sort(). It
+ *	must be safe to call from several threads at once.
+ *	@param threads the maximum number of threads to use
+ */
+void DS_sort_parallel(
+	void *buffer,
+	size_t count,
+	size_t size,
+	int (*compare)(const void *left, const void *right),
+	uint threads
+);
 
 /**	Swap the contents of two regions of memory
  *	
@@ -491,6 +1281,26 @@ void DS_heapify(
 	int    (*compare)(const void *left, const void *right)
 );
 
+/**	Heapify an array into a heap where each node has arity children
+ *	The children of element i are elements i*arity+1 through i*arity+arity.
+ *	DS_heapify() is the same with an arity of 2. For the children of each node
+ *	to share a cache line, start the array arity-1 elements after a cache line
+ *	boundary and make arity*size a multiple of the cache line.
+ *
+ *	@param buffer the array to be heapified
+ *	@param count the number of elements in the array
+ *	@param size the size in bytes of each array element
+ *	@param compare a function for comparing array elements as in DS_heapify()
+ *	@param arity the number of children of each node, at least 2
+ */
+void DS_heapify_arity(
+	void   *buffer,
+	size_t count,
+	size_t size,
+	int    (*compare)(const void *left, const void *right),
+	uint   arity
+);
+
 
 #ifdef __cplusplus
 	}
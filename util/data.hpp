@@ -0,0 +1,516 @@
+/*******************************************************************************
+ *
+ *	lib-util : A Utility Library
+ *
+ *	Copyright (c) 2016-2018 Ammon Dodson
+ *	You should have received a copy of the license terms with this software. If
+ *	not, please visit the project homepage at:
+ *	https://github.com/ammon0/lib-util
+ *
+ ******************************************************************************/
+
+/** @file data.hpp
+ *
+ *	Typed C++ wrappers for the data structures in data.h
+ *
+ *	Each wrapper owns one intrusive DS and allocates a node for each element
+ *	that embeds the DS_hook next to the element itself, so the layouts,
+ *	balancing, and sifting are exactly those of data.c. Elements are moved or
+ *	constructed in place rather than copied with memcpy(), so move-only types
+ *	work, and the destructor destroys the remaining elements and calls
+ *	DS_delete().
+ *
+ *	util::bst::find() walks the tree itself through the hooks, so the key
+ *	extractor and the comparison are inlined into the search instead of being
+ *	called through function pointers. Insertion, removal, and the heap still
+ *	go through data.c and call the same functors through a trampoline.
+ *
+ *	Key extractors and comparisons must be stateless function objects, since
+ *	the C callbacks have no context to carry them. A key extractor returns a
+ *	reference to the key inside the element, and a comparison answers whether
+ *	its left argument is ordered before its right, like `std::less`.
+ *
+ *	Failure to allocate throws `std::bad_alloc`.
+ */
+
+
+#ifndef _DATA_HPP_INCLUDE
+#define _DATA_HPP_INCLUDE
+
+#include <util/data.h>
+
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <iterator>
+
+
+namespace util {
+
+
+/// A key extractor for elements that are their own key
+struct identity {
+	template <class T>
+	const T & operator()(const T & value) const { return value; }
+};
+
+/// A comparison that orders by `operator<`
+struct less {
+	template <class T>
+	bool operator()(const T & left, const T & right) const {
+		return left < right;
+	}
+};
+
+
+/******************************************************************************/
+//                              IMPLEMENTATION
+/******************************************************************************/
+
+
+namespace detail {
+
+/// An element with the hook that links it into a list or tree
+template <class T>
+struct node : DS_hook {
+	T value;
+	
+	template <class... Args>
+	explicit node(Args&&... args):
+		DS_hook(), value(std::forward<Args>(args)...) {}
+};
+
+template <class T>
+inline node<T> * as_node(const void * hook){
+	return static_cast<node<T>*>(
+		static_cast<DS_hook*>(const_cast<void*>(hook))
+	);
+}
+
+// turn a less-than comparison into the three way result data.c expects
+template <class Cmp, class T>
+inline imax order(const T & left, const T & right){
+	if (Cmp()(left, right)) return -1;
+	if (Cmp()(right, left)) return  1;
+	return 0;
+}
+
+// the callbacks handed to data.c
+template <class T, class KeyFn>
+const void * key_tramp(const void * record){
+	return &KeyFn()(as_node<T>(record)->value);
+}
+
+template <class K, class Cmp>
+imax key_cmp_tramp(const void * left, const void * right){
+	return order<Cmp>(*static_cast<const K*>(left),
+		*static_cast<const K*>(right));
+}
+
+template <class T, class Cmp>
+imax heap_cmp_tramp(const void * left, const void * right){
+	return order<Cmp>(*static_cast<const T*>(left),
+		*static_cast<const T*>(right));
+}
+
+// removal from an end starts from the *current position*, which a failed
+// search may have cleared
+inline const void * remove_first(DS ds){
+	if (!ds || !DS_count(ds)) return NULL;
+	DS_first(ds);
+	return DS_remove_first(ds);
+}
+
+inline const void * remove_last(DS ds){
+	if (!ds || !DS_count(ds)) return NULL;
+	DS_last(ds);
+	return DS_remove_last(ds);
+}
+
+// link an empty structure through hooks at the start of each record
+inline DS adopt(DS ds, size_t hook){
+	if (ds && DS_intrusive(ds, hook) == r_failure){
+		DS_delete(ds);
+		ds = NULL;
+	}
+	if (!ds) throw std::bad_alloc();
+	return ds;
+}
+
+/// In-order iteration over the hooks of a list or tree
+template <class T, class Step>
+class iterator {
+	DS_hook * pos;
+
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef T                         value_type;
+	typedef std::ptrdiff_t            difference_type;
+	typedef T *                       pointer;
+	typedef T &                       reference;
+	
+	explicit iterator(DS_hook * hook = NULL): pos(hook) {}
+	
+	reference operator* () const { return static_cast<node<T>*>(pos)->value; }
+	pointer   operator->() const { return &**this; }
+	
+	iterator & operator++()   { pos = Step()(pos); return *this; }
+	iterator   operator++(int){ iterator old(*this); ++*this; return old; }
+	
+	bool operator==(const iterator & other) const { return pos == other.pos; }
+	bool operator!=(const iterator & other) const { return pos != other.pos; }
+};
+
+struct list_step {
+	DS_hook * operator()(DS_hook * hook) const {
+		return static_cast<DS_hook*>(hook->link[0]);
+	}
+};
+
+// link[0] is the parent, link[1] the left, and link[2] the right child
+struct tree_step {
+	DS_hook * operator()(DS_hook * hook) const {
+		DS_hook * up;
+	
+		if (hook->link[2]){
+			hook = static_cast<DS_hook*>(hook->link[2]);
+			while (hook->link[1]) hook = static_cast<DS_hook*>(hook->link[1]);
+			return hook;
+		}
+		while ((up = static_cast<DS_hook*>(hook->link[0]))
+			&& up->link[2] == hook)
+			hook = up;
+		return up;
+	}
+};
+
+} // namespace detail
+
+
+/******************************************************************************/
+//                            BINARY SEARCH TREE
+/******************************************************************************/
+
+
+/**	A sorted set of T in an AVL tree, keyed by `KeyFn()(element)`.
+ *	Keys are unique. Do not modify the key of an element in the tree.
+ */
+template <class T, class KeyFn = identity, class Cmp = less>
+class bst {
+public:
+	/// the type returned by the key extractor
+	typedef typename std::decay<
+		decltype(KeyFn()(std::declval<const T&>()))
+	>::type key_type;
+	typedef detail::iterator<T, detail::tree_step> iterator;
+
+private:
+	static_assert(
+		std::is_lvalue_reference<
+			decltype(KeyFn()(std::declval<const T&>()))
+		>::value,
+		"util::bst: the key extractor must return a reference"
+	);
+	
+	typedef detail::node<T> node;
+	
+	DS ds;
+	
+	void destroy(){
+		if (!ds) return;
+		clear();
+		DS_delete(ds);
+		ds = NULL;
+	}
+	
+	// link a new node, or delete it if its key is already present
+	T * link(node * n){
+		if (DS_insert(ds, static_cast<DS_hook*>(n))) return &n->value;
+		delete n;
+		return NULL;
+	}
+	
+	// make the node with this key the current position
+	bool seek(const key_type & key){ return ds && DS_find(ds, &key); }
+	
+	node * find_node(const key_type & key) const {
+		const DS_hook * hook;
+	
+		hook = ds? static_cast<const DS_hook*>(DS_tree_top(ds)) : NULL;
+		while (hook){
+			const key_type & here =
+				KeyFn()(static_cast<const node*>(hook)->value);
+	
+			if      (Cmp()(key, here)) hook = (const DS_hook*)hook->link[1];
+			else if (Cmp()(here, key)) hook = (const DS_hook*)hook->link[2];
+			else return detail::as_node<T>(hook);
+		}
+		return NULL;
+	}
+
+public:
+	bst(): ds(detail::adopt(DS_new_avl(sizeof(node), false,
+		&detail::key_tramp<T, KeyFn>, &detail::key_cmp_tramp<key_type, Cmp>
+	), 0)) {}
+	
+	~bst(){ destroy(); }
+	
+	bst(bst && other): ds(other.ds){ other.ds = NULL; }
+	bst & operator=(bst && other){
+		if (this != &other){
+			destroy();
+			ds       = other.ds;
+			other.ds = NULL;
+		}
+		return *this;
+	}
+	
+	bst(const bst &) = delete;
+	bst & operator=(const bst &) = delete;
+	
+	/// Insert an element. Returns NULL if its key is already present.
+	T * insert(T && value){ return link(new node(std::move(value))); }
+	T * insert(const T & value){ return link(new node(value)); }
+	
+	/// Construct an element in place. Returns NULL if its key is present.
+	template <class... Args>
+	T * emplace(Args&&... args){
+		return link(new node(std::forward<Args>(args)...));
+	}
+	
+	/// Find the element with this key, or NULL.
+	T * find(const key_type & key){
+		node * n = find_node(key);
+		return n? &n->value : NULL;
+	}
+	const T * find(const key_type & key) const {
+		node * n = find_node(key);
+		return n? &n->value : NULL;
+	}
+	
+	/// Remove and destroy the element with this key. Returns whether it was
+	/// there.
+	bool erase(const key_type & key){
+		if (!seek(key)) return false;
+		delete detail::as_node<T>(DS_remove(ds));
+		return true;
+	}
+	
+	/// Move the element with this key into out and remove it from the tree.
+	bool extract(const key_type & key, T & out){
+		node * n;
+	
+		if (!seek(key)) return false;
+		n   = detail::as_node<T>(DS_remove(ds));
+		out = std::move(n->value);
+		delete n;
+		return true;
+	}
+	
+	/// Destroy every element
+	void clear(){
+		const void * record;
+		while ((record = detail::remove_first(ds)))
+			delete detail::as_node<T>(record);
+	}
+	
+	size_t size () const { return ds? DS_count(ds) : 0; }
+	bool   empty() const { return !size(); }
+	
+	/// Elements in key order
+	iterator begin() const {
+		DS_hook * hook = ds? static_cast<DS_hook*>(DS_tree_top(ds)) : NULL;
+		if (hook) while (hook->link[1]) hook = (DS_hook*)hook->link[1];
+		return iterator(hook);
+	}
+	iterator end() const { return iterator(); }
+};
+
+
+/******************************************************************************/
+//                                   LIST
+/******************************************************************************/
+
+
+/// A doubly linked list of T
+template <class T>
+class list {
+	typedef detail::node<T> node;
+	
+	DS ds;
+	
+	void destroy(){
+		if (!ds) return;
+		clear();
+		DS_delete(ds);
+		ds = NULL;
+	}
+	
+	bool take(const void * record, T & out){
+		node * n;
+	
+		if (!record) return false;
+		n   = detail::as_node<T>(record);
+		out = std::move(n->value);
+		delete n;
+		return true;
+	}
+	
+	T & link_first(node * n){
+		DS_insert_first(ds, static_cast<DS_hook*>(n));
+		return n->value;
+	}
+	T & link_last(node * n){
+		DS_insert_last(ds, static_cast<DS_hook*>(n));
+		return n->value;
+	}
+
+public:
+	typedef detail::iterator<T, detail::list_step> iterator;
+	
+	list(): ds(detail::adopt(DS_new_list(sizeof(node)), 0)) {}
+	~list(){ destroy(); }
+	
+	list(list && other): ds(other.ds){ other.ds = NULL; }
+	list & operator=(list && other){
+		if (this != &other){
+			destroy();
+			ds       = other.ds;
+			other.ds = NULL;
+		}
+		return *this;
+	}
+	
+	list(const list &) = delete;
+	list & operator=(const list &) = delete;
+	
+	T & push_front(T && value){ return link_first(new node(std::move(value))); }
+	T & push_back (T && value){ return link_last (new node(std::move(value))); }
+	T & push_front(const T & value){ return link_first(new node(value)); }
+	T & push_back (const T & value){ return link_last (new node(value)); }
+	
+	template <class... Args>
+	T & emplace_front(Args&&... args){
+		return link_first(new node(std::forward<Args>(args)...));
+	}
+	template <class... Args>
+	T & emplace_back(Args&&... args){
+		return link_last(new node(std::forward<Args>(args)...));
+	}
+	
+	/// Move the first element into out and remove it. False if empty.
+	bool pop_front(T & out){ return take(detail::remove_first(ds), out); }
+	/// Move the last element into out and remove it. False if empty.
+	bool pop_back (T & out){ return take(detail::remove_last (ds), out); }
+	
+	/// The first element, which must exist
+	T & front(){ return detail::as_node<T>(DS_first(ds))->value; }
+	/// The last element, which must exist
+	T & back (){ return detail::as_node<T>(DS_last (ds))->value; }
+	
+	/// Destroy every element
+	void clear(){
+		const void * record;
+		while ((record = detail::remove_first(ds)))
+			delete detail::as_node<T>(record);
+	}
+	
+	size_t size () const { return ds? DS_count(ds) : 0; }
+	bool   empty() const { return !size(); }
+	
+	/// Elements from first to last. This moves the *current position*.
+	iterator begin(){
+		return iterator(ds && DS_count(ds)?
+			static_cast<DS_hook*>(DS_first(ds)) : NULL);
+	}
+	iterator end(){ return iterator(); }
+};
+
+
+/******************************************************************************/
+//                                   HEAP
+/******************************************************************************/
+
+
+/**	A priority queue of T. top() is the element that is ordered first by Cmp,
+ *	so the default is a min-heap. Equal elements come out first-in-first-out.
+ *	The heap sifts pointers to the elements, calling Cmp through data.c.
+ */
+template <class T, class Cmp = less>
+class heap {
+	DS ds;
+	
+	void destroy(){
+		if (!ds) return;
+		clear();
+		DS_delete(ds);
+		ds = NULL;
+	}
+	
+	void link(T * element){
+		if (!DS_insert(ds, element)){
+			delete element;
+			throw std::bad_alloc();
+		}
+	}
+
+public:
+	heap(): ds(detail::adopt(DS_new_heap(sizeof(T*),
+		&detail::heap_cmp_tramp<T, Cmp>
+	), 0)) {}
+	
+	~heap(){ destroy(); }
+	
+	heap(heap && other): ds(other.ds){ other.ds = NULL; }
+	heap & operator=(heap && other){
+		if (this != &other){
+			destroy();
+			ds       = other.ds;
+			other.ds = NULL;
+		}
+		return *this;
+	}
+	
+	heap(const heap &) = delete;
+	heap & operator=(const heap &) = delete;
+	
+	void push(T && value)     { link(new T(std::move(value))); }
+	void push(const T & value){ link(new T(value)); }
+	
+	template <class... Args>
+	void emplace(Args&&... args){ link(new T(std::forward<Args>(args)...)); }
+	
+	/// The first element in order, which must exist
+	const T & top(){ return *static_cast<const T*>(DS_first(ds)); }
+	
+	/// Move the top element into out and remove it. False if empty.
+	bool pop(T & out){
+		T * element;
+	
+		if (empty()) return false;
+		DS_first(ds);
+		element = static_cast<T*>(const_cast<void*>(DS_remove(ds)));
+		out     = std::move(*element);
+		delete element;
+		return true;
+	}
+	
+	/// Destroy every element
+	void clear(){
+		while (!empty()){
+			DS_first(ds);
+			delete static_cast<const T*>(DS_remove(ds));
+		}
+	}
+	
+	size_t size () const { return ds? DS_count(ds) : 0; }
+	bool   empty() const { return !size(); }
+};
+
+
+} // namespace util
+
+
+#endif // _DATA_HPP_INCLUDE
+
+